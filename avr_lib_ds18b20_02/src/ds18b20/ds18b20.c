@@ -10,26 +10,37 @@ Please refer to LICENSE file for licensing information.
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stddef.h>
 
 #include "ds18b20.h"
 
+/*
+ * the timed part of each slot runs with interrupts off (whatever DS18B20_STOPINTERRUPTONREAD is), so an interrupt
+ * can't stretch a slot into a different bit, and interrupts are only held off for one slot (61us at most) at a time
+ */
+#define DS18B20_SLOTBEGIN() uint8_t sreg = SREG; cli()
+#define DS18B20_SLOTEND() SREG = sreg
+
 /*
  * ds18b20 init
  */
 uint8_t ds18b20_reset() {
 	uint8_t i;
 
-	//low for 480us
+	//low for 480us (longer does no harm)
 	DS18B20_PORT &= ~ (1<<DS18B20_DQ); //low
 	DS18B20_DDR |= (1<<DS18B20_DQ); //output
 	_delay_us(480);
 
 	//release line and wait for 60uS
+	DS18B20_SLOTBEGIN();
 	DS18B20_DDR &= ~(1<<DS18B20_DQ); //input
 	_delay_us(60);
 
 	//get value and wait 420us
 	i = (DS18B20_PIN & (1<<DS18B20_DQ));
+	DS18B20_SLOTEND();
 	_delay_us(420);
 
 	//return the read value, 0=ok, 1=error
@@ -40,6 +51,8 @@ uint8_t ds18b20_reset() {
  * write one bit
  */
 void ds18b20_writebit(uint8_t bit){
+	DS18B20_SLOTBEGIN();
+
 	//low for 1uS
 	DS18B20_PORT &= ~ (1<<DS18B20_DQ); //low
 	DS18B20_DDR |= (1<<DS18B20_DQ); //output
@@ -52,6 +65,8 @@ void ds18b20_writebit(uint8_t bit){
 	//wait 60uS and release the line
 	_delay_us(60);
 	DS18B20_DDR &= ~(1<<DS18B20_DQ); //input
+
+	DS18B20_SLOTEND();
 }
 
 /*
@@ -60,6 +75,8 @@ void ds18b20_writebit(uint8_t bit){
 uint8_t ds18b20_readbit(void){
 	uint8_t bit=0;
 
+	DS18B20_SLOTBEGIN();
+
 	//low for 1uS
 	DS18B20_PORT &= ~ (1<<DS18B20_DQ); //low
 	DS18B20_DDR |= (1<<DS18B20_DQ); //output
@@ -75,6 +92,7 @@ uint8_t ds18b20_readbit(void){
 
 	//wait 45uS and return read value
 	_delay_us(45);
+	DS18B20_SLOTEND();
 	return bit;
 }
 
@@ -102,38 +120,341 @@ uint8_t ds18b20_readbyte(void){
 }
 
 /*
- * get temperature
+ * dallas crc8 of every byte value
  */
-double ds18b20_gettemp() {
-	uint8_t temperature_l;
-	uint8_t temperature_h;
-	double retd = 0;
+static const uint8_t ds18b20_crc8table[256] PROGMEM = {
+	0x00, 0x5e, 0xbc, 0xe2, 0x61, 0x3f, 0xdd, 0x83, 0xc2, 0x9c, 0x7e, 0x20, 0xa3, 0xfd, 0x1f, 0x41,
+	0x9d, 0xc3, 0x21, 0x7f, 0xfc, 0xa2, 0x40, 0x1e, 0x5f, 0x01, 0xe3, 0xbd, 0x3e, 0x60, 0x82, 0xdc,
+	0x23, 0x7d, 0x9f, 0xc1, 0x42, 0x1c, 0xfe, 0xa0, 0xe1, 0xbf, 0x5d, 0x03, 0x80, 0xde, 0x3c, 0x62,
+	0xbe, 0xe0, 0x02, 0x5c, 0xdf, 0x81, 0x63, 0x3d, 0x7c, 0x22, 0xc0, 0x9e, 0x1d, 0x43, 0xa1, 0xff,
+	0x46, 0x18, 0xfa, 0xa4, 0x27, 0x79, 0x9b, 0xc5, 0x84, 0xda, 0x38, 0x66, 0xe5, 0xbb, 0x59, 0x07,
+	0xdb, 0x85, 0x67, 0x39, 0xba, 0xe4, 0x06, 0x58, 0x19, 0x47, 0xa5, 0xfb, 0x78, 0x26, 0xc4, 0x9a,
+	0x65, 0x3b, 0xd9, 0x87, 0x04, 0x5a, 0xb8, 0xe6, 0xa7, 0xf9, 0x1b, 0x45, 0xc6, 0x98, 0x7a, 0x24,
+	0xf8, 0xa6, 0x44, 0x1a, 0x99, 0xc7, 0x25, 0x7b, 0x3a, 0x64, 0x86, 0xd8, 0x5b, 0x05, 0xe7, 0xb9,
+	0x8c, 0xd2, 0x30, 0x6e, 0xed, 0xb3, 0x51, 0x0f, 0x4e, 0x10, 0xf2, 0xac, 0x2f, 0x71, 0x93, 0xcd,
+	0x11, 0x4f, 0xad, 0xf3, 0x70, 0x2e, 0xcc, 0x92, 0xd3, 0x8d, 0x6f, 0x31, 0xb2, 0xec, 0x0e, 0x50,
+	0xaf, 0xf1, 0x13, 0x4d, 0xce, 0x90, 0x72, 0x2c, 0x6d, 0x33, 0xd1, 0x8f, 0x0c, 0x52, 0xb0, 0xee,
+	0x32, 0x6c, 0x8e, 0xd0, 0x53, 0x0d, 0xef, 0xb1, 0xf0, 0xae, 0x4c, 0x12, 0x91, 0xcf, 0x2d, 0x73,
+	0xca, 0x94, 0x76, 0x28, 0xab, 0xf5, 0x17, 0x49, 0x08, 0x56, 0xb4, 0xea, 0x69, 0x37, 0xd5, 0x8b,
+	0x57, 0x09, 0xeb, 0xb5, 0x36, 0x68, 0x8a, 0xd4, 0x95, 0xcb, 0x29, 0x77, 0xf4, 0xaa, 0x48, 0x16,
+	0xe9, 0xb7, 0x55, 0x0b, 0x88, 0xd6, 0x34, 0x6a, 0x2b, 0x75, 0x97, 0xc9, 0x4a, 0x14, 0xf6, 0xa8,
+	0x74, 0x2a, 0xc8, 0x96, 0x15, 0x4b, 0xa9, 0xf7, 0xb6, 0xe8, 0x0a, 0x54, 0xd7, 0x89, 0x6b, 0x35
+};
+
+/*
+ * dallas crc8 (x^8 + x^5 + x^4 + 1) of len bytes, 0 over a whole rom code or scratchpad means it is valid
+ */
+uint8_t ds18b20_crc8(const uint8_t *data, uint8_t len) {
+	uint8_t crc = 0;
+
+	while(len--)
+		crc = pgm_read_byte(&ds18b20_crc8table[crc ^ *data++]);
+	return crc;
+}
+
+/*
+ * the same crc8 one bit at a time, slower but without the table
+ */
+uint8_t ds18b20_crc8bitwise(const uint8_t *data, uint8_t len) {
+	uint8_t crc = 0;
+	uint8_t in;
+	uint8_t i;
+
+	while(len--) {
+		in = *data++;
+		for(i=8; i; i--) {
+			if((crc ^ in) & 0x01)
+				crc = (crc >> 1) ^ 0x8c;
+			else
+				crc >>= 1;
+			in >>= 1;
+		}
+	}
+	return crc;
+}
+
+/*
+ * address one sensor by rom code, or every sensor if rom is NULL
+ */
+void ds18b20_select(const uint8_t *rom) {
+	uint8_t i;
+
+	if(rom) {
+		ds18b20_writebyte(DS18B20_CMD_MATCHROM); //match ROM
+		for(i=0; i<DS18B20_ROMSIZE; i++)
+			ds18b20_writebyte(rom[i]);
+	} else {
+		ds18b20_writebyte(DS18B20_CMD_SKIPROM); //skip ROM
+	}
+}
+
+/*
+ * search the bus for DS18B20 sensors (Maxim AN187), return how many rom codes were stored
+ */
+uint8_t ds18b20_search(uint8_t roms[][DS18B20_ROMSIZE], uint8_t max) {
+	uint8_t rom[DS18B20_ROMSIZE] = { 0 };
+	uint8_t count = 0;
+	uint8_t lastdiscrepancy = 0;
+	uint8_t lastzero;
+	uint8_t bitn;
+	uint8_t id;
+	uint8_t cmp;
+	uint8_t dir;
+	uint8_t i;
+
+	do {
+		if(ds18b20_reset()) //no sensors
+			break;
+		ds18b20_writebyte(DS18B20_CMD_SEARCHROM); //search ROM
+
+		lastzero = 0;
+		for(bitn=1; bitn<=64; bitn++) {
+			//read the bit and its complement from every sensor still taking part
+			id = ds18b20_readbit();
+			cmp = ds18b20_readbit();
+			if(id && cmp) //nobody answered
+				return count;
+
+			if(id != cmp) {
+				//all agree
+				dir = id;
+			} else {
+				//discrepancy, take the 1 branch if it was the last one, repeat the last path before it
+				if(bitn < lastdiscrepancy)
+					dir = (rom[(bitn-1) >> 3] >> ((bitn-1) & 0x07)) & 0x01;
+				else
+					dir = (bitn == lastdiscrepancy);
+				if(!dir)
+					lastzero = bitn;
+			}
+
+			if(dir)
+				rom[(bitn-1) >> 3] |= (1 << ((bitn-1) & 0x07));
+			else
+				rom[(bitn-1) >> 3] &= ~(1 << ((bitn-1) & 0x07));
+			ds18b20_writebit(dir);
+		}
+		lastdiscrepancy = lastzero;
+
+		if(ds18b20_crc8(rom, DS18B20_ROMSIZE) == 0 && rom[0] == DS18B20_FAMILY) {
+			for(i=0; i<DS18B20_ROMSIZE; i++)
+				roms[count][i] = rom[i];
+			count++;
+		}
+	} while(lastdiscrepancy && count < max);
+
+	return count;
+}
+
+/*
+ * start a temperature conversion on every sensor, return 0=ok, 1=error
+ * the conversion takes up to DS18B20_CONVERSIONTIME ms, read it with ds18b20_readtemp() after that
+ */
+uint8_t ds18b20_startconversion() {
+	uint8_t ret;
 
 	#if DS18B20_STOPINTERRUPTONREAD == 1
 	cli();
 	#endif
 
-	ds18b20_reset(); //reset
-	ds18b20_writebyte(DS18B20_CMD_SKIPROM); //skip ROM
-	ds18b20_writebyte(DS18B20_CMD_CONVERTTEMP); //start temperature conversion
+	ret = ds18b20_reset(); //reset
+	if(!ret) {
+		ds18b20_writebyte(DS18B20_CMD_SKIPROM); //skip ROM
+		ds18b20_writebyte(DS18B20_CMD_CONVERTTEMP); //start temperature conversion
+	}
 
-	while(!ds18b20_readbit()); //wait until conversion is complete
+	#if DS18B20_STOPINTERRUPTONREAD == 1
+	sei();
+	#endif
+
+	return ret;
+}
+
+/*
+ * conversion time (ms, rounded up) at a resolution of 9-12 bits
+ */
+uint16_t ds18b20_conversiontime(uint8_t bits) {
+	uint8_t shift = DS18B20_MAXRESOLUTION - bits;
+
+	return (DS18B20_CONVERSIONTIME + (1 << shift) - 1) >> shift;
+}
+
+/*
+ * set the resolution (9-12 bits) of one sensor, or every sensor if rom is NULL, return 0=ok, 1=error
+ * with persist the setting is copied to the sensor eeprom, so it survives a power cycle
+ * with rom NULL the alarm thresholds are read back from whichever sensor answers, so only use it with one sensor
+ */
+uint8_t ds18b20_setresolution(const uint8_t *rom, uint8_t bits, uint8_t persist) {
+	uint8_t scratchpad[DS18B20_SCRATCHPADSIZE];
+	uint8_t i;
+
+	if(bits < DS18B20_MINRESOLUTION || bits > DS18B20_MAXRESOLUTION)
+		return 1;
+
+	#if DS18B20_STOPINTERRUPTONREAD == 1
+	cli();
+	#endif
+
+	//read the alarm thresholds, so they can be written back unchanged
+	if(ds18b20_reset()) { //reset
+		#if DS18B20_STOPINTERRUPTONREAD == 1
+		sei();
+		#endif
+		return 1;
+	}
+	ds18b20_select(rom); //select the sensor
+	ds18b20_writebyte(DS18B20_CMD_RSCRATCHPAD); //read scratchpad
+	for(i=0; i<DS18B20_SCRATCHPADSIZE; i++)
+		scratchpad[i] = ds18b20_readbyte();
+	if(ds18b20_checkscratchpad(scratchpad)) {
+		#if DS18B20_STOPINTERRUPTONREAD == 1
+		sei();
+		#endif
+		return 1;
+	}
 
 	ds18b20_reset(); //reset
-	ds18b20_writebyte(DS18B20_CMD_SKIPROM); //skip ROM
+	ds18b20_select(rom); //select the sensor
+	ds18b20_writebyte(DS18B20_CMD_WSCRATCHPAD); //write scratchpad
+	ds18b20_writebyte(scratchpad[2]); //alarm thresholds
+	ds18b20_writebyte(scratchpad[3]);
+	ds18b20_writebyte(((bits - DS18B20_MINRESOLUTION) << 5) | 0x1f); //configuration register
+
+	if(persist) {
+		ds18b20_reset(); //reset
+		ds18b20_select(rom); //select the sensor
+		ds18b20_writebyte(DS18B20_CMD_CPYSCRATCHPAD); //copy scratchpad to eeprom
+	}
+
+	#if DS18B20_STOPINTERRUPTONREAD == 1
+	sei();
+	#endif
+
+	//the eeprom write takes up to 10ms
+	if(persist)
+		_delay_ms(10);
+
+	return 0;
+}
+
+/*
+ * check a whole scratchpad, return 0=ok, 1=error
+ */
+uint8_t ds18b20_checkscratchpad(const uint8_t *scratchpad) {
+	//the crc catches noise and a bus that idles high (all 0xff), the fixed configuration bits catch a bus stuck low (all 0 has a valid crc)
+	if(ds18b20_crc8(scratchpad, DS18B20_SCRATCHPADSIZE) || (scratchpad[4] & 0x9f) != 0x1f)
+		return 1;
+	return 0;
+}
+
+/*
+ * get the temperature in 1/16 C from a whole scratchpad, return 0=ok, 1=error
+ * for when the scratchpad was read some other way than ds18b20_readtemp()
+ */
+uint8_t ds18b20_decodetemp(const uint8_t *scratchpad, int16_t *temp) {
+	uint8_t temperature_l;
+
+	if(ds18b20_checkscratchpad(scratchpad))
+		return 1;
+
+	//the 12 bit value is sign extended to 16 bit, in 1/16 C
+	//below 12 bit resolution the lowest bits are undefined, so clear them
+	temperature_l = scratchpad[0] & (0xff << (DS18B20_MAXRESOLUTION - DS18B20_MINRESOLUTION - ((scratchpad[4] >> 5) & 0x03)));
+	*temp = (int16_t)( ( (uint16_t)scratchpad[1] << 8 ) | temperature_l );
+
+	return 0;
+}
+
+/*
+ * read the temperature of the last conversion in 1/16 C, return 0=ok, 1=error
+ * rom selects the sensor, or NULL if there is only one
+ */
+uint8_t ds18b20_readtemp(const uint8_t *rom, int16_t *temp) {
+	uint8_t scratchpad[DS18B20_SCRATCHPADSIZE];
+	uint8_t i;
+
+	#if DS18B20_STOPINTERRUPTONREAD == 1
+	cli();
+	#endif
+
+	if(ds18b20_reset()) { //reset
+		#if DS18B20_STOPINTERRUPTONREAD == 1
+		sei();
+		#endif
+		return 1;
+	}
+	ds18b20_select(rom); //select the sensor
 	ds18b20_writebyte(DS18B20_CMD_RSCRATCHPAD); //read scratchpad
 
-	//read 2 byte from scratchpad
-	temperature_l = ds18b20_readbyte();
-	temperature_h = ds18b20_readbyte();
+	//read the whole scratchpad, so the crc can be checked
+	for(i=0; i<DS18B20_SCRATCHPADSIZE; i++)
+		scratchpad[i] = ds18b20_readbyte();
 
 	#if DS18B20_STOPINTERRUPTONREAD == 1
 	sei();
 	#endif
 
-	//convert the 12 bit value obtained
-	retd = ( ( temperature_h << 8 ) + temperature_l ) * 0.0625;
+	return ds18b20_decodetemp(scratchpad, temp);
+}
+
+/*
+ * get temperature in 1/16 C (blocks until the conversion is complete)
+ */
+int16_t ds18b20_gettemp() {
+	int16_t ret = 0;
+
+	ds18b20_startconversion(); //start temperature conversion
+
+	while(!ds18b20_readbit()); //wait until conversion is complete
+
+	ds18b20_readtemp(NULL, &ret);
+
+	return ret;
+}
+
+#if DS18B20_FLOATAPI == 1
+/*
+ * get temperature in C as a double (blocks until the conversion is complete)
+ */
+double ds18b20_gettempf() {
+	return ds18b20_gettemp() * 0.0625;
+}
+#endif
+
+/*
+ * print a temperature (1/16 C) with the given decimals (0-4), rounded
+ * return a pointer to the terminating null, so more can be appended
+ */
+char *ds18b20_tostring(int16_t temp, char *str, uint8_t decimals) {
+	uint32_t scale = 1;
+	uint32_t value;
+	uint8_t digits = 0;
+	uint8_t i;
+	char buff[10];
+
+	if(decimals > 4)
+		decimals = 4;
+	for(i=0; i<decimals; i++)
+		scale *= 10;
+
+	//fixed point to decimal, rounding to nearest
+	value = ( (uint32_t)(temp < 0 ? -temp : temp) * scale + 8 ) >> 4;
+	if(temp < 0 && value)
+		*str++ = '-';
+
+	//write the digits backwards, the integer part needs at least one
+	do {
+		buff[digits++] = '0' + (value % 10);
+		value /= 10;
+	} while(value || digits <= decimals);
+
+	while(digits) {
+		if(digits == decimals)
+			*str++ = '.';
+		*str++ = buff[--digits];
+	}
+	*str = '\0';
 
-	return retd;
+	return str;
 }
 
@@ -41,11 +41,46 @@ extern "C" {
 #define DS18B20_CMD_SKIPROM 0xcc
 #define DS18B20_CMD_ALARMSEARCH 0xec
 
-//stop any interrupt on read
+//rom code and scratchpad size (bytes)
+#define DS18B20_ROMSIZE 8
+#define DS18B20_SCRATCHPADSIZE 9
+#define DS18B20_FAMILY 0x28
+
+//stop any interrupt for a whole transaction (each slot is always timed with interrupts off, see ds18b20.c)
 //#define DS18B20_STOPINTERRUPTONREAD 1
+#ifndef DS18B20_STOPINTERRUPTONREAD
+#define DS18B20_STOPINTERRUPTONREAD 0
+#endif
+
+//conversion time (ms) at the default 12 bit resolution, it halves with each bit less
+#define DS18B20_CONVERSIONTIME 750
+
+//resolution (bits)
+#define DS18B20_MINRESOLUTION 9
+#define DS18B20_MAXRESOLUTION 12
+
+//enable the double (floating point) functions
+//#define DS18B20_FLOATAPI 1
+#ifndef DS18B20_FLOATAPI
+#define DS18B20_FLOATAPI 0
+#endif
 
 //functions
-extern double ds18b20_gettemp();
+extern uint8_t ds18b20_crc8(const uint8_t *data, uint8_t len);
+extern uint8_t ds18b20_crc8bitwise(const uint8_t *data, uint8_t len);
+extern void ds18b20_select(const uint8_t *rom);
+extern uint8_t ds18b20_search(uint8_t roms[][DS18B20_ROMSIZE], uint8_t max);
+extern uint16_t ds18b20_conversiontime(uint8_t bits);
+extern uint8_t ds18b20_setresolution(const uint8_t *rom, uint8_t bits, uint8_t persist);
+extern uint8_t ds18b20_startconversion();
+extern uint8_t ds18b20_checkscratchpad(const uint8_t *scratchpad);
+extern uint8_t ds18b20_decodetemp(const uint8_t *scratchpad, int16_t *temp);
+extern uint8_t ds18b20_readtemp(const uint8_t *rom, int16_t *temp);
+extern int16_t ds18b20_gettemp();
+#if DS18B20_FLOATAPI == 1
+extern double ds18b20_gettempf();
+#endif
+extern char *ds18b20_tostring(int16_t temp, char *str, uint8_t decimals);
 
 #ifdef __cplusplus
 }
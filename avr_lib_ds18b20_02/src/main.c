@@ -10,7 +10,7 @@
 
 int main(void) {
 	char printbuff[100];
-	double d = 0;
+	int16_t d = 0;
 
 	//init uart
 	uart_init( UART_BAUD_SELECT(UART_BAUD_RATE,F_CPU) );
@@ -21,7 +21,7 @@ int main(void) {
 	for (;;) {
 		d = ds18b20_gettemp();
 
-		dtostrf(d, 10, 3, printbuff);
+		ds18b20_tostring(d, printbuff, 4);
 		uart_puts("Temperature: "); uart_puts(printbuff); uart_puts("\r\n");
 
 		_delay_ms(500);
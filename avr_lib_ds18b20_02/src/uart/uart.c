@@ -41,6 +41,16 @@ LICENSE:
 #include <avr/pgmspace.h>
 #include "uart.h"
 
+/*
+ *  trace hooks, supplied by the build (eg with -include), nothing otherwise
+ */
+#ifndef UART_TRACE_RX
+#define UART_TRACE_RX(data)
+#endif
+#ifndef UART_TRACE_TX
+#define UART_TRACE_TX()
+#endif
+
 
 /*
  *  constants and macros
@@ -145,8 +155,8 @@ LICENSE:
 #elif defined(__AVR_ATmega48__) ||defined(__AVR_ATmega88__) || defined(__AVR_ATmega168__) || defined(__AVR_ATmega48P__) || defined(__AVR_ATmega88P__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega328P__)
  /* ATmega with one USART */
  #define ATMEGA_USART0
- #define UART0_RECEIVE_INTERRUPT   SIG_USART_RECV
- #define UART0_TRANSMIT_INTERRUPT  SIG_USART_DATA
+ #define UART0_RECEIVE_INTERRUPT   USART_RX_vect
+ #define UART0_TRANSMIT_INTERRUPT  USART_UDRE_vect
  #define UART0_STATUS   UCSR0A
  #define UART0_CONTROL  UCSR0B
  #define UART0_DATA     UDR0
@@ -255,6 +265,7 @@ Purpose:  called when the UART has received a character
     /* read UART status register and UART data register */ 
     usr  = UART0_STATUS;
     data = UART0_DATA;
+    UART_TRACE_RX(data);
     
     /* */
 #if defined( AT90_UART )
@@ -293,6 +304,7 @@ Purpose:  called when the UART is ready to transmit the next byte
 
     
     if ( UART_TxHead != UART_TxTail) {
+        UART_TRACE_TX();
         /* calculate and store new buffer index */
         tmptail = (UART_TxTail + 1) & UART_TX_BUFFER_MASK;
         UART_TxTail = tmptail;
@@ -383,6 +395,18 @@ void uart_init(unsigned int baudrate)
 }/* uart_init */
 
 
+/*************************************************************************
+Function: uart_txspace()
+Purpose:  return how many bytes uart_putc() can take without waiting
+Returns:  free space in the transmit ringbuffer
+**************************************************************************/
+unsigned char uart_txspace(void)
+{
+    return (UART_TxTail - UART_TxHead - 1) & UART_TX_BUFFER_MASK;
+
+}/* uart_txspace */
+
+
 /*************************************************************************
 Function: uart_getc()
 Purpose:  return byte from ringbuffer  
@@ -97,6 +97,10 @@ LICENSE:
 ** function prototypes
 */
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
    @brief   Initialize UART and set baudrate 
    @param   baudrate Specify baudrate using macro UART_BAUD_SELECT()
@@ -173,6 +177,18 @@ extern void uart_puts_p(const char *s );
 #define uart_puts_P(__s)       uart_puts_p(PSTR(__s))
 
 
+/**
+ *  @brief   Get the free space in the transmit ringbuffer
+ *
+ *  Lets the caller skip a message instead of blocking in uart_putc()
+ *  when the ringbuffer is too full to take it.
+ *
+ *  @param   void
+ *  @return  bytes that can be put without blocking
+ */
+extern unsigned char uart_txspace(void);
+
+
 
 /** @brief  Initialize USART1 (only available on selected ATmegas) @see uart_init */
 extern void uart1_init(unsigned int baudrate);
@@ -187,6 +203,10 @@ extern void uart1_puts_p(const char *s );
 /** @brief  Macro to automatically put a string constant into program memory */
 #define uart1_puts_P(__s)       uart1_puts_p(PSTR(__s))
 
+#ifdef __cplusplus
+}
+#endif
+
 /**@}*/
 
 
@@ -0,0 +1,590 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "../include/hal.h"
+#include "../../include/audio.h"
+#include "../../include/colour.h"
+#include "../../include/display.h"
+#include "../../include/dsp.h"
+#include "../../include/ic_ds1307.h"
+#include "../../include/pins.h"
+#include "../../include/timer.h"
+#include "../../avr_lib_ds18b20_02/src/ds18b20/ds18b20.h"
+
+//Microbenchmarks of the firmwares hot kernels, run on the host (see usage()).
+//Each one is timed in batches big enough to take about batch_ns, and the median batch is reported,
+//so a result is repeatable to a few percent on an idle machine. Results can be written as CSV or JSON,
+//and compared with a baseline written by an earlier run (a kernel that's threshold % slower is a regression).
+//
+//The host times only say whether a change helped, not what it's worth on the lamp. So each kernel also has an
+//estimate of its AVR cycles, from the cost model below: the operations it does, counted from the source,
+//times what they take on an ATmega328P with avr-gcc -Os (avr-libc's float routines are the bulk of it).
+//They're estimates to compare kernels and changes by. Measure on the lamp with a PROFILE build to be sure.
+
+//---AVR cost model (cycles)---//
+
+namespace avr {
+	constexpr uint32_t call = 8;			//call, ret and saving a few registers
+	constexpr uint32_t mul = 2;				//mul (8x8, 16 bit result)
+	constexpr uint32_t float_add = 110;		//__addsf3/__subsf3
+	constexpr uint32_t float_mul = 150;		//__mulsf3
+	constexpr uint32_t float_div = 480;		//__divsf3
+	constexpr uint32_t float_floor = 60;
+	constexpr uint32_t float_convert = 80;	//__fixsfsi/__floatsisf
+	constexpr uint32_t io = 2;				//lds/sts of an extended I/O register
+	constexpr uint32_t load = 2;			//ld/st/lpm (lpm is 3)
+}
+
+//---Timing---//
+
+static uint64_t now_ns() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return((static_cast<uint64_t>(t.tv_sec) * 1000000000) + t.tv_nsec);
+}
+
+//Keeps results alive, so the compiler can't drop the work that made them
+static volatile uint32_t sink;
+
+struct Result {
+	std::string name;
+	uint32_t param;
+	uint64_t iterations;	//In each batch
+	double ns;				//Per iteration (median batch)
+	double spread;			//(slowest batch - fastest batch) / median, a rough noise figure
+	uint32_t avr_cycles;	//Estimated, 0 if there's no estimate
+};
+
+static uint64_t batch_ns = 20000000;
+static uint8_t batches = 9;
+
+//Times body(iterations), returning the median ns per iteration over the batches
+template <typename Body>
+static Result measure(char const *const name, uint32_t const param, uint32_t const avr_cycles, Body body) {
+	//Find how many iterations take about batch_ns
+	uint64_t iterations = 1;
+	while (true) {
+		uint64_t const start = now_ns();
+		body(iterations);
+		uint64_t const took = now_ns() - start;
+		if (took >= batch_ns / 8)
+			break;
+		iterations *= 2;
+	}
+	{
+		uint64_t const start = now_ns();
+		body(iterations);
+		uint64_t const took = now_ns() - start;
+		iterations = std::max<uint64_t>(1, iterations * batch_ns / std::max<uint64_t>(took, 1));
+	}
+	std::vector<double> times;
+	for (uint8_t i = 0; i < batches; i++) {
+		uint64_t const start = now_ns();
+		body(iterations);
+		times.push_back(static_cast<double>(now_ns() - start) / iterations);
+	}
+	std::sort(times.begin(), times.end());
+	double const median = times[times.size() / 2];
+	return(Result{ name, param, iterations, median, (times.back() - times.front()) / median, avr_cycles });
+}
+
+//---Instant DS1307---//
+
+//Answers the TWI straight away (unlike the simulators model, which takes the buses time), so get_all()/set_all()
+//time the drivers own work. The clock registers are a fixed time.
+static uint8_t rtc_ram[8] = { 0x56, 0x34, 0x52, 0x01, 0x21, 0x12, 0x24, 0x10 };
+static uint8_t rtc_pointer = 0;
+static bool rtc_read = false;
+static bool rtc_addressed = false;
+static bool rtc_pointer_set = false;
+
+static void twi_write(uint8_t const, uint8_t const value, uint8_t const) {
+	if (!(value & _BV(TWINT)))
+		return;
+	uint8_t status;
+	if (value & _BV(TWSTO)) {
+		rtc_addressed = false;
+		return;
+	}
+	if (value & _BV(TWSTA)) {
+		status = rtc_addressed ? 0x10 : 0x08;
+		rtc_addressed = false;
+	}
+	else if (!rtc_addressed) {
+		rtc_read = hal::peek(0xbb) & 0x01;
+		rtc_addressed = true;
+		rtc_pointer_set = false;
+		status = rtc_read ? 0x40 : 0x18;
+	}
+	else if (rtc_read) {
+		hal::poke(0xbb, rtc_ram[rtc_pointer++ & 0x07]);
+		status = (value & _BV(TWEA)) ? 0x50 : 0x58;
+	}
+	else {
+		if (rtc_pointer_set)
+			rtc_ram[rtc_pointer++ & 0x07] = hal::peek(0xbb);
+		else
+			rtc_pointer = hal::peek(0xbb);
+		rtc_pointer_set = true;
+		status = 0x28;
+	}
+	hal::poke(0xb9, status);
+	hal::poke(0xbc, hal::peek(0xbc) | _BV(TWINT));
+}
+
+//---Kernels---//
+
+//How colour.cpp used to convert HSV to RGB, in floating point (S and V 0-100)
+static RGBColor hsv2rgb_float(float const H, float const S, float const V) {
+	float r = 0, g = 0, b = 0;
+	float const h = H / 360;
+	float const s = S / 100;
+	float const v = V / 100;
+	int const i = floor(h * 6);
+	float const f = h * 6 - i;
+	float const p = v * (1 - s);
+	float const q = v * (1 - f * s);
+	float const t = v * (1 - (1 - f) * s);
+	switch (i % 6) {
+	case 0: r = v, g = t, b = p; break;
+	case 1: r = q, g = v, b = p; break;
+	case 2: r = p, g = v, b = t; break;
+	case 3: r = p, g = q, b = v; break;
+	case 4: r = t, g = p, b = v; break;
+	case 5: r = v, g = p, b = q; break;
+	}
+	RGBColor color;
+	color.r = r * 255;
+	color.g = g * 255;
+	color.b = b * 255;
+	return(color);
+}
+
+static void bench_hsv2rgb(std::vector<Result> &results) {
+	//Work it out from colour.cpp: finding the sector (2.5 subtracts on average), 5 multiplies and 5 divides by 255
+	//(an add and a shift each), and the switch
+	uint32_t const avr_cycles = avr::call + (3 * 6) + 6 + (5 * (avr::mul + 8)) + 20;
+	results.push_back(measure("hsv2rgb", 0, avr_cycles, [](uint64_t const n) {
+		uint16_t hue = 0;
+		for (uint64_t i = 0; i < n; i++) {
+			RGBColor const colour = hsv2rgb(hue, 255, 128);
+			sink = colour.r + colour.g + colour.b;
+			hue++;
+			if (hue == 360)
+				hue = 0;
+		}
+	}));
+	//The floating point version: 3 divides, 11 multiplies, 6 adds, a floor and 5 conversions
+	uint32_t const float_cycles = avr::call + (3 * avr::float_div) + (11 * avr::float_mul) + (6 * avr::float_add) +
+		avr::float_floor + (5 * avr::float_convert);
+	results.push_back(measure("hsv2rgb_float", 0, float_cycles, [](uint64_t const n) {
+		float hue = 0;
+		for (uint64_t i = 0; i < n; i++) {
+			RGBColor const colour = hsv2rgb_float(hue, 100, 50);
+			sink = colour.r + colour.g + colour.b;
+			hue += 0.7f;
+			if (hue >= 360)
+				hue -= 360;
+		}
+	}));
+}
+
+static void bench_display(std::vector<Result> &results) {
+	IC_DS1307 rtc;
+	rtc.get_all();
+	IC_DS1307::RegData const time = rtc.regData;
+	//sprintf of 12 digits and 3 strings, and ds18b20_tostring()'s divide, dominate. About 150 cycles a %u.
+	uint32_t const avr_cycles = avr::call + (12 * 150) + (3 * 60) + 600 + 200;
+	results.push_back(measure("display_format", 0, avr_cycles, [&time](uint64_t const n) {
+		char text[display::text_size];
+		for (uint64_t i = 0; i < n; i++) {
+			display::format(text, time, true, static_cast<int16_t>(21 * 16 + (i & 0x0f)));
+			sink = text[9];
+		}
+	}));
+}
+
+static void bench_timer_tick(std::vector<Result> &results) {
+	//The firmware has a handful of timers (see main.cpp), more are there to see how it scales
+	uint32_t const counts[] = { 1, 4, 8, 16, 32 };
+	for (uint32_t const count : counts) {
+		Timer *const timers = new Timer[count];
+		for (uint32_t i = 0; i < count; i++) {
+			timers[i] = 0xffffffff;
+			timers[i].start();
+		}
+		//Each timer: loading its pointer, the call to decrement() and a 64 bit decrement and compare
+		uint32_t const avr_cycles = avr::call + 6 + (count * ((2 * avr::load) + avr::call + 40));
+		results.push_back(measure("timer_tick", count, avr_cycles, [](uint64_t const n) {
+			for (uint64_t i = 0; i < n; i++) {
+				timer::tick();
+			}
+		}));
+		//Timers remove themselves last first, the cheapest way for timer::remove()
+		delete[] timers;
+	}
+}
+
+static void bench_regdata(std::vector<Result> &results) {
+	IC_DS1307 rtc;
+	//The register and bit field work on each of the 8 bytes, plus the TWI bus itself (which the estimate leaves out)
+	results.push_back(measure("regdata_decode", 0, avr::call + (8 * (avr::io * 8 + 20)), [&rtc](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			rtc.get_all();
+			sink = rtc.regData.second0;
+		}
+	}));
+	results.push_back(measure("regdata_encode", 0, avr::call + (8 * (avr::io * 8 + 16)), [&rtc](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			rtc.regData.second0 = i % 10;
+			sink = rtc.set_all();
+		}
+	}));
+	IC_DS1307::RegData a = rtc.regData;
+	IC_DS1307::RegData b = rtc.regData;
+	//18 fields, each unpacked from both sides (a shift and mask) and compared
+	results.push_back(measure("regdata_compare", 0, avr::call + (18 * 10), [&a, &b](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			b.second0 = i & 0x01;
+			sink = a == b;
+		}
+	}));
+}
+
+static void bench_crc(std::vector<Result> &results) {
+	//A scratchpad, as read every conversion
+	static uint8_t const scratchpad[DS18B20_SCRATCHPADSIZE] = { 0x50, 0x05, 0x4b, 0x46, 0x7f, 0xff, 0x0c, 0x10, 0x1c };
+	//Table: ld, eor, add the table address, lpm and the loop, about 11 a byte. Bitwise: about 8 a bit.
+	results.push_back(measure("crc8_table", DS18B20_SCRATCHPADSIZE, avr::call + (DS18B20_SCRATCHPADSIZE * 11), [](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			sink = ds18b20_crc8(scratchpad, DS18B20_SCRATCHPADSIZE);
+		}
+	}));
+	results.push_back(measure("crc8_bitwise", DS18B20_SCRATCHPADSIZE, avr::call + (DS18B20_SCRATCHPADSIZE * (4 + (8 * 8))), [](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			sink = ds18b20_crc8bitwise(scratchpad, DS18B20_SCRATCHPADSIZE);
+		}
+	}));
+}
+
+static void bench_goertzel(std::vector<Result> &results) {
+	//A block of two tones, as audio::update() gets it
+	static int8_t samples[audio::block_size];
+	for (uint8_t i = 0; i < audio::block_size; i++) {
+		samples[i] = static_cast<int8_t>((50 * cos(2 * M_PI * 250 * i / audio::sample_rate)) + (40 * cos(2 * M_PI * 1000 * i / audio::sample_rate)));
+	}
+	static constexpr int16_t coeff = dsp::goertzel_coeff(500, audio::sample_rate, audio::block_size);
+	//Each sample: the load, subtract and shift, the 16x16 multiply (4 muls and their adds) and >> 14, then the add, subtract
+	//and moving the state on, about 40. Then 3 multiplies for the power.
+	results.push_back(measure("goertzel", audio::block_size, avr::call + (audio::block_size * 40) + (3 * 20), [](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			sink = dsp::goertzel(samples, audio::block_size, static_cast<int8_t>(i & 0x01), coeff);
+		}
+	}));
+}
+
+//The two ways of putting a character out to the display, each without the delays (the 0.25us E pulse and the 37us the
+//display takes, the same either way), and both over the same plain port bytes (not the HAL's hooked registers), so only
+//the work that differs is timed. The AVR cycles (44 a character for the table, 358 for the pointers) are estimates counted
+//by hand from the instructions avr-gcc -Os would emit, and these are the figures to quote. To measure them, count the
+//instructions of nibble() and send() in main.lss (make lss at the top level).
+
+//How a character goes out now (lcd.cpps send() and nibble()): each nibble looked up in a table of the data pins it
+//sets, and put out with one masked write of PORTB
+static constexpr uint8_t table_data_mask = pins::lcd_data0::mask | pins::lcd_data1::mask | pins::lcd_data2::mask | pins::lcd_data3::mask;
+
+static constexpr uint8_t table_scatter(uint8_t const p0) {
+	return(((p0 & 0x01) ? pins::lcd_data0::mask : 0) | ((p0 & 0x02) ? pins::lcd_data1::mask : 0) |
+		((p0 & 0x04) ? pins::lcd_data2::mask : 0) | ((p0 & 0x08) ? pins::lcd_data3::mask : 0));
+}
+
+static constexpr uint8_t table_pins[16] = {
+	table_scatter(0x0), table_scatter(0x1), table_scatter(0x2), table_scatter(0x3), table_scatter(0x4), table_scatter(0x5),
+	table_scatter(0x6), table_scatter(0x7), table_scatter(0x8), table_scatter(0x9), table_scatter(0xa), table_scatter(0xb),
+	table_scatter(0xc), table_scatter(0xd), table_scatter(0xe), table_scatter(0xf)
+};
+
+static void table_nibble(volatile uint8_t *const data, volatile uint8_t *const control, uint8_t const p0) {
+	*data = (*data & ~table_data_mask) | table_pins[p0];
+	*control |= pins::lcd_enable::mask;
+	*control &= ~pins::lcd_enable::mask;
+}
+
+static void table_write(volatile uint8_t *const data, volatile uint8_t *const control, uint8_t const p0) {
+	*control |= pins::lcd_rs::mask;
+	table_nibble(data, control, p0 >> 4);
+	table_nibble(data, control, p0 & 0x0f);
+}
+
+//How a character used to go out (the tedavr driver): every pin set on its own, through a port pointer and a bit number
+//held at run time
+struct PointerPins {
+	volatile uint8_t *port_data[4];
+	volatile uint8_t *port_rs;
+	volatile uint8_t *port_rw;
+	volatile uint8_t *port_en;
+	uint8_t shift_data[4];
+	uint8_t shift_rs;
+	uint8_t shift_rw;
+	uint8_t shift_en;
+};
+
+static void pointer_set(volatile uint8_t *const port, uint8_t const shift, bool const value) {
+	if (value)
+		*port |= 1 << shift;
+	else
+		*port &= ~(1 << shift);
+}
+
+static void pointer_nibble(PointerPins const &pins, uint8_t const p0) {
+	for (uint8_t i = 0; i < 4; i++) {
+		pointer_set(pins.port_data[i], pins.shift_data[i], p0 & (1 << i));
+	}
+	pointer_set(pins.port_en, pins.shift_en, true);
+	pointer_set(pins.port_en, pins.shift_en, false);
+}
+
+static void pointer_write(PointerPins const &pins, uint8_t const p0) {
+	pointer_set(pins.port_rs, pins.shift_rs, true);
+	pointer_set(pins.port_rw, pins.shift_rw, false);
+	pointer_nibble(pins, p0 >> 4);
+	pointer_nibble(pins, p0 & 0x0f);
+}
+
+static void bench_lcd(std::vector<Result> &results) {
+	volatile uint8_t *const port_b = &PORTB;
+	volatile uint8_t *const port_d = &PORTD;
+	//Table (estimate): sbi for RS (2), then each nibble's swap/andi (2), the table address (4), lpm (3), in, andi, or, out (4)
+	//and the E sbi/cbi (4), 17 a nibble
+	results.push_back(measure("lcd_write_table", 0, avr::call + 2 + (2 * 17), [port_b, port_d](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			table_write(port_b, port_d, '0' + (i & 0x07));
+		}
+	}));
+	//Pointers (estimate): each pin is the pointer and bit number loaded (6), 1 << bit shifted out in a loop (about 10),
+	//the test of the value (2), then ld, or/and and st through the pointer (5), about 25. RS, R/W, then 6 pins a nibble.
+	PointerPins const pins = {
+		{ port_b, port_b, port_b, port_b }, port_d, port_d, port_d, { 0, 3, 4, 5 }, 3, 4, 7
+	};
+	results.push_back(measure("lcd_write_pointers", 0, avr::call + (2 * 25) + (2 * 6 * 25), [&pins](uint64_t const n) {
+		for (uint64_t i = 0; i < n; i++) {
+			pointer_write(pins, '0' + (i & 0x07));
+		}
+	}));
+}
+
+//---Output---//
+
+static void write_csv(FILE *const p0, std::vector<Result> const &results) {
+	fprintf(p0, "name,param,iterations,ns,spread,avr_cycles\n");
+	for (Result const &result : results) {
+		fprintf(p0, "%s,%u,%llu,%.3f,%.3f,%u\n", result.name.c_str(), result.param,
+			static_cast<unsigned long long>(result.iterations), result.ns, result.spread, result.avr_cycles);
+	}
+}
+
+static void write_json(FILE *const p0, std::vector<Result> const &results) {
+	fprintf(p0, "[\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		Result const &result = results[i];
+		fprintf(p0, "\t{\"name\": \"%s\", \"param\": %u, \"iterations\": %llu, \"ns\": %.3f, \"spread\": %.3f, \"avr_cycles\": %u}%s\n",
+			result.name.c_str(), result.param, static_cast<unsigned long long>(result.iterations), result.ns,
+			result.spread, result.avr_cycles, (i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(p0, "]\n");
+}
+
+static void write_table(FILE *const p0, std::vector<Result> const &results) {
+	fprintf(p0, "%-18s %5s %12s %7s %12s\n", "kernel", "param", "host ns", "spread", "est. cycles");
+	for (Result const &result : results) {
+		fprintf(p0, "%-18s %5u %12.2f %6.1f%% %12u\n", result.name.c_str(), result.param, result.ns,
+			result.spread * 100, result.avr_cycles);
+	}
+}
+
+//Reads a CSV written by write_csv()
+static bool read_csv(char const *const path, std::vector<Result> &out) {
+	FILE *const file = fopen(path, "r");
+	if (!file)
+		return(false);
+	char line[256];
+	//Skip the header
+	if (!fgets(line, sizeof(line), file)) {
+		fclose(file);
+		return(false);
+	}
+	while (fgets(line, sizeof(line), file)) {
+		char name[64];
+		Result result;
+		unsigned long long iterations;
+		if (sscanf(line, "%63[^,],%u,%llu,%lf,%lf,%u", name, &result.param, &iterations, &result.ns, &result.spread, &result.avr_cycles) != 6)
+			continue;
+		result.name = name;
+		result.iterations = iterations;
+		out.push_back(result);
+	}
+	fclose(file);
+	return(true);
+}
+
+//Prints how each kernel compares with the baseline, returns how many regressed
+static uint8_t compare(std::vector<Result> const &results, std::vector<Result> const &baseline, double const threshold) {
+	uint8_t regressions = 0;
+	printf("\n%-18s %5s %12s %12s %8s\n", "kernel", "param", "baseline ns", "host ns", "change");
+	for (Result const &result : results) {
+		auto const old = std::find_if(baseline.begin(), baseline.end(), [&result](Result const &p0) {
+			return((p0.name == result.name) && (p0.param == result.param));
+		});
+		if (old == baseline.end()) {
+			printf("%-18s %5u %12s %12.2f %8s\n", result.name.c_str(), result.param, "-", result.ns, "new");
+			continue;
+		}
+		double const change = (result.ns - old->ns) * 100 / old->ns;
+		bool const regressed = change > threshold;
+		if (regressed)
+			regressions++;
+		printf("%-18s %5u %12.2f %12.2f %+7.1f%%%s\n", result.name.c_str(), result.param, old->ns, result.ns,
+			change, regressed ? "  REGRESSED" : "");
+	}
+	return(regressions);
+}
+
+static void usage(FILE *const p0) {
+	fprintf(p0,
+		"usage: bench [options] [kernel ...]\n"
+		"  -c, --csv FILE         write the results as CSV ('-' for stdout)\n"
+		"  -j, --json FILE        write the results as JSON ('-' for stdout)\n"
+		"  -b, --baseline FILE    compare with the CSV of an earlier run (exits with 1 on a regression)\n"
+		"  -r, --threshold PCT    how much slower than the baseline is a regression (default 10)\n"
+		"  -n, --batches N        batches to take the median of (default %u)\n"
+		"  -m, --batch-ms MS      how long each batch runs (default %u)\n"
+		"kernels: hsv2rgb display timer regdata crc goertzel lcd (default all)\n",
+		batches, static_cast<unsigned>(batch_ns / 1000000));
+}
+
+static FILE *open_output(char const *const path) {
+	if (!strcmp(path, "-"))
+		return(stdout);
+	FILE *const file = fopen(path, "w");
+	if (!file)
+		fprintf(stderr, "can't write %s\n", path);
+	return(file);
+}
+
+int main(int argc, char *argv[]) {
+	static option const options[] = {
+		{ "csv", required_argument, nullptr, 'c' },
+		{ "json", required_argument, nullptr, 'j' },
+		{ "baseline", required_argument, nullptr, 'b' },
+		{ "threshold", required_argument, nullptr, 'r' },
+		{ "batches", required_argument, nullptr, 'n' },
+		{ "batch-ms", required_argument, nullptr, 'm' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	char const *csv_path = nullptr;
+	char const *json_path = nullptr;
+	char const *baseline_path = nullptr;
+	double threshold = 10;
+	int option;
+	while ((option = getopt_long(argc, argv, "c:j:b:r:n:m:h", options, nullptr)) != -1) {
+		switch (option) {
+		case 'c':
+			csv_path = optarg;
+			break;
+		case 'j':
+			json_path = optarg;
+			break;
+		case 'b':
+			baseline_path = optarg;
+			break;
+		case 'r':
+			threshold = atof(optarg);
+			break;
+		case 'n':
+			batches = std::max(1, atoi(optarg));
+			break;
+		case 'm':
+			batch_ns = static_cast<uint64_t>(std::max(1, atoi(optarg))) * 1000000;
+			break;
+		case 'h':
+			usage(stdout);
+			return(0);
+		default:
+			usage(stderr);
+			return(2);
+		}
+	}
+
+	hal::reset();
+	hal::on_write(0xbc, twi_write);
+
+	struct Kernel {
+		char const *name;
+		void (*run)(std::vector<Result> &results);
+	};
+	static Kernel const kernels[] = {
+		{ "hsv2rgb", bench_hsv2rgb },
+		{ "display", bench_display },
+		{ "timer", bench_timer_tick },
+		{ "regdata", bench_regdata },
+		{ "crc", bench_crc },
+		{ "goertzel", bench_goertzel },
+		{ "lcd", bench_lcd }
+	};
+	std::vector<Result> results;
+	for (Kernel const &kernel : kernels) {
+		bool chosen = optind == argc;
+		for (int i = optind; i < argc; i++) {
+			if (!strcmp(argv[i], kernel.name))
+				chosen = true;
+		}
+		if (chosen)
+			kernel.run(results);
+	}
+	if (results.empty()) {
+		usage(stderr);
+		return(2);
+	}
+
+	//Keep stdout for the results if they're going there
+	bool const quiet = (csv_path && !strcmp(csv_path, "-")) || (json_path && !strcmp(json_path, "-"));
+	if (!quiet)
+		write_table(stdout, results);
+	if (csv_path) {
+		FILE *const file = open_output(csv_path);
+		if (!file)
+			return(2);
+		write_csv(file, results);
+		if (file != stdout)
+			fclose(file);
+	}
+	if (json_path) {
+		FILE *const file = open_output(json_path);
+		if (!file)
+			return(2);
+		write_json(file, results);
+		if (file != stdout)
+			fclose(file);
+	}
+	if (baseline_path) {
+		std::vector<Result> baseline;
+		if (!read_csv(baseline_path, baseline)) {
+			fprintf(stderr, "can't read %s\n", baseline_path);
+			return(2);
+		}
+		uint8_t const regressions = compare(results, baseline, threshold);
+		if (regressions) {
+			printf("%u regressed more than %.0f%%\n", regressions, threshold);
+			return(1);
+		}
+		printf("no regressions (threshold %.0f%%)\n", threshold);
+	}
+	return(0);
+}
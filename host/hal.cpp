@@ -0,0 +1,81 @@
+#include "include/hal.h"
+#include <string.h>
+
+uint8_t hal::memory[hal::size];
+uint32_t hal::eeprom_writes = 0;
+
+static hal::ReadHook read_hook[hal::size];
+static hal::WriteHook write_hook[hal::size];
+static hal::DelayHook delay_hook = nullptr;
+static hal::SleepHook sleep_hook = nullptr;
+
+//Bits that are cleared by writing a 1 to them (interrupt flags), by register address
+static uint8_t clear_on_one(uint8_t const address) {
+	switch (address) {
+	case 0x35:		//TIFR0
+	case 0x36:		//TIFR1
+	case 0x37:		//TIFR2
+	case 0x3b:		//PCIFR
+	case 0x3c:		//EIFR
+		return(0xff);
+	case 0x7a:		//ADCSRA (ADIF)
+		return(0x10);
+	case 0xbc:		//TWCR (TWINT)
+		return(0x80);
+	case 0xc0:		//UCSR0A (TXC0)
+		return(0x40);
+	default:
+		return(0);
+	}
+}
+
+void hal::on_read(uint8_t const address, ReadHook const p0) {
+	read_hook[address] = p0;
+}
+
+void hal::on_write(uint8_t const address, WriteHook const p0) {
+	write_hook[address] = p0;
+}
+
+void hal::on_delay(DelayHook const p0) {
+	delay_hook = p0;
+}
+
+void hal::on_sleep(SleepHook const p0) {
+	sleep_hook = p0;
+}
+
+void hal::reset() {
+	memset(memory, 0, sizeof(memory));
+	memset(read_hook, 0, sizeof(read_hook));
+	memset(write_hook, 0, sizeof(write_hook));
+	delay_hook = nullptr;
+	sleep_hook = nullptr;
+	eeprom_writes = 0;
+	//The stack pointer starts at the top of SRAM
+	memory[0x5d] = 0xff;
+	memory[0x5e] = 0x08;
+}
+
+uint8_t hal::read(uint8_t const address) {
+	return(read_hook[address] ? read_hook[address](address, memory[address]) : memory[address]);
+}
+
+void hal::write(uint8_t const address, uint8_t const value) {
+	uint8_t const old = memory[address];
+	uint8_t const flags = clear_on_one(address);
+	//Writing a 1 to a flag clears it, writing a 0 leaves it
+	memory[address] = (value & ~flags) | (old & flags & ~value);
+	if (write_hook[address])
+		write_hook[address](address, value, old);
+}
+
+void hal::delay(uint32_t const cycles) {
+	if (delay_hook)
+		delay_hook(cycles);
+}
+
+void hal::sleep() {
+	if (sleep_hook)
+		sleep_hook();
+}
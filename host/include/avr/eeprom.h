@@ -0,0 +1,52 @@
+#pragma once
+
+//EEMEM variables are ordinary globals on the host. Writes that change a byte are counted in hal::eeprom_writes.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "../hal.h"
+
+#define EEMEM
+
+static inline uint8_t eeprom_read_byte(uint8_t const *p0) {
+	return(*p0);
+}
+static inline uint16_t eeprom_read_word(uint16_t const *p0) {
+	return(*p0);
+}
+static inline uint32_t eeprom_read_dword(uint32_t const *p0) {
+	return(*p0);
+}
+static inline void eeprom_read_block(void *p0, void const *p1, size_t const len) {
+	memcpy(p0, p1, len);
+}
+static inline void eeprom_update_block(void const *p0, void *p1, size_t const len) {
+	uint8_t const *const in = static_cast<uint8_t const *>(p0);
+	uint8_t *const out = static_cast<uint8_t *>(p1);
+	for (size_t i = 0; i < len; i++) {
+		if (out[i] != in[i]) {
+			out[i] = in[i];
+			hal::eeprom_writes++;
+		}
+	}
+}
+static inline void eeprom_write_block(void const *p0, void *p1, size_t const len) {
+	memcpy(p1, p0, len);
+	hal::eeprom_writes += len;
+}
+static inline void eeprom_update_byte(uint8_t *p0, uint8_t const value) {
+	eeprom_update_block(&value, p0, 1);
+}
+static inline void eeprom_write_byte(uint8_t *p0, uint8_t const value) {
+	eeprom_write_block(&value, p0, 1);
+}
+static inline void eeprom_update_word(uint16_t *p0, uint16_t const value) {
+	eeprom_update_block(&value, p0, 2);
+}
+static inline void eeprom_write_word(uint16_t *p0, uint16_t const value) {
+	eeprom_write_block(&value, p0, 2);
+}
+static inline bool eeprom_is_ready() {
+	return(true);
+}
+#define eeprom_busy_wait() do { } while (0)
@@ -0,0 +1,16 @@
+#pragma once
+
+//Interrupt handlers become plain functions named after their vector (eg TIMER2_OVF_vect()), for the simulator to call.
+#include <avr/io.h>
+
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+#define SIGNAL(vector) ISR(vector)
+#define EMPTY_INTERRUPT(vector) ISR(vector) {}
+#define ISR_ALIAS(vector, target) ISR(vector) { target(); }
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define reti() return
+
+#define sei() (SREG |= _BV(SREG_I))
+#define cli() (SREG &= static_cast<uint8_t>(~_BV(SREG_I)))
@@ -0,0 +1,475 @@
+#pragma once
+
+//The ATmega328P registers and bits for host builds. Each register is a hal::Reg8/Reg16 (see hal.h),
+//so reads and writes go through any hooks the simulator has set. Taking a registers address (&PORTB, for a driver
+//that keeps a pointer to a port) gives a plain pointer into hal::memory, which skips the hooks.
+#include <stdint.h>
+#include "../hal.h"
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+#define RAMSTART 0x100
+#define RAMEND 0x8ff
+#define E2END 0x3ff
+#define FLASHEND 0x7fff
+
+#define _HAL_REG8(address) (hal::Reg8(address))
+#define _HAL_REG16(address) (hal::Reg16(address))
+//A register by its I/O address (as pin.h uses)
+#define _SFR_IO8(io_addr) _HAL_REG8((io_addr) + 0x20)
+
+//Ports
+#define PINB _HAL_REG8(0x23)
+#define DDRB _HAL_REG8(0x24)
+#define PORTB _HAL_REG8(0x25)
+#define PINC _HAL_REG8(0x26)
+#define DDRC _HAL_REG8(0x27)
+#define PORTC _HAL_REG8(0x28)
+#define PIND _HAL_REG8(0x29)
+#define DDRD _HAL_REG8(0x2a)
+#define PORTD _HAL_REG8(0x2b)
+
+//Interrupt flags and masks, EEPROM, general purpose, timer 0, SPI, analog comparator, sleep, stack, status
+#define TIFR0 _HAL_REG8(0x35)
+#define TIFR1 _HAL_REG8(0x36)
+#define TIFR2 _HAL_REG8(0x37)
+#define PCIFR _HAL_REG8(0x3b)
+#define EIFR _HAL_REG8(0x3c)
+#define EIMSK _HAL_REG8(0x3d)
+#define GPIOR0 _HAL_REG8(0x3e)
+#define EECR _HAL_REG8(0x3f)
+#define EEDR _HAL_REG8(0x40)
+#define EEAR _HAL_REG16(0x41)
+#define EEARL _HAL_REG8(0x41)
+#define EEARH _HAL_REG8(0x42)
+#define GTCCR _HAL_REG8(0x43)
+#define TCCR0A _HAL_REG8(0x44)
+#define TCCR0B _HAL_REG8(0x45)
+#define TCNT0 _HAL_REG8(0x46)
+#define OCR0A _HAL_REG8(0x47)
+#define OCR0B _HAL_REG8(0x48)
+#define GPIOR1 _HAL_REG8(0x4a)
+#define GPIOR2 _HAL_REG8(0x4b)
+#define SPCR _HAL_REG8(0x4c)
+#define SPSR _HAL_REG8(0x4d)
+#define SPDR _HAL_REG8(0x4e)
+#define ACSR _HAL_REG8(0x50)
+#define SMCR _HAL_REG8(0x53)
+#define MCUSR _HAL_REG8(0x54)
+#define MCUCR _HAL_REG8(0x55)
+#define SPMCSR _HAL_REG8(0x57)
+#define SP _HAL_REG16(0x5d)
+#define SPL _HAL_REG8(0x5d)
+#define SPH _HAL_REG8(0x5e)
+#define SREG _HAL_REG8(0x5f)
+
+//Watchdog, clock, power, external/pin change interrupts, timer masks, ADC
+#define WDTCSR _HAL_REG8(0x60)
+#define CLKPR _HAL_REG8(0x61)
+#define PRR _HAL_REG8(0x64)
+#define OSCCAL _HAL_REG8(0x66)
+#define PCICR _HAL_REG8(0x68)
+#define EICRA _HAL_REG8(0x69)
+#define PCMSK0 _HAL_REG8(0x6b)
+#define PCMSK1 _HAL_REG8(0x6c)
+#define PCMSK2 _HAL_REG8(0x6d)
+#define TIMSK0 _HAL_REG8(0x6e)
+#define TIMSK1 _HAL_REG8(0x6f)
+#define TIMSK2 _HAL_REG8(0x70)
+#define ADC _HAL_REG16(0x78)
+#define ADCW _HAL_REG16(0x78)
+#define ADCL _HAL_REG8(0x78)
+#define ADCH _HAL_REG8(0x79)
+#define ADCSRA _HAL_REG8(0x7a)
+#define ADCSRB _HAL_REG8(0x7b)
+#define ADMUX _HAL_REG8(0x7c)
+#define DIDR0 _HAL_REG8(0x7e)
+#define DIDR1 _HAL_REG8(0x7f)
+
+//Timer 1
+#define TCCR1A _HAL_REG8(0x80)
+#define TCCR1B _HAL_REG8(0x81)
+#define TCCR1C _HAL_REG8(0x82)
+#define TCNT1 _HAL_REG16(0x84)
+#define TCNT1L _HAL_REG8(0x84)
+#define TCNT1H _HAL_REG8(0x85)
+#define ICR1 _HAL_REG16(0x86)
+#define ICR1L _HAL_REG8(0x86)
+#define ICR1H _HAL_REG8(0x87)
+#define OCR1A _HAL_REG16(0x88)
+#define OCR1AL _HAL_REG8(0x88)
+#define OCR1AH _HAL_REG8(0x89)
+#define OCR1B _HAL_REG16(0x8a)
+#define OCR1BL _HAL_REG8(0x8a)
+#define OCR1BH _HAL_REG8(0x8b)
+
+//Timer 2
+#define TCCR2A _HAL_REG8(0xb0)
+#define TCCR2B _HAL_REG8(0xb1)
+#define TCNT2 _HAL_REG8(0xb2)
+#define OCR2A _HAL_REG8(0xb3)
+#define OCR2B _HAL_REG8(0xb4)
+#define ASSR _HAL_REG8(0xb6)
+
+//TWI
+#define TWBR _HAL_REG8(0xb8)
+#define TWSR _HAL_REG8(0xb9)
+#define TWAR _HAL_REG8(0xba)
+#define TWDR _HAL_REG8(0xbb)
+#define TWCR _HAL_REG8(0xbc)
+#define TWAMR _HAL_REG8(0xbd)
+
+//USART 0
+#define UCSR0A _HAL_REG8(0xc0)
+#define UCSR0B _HAL_REG8(0xc1)
+#define UCSR0C _HAL_REG8(0xc2)
+#define UBRR0 _HAL_REG16(0xc4)
+#define UBRR0L _HAL_REG8(0xc4)
+#define UBRR0H _HAL_REG8(0xc5)
+#define UDR0 _HAL_REG8(0xc6)
+
+//Port bits
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+#define PINB4 4
+#define PINB5 5
+#define PINB6 6
+#define PINB7 7
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define DDB4 4
+#define DDB5 5
+#define DDB6 6
+#define DDB7 7
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB2 2
+#define PORTB3 3
+#define PORTB4 4
+#define PORTB5 5
+#define PORTB6 6
+#define PORTB7 7
+#define PINC0 0
+#define PINC1 1
+#define PINC2 2
+#define PINC3 3
+#define PINC4 4
+#define PINC5 5
+#define PINC6 6
+#define DDC0 0
+#define DDC1 1
+#define DDC2 2
+#define DDC3 3
+#define DDC4 4
+#define DDC5 5
+#define DDC6 6
+#define PORTC0 0
+#define PORTC1 1
+#define PORTC2 2
+#define PORTC3 3
+#define PORTC4 4
+#define PORTC5 5
+#define PORTC6 6
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define PIND7 7
+#define DDD0 0
+#define DDD1 1
+#define DDD2 2
+#define DDD3 3
+#define DDD4 4
+#define DDD5 5
+#define DDD6 6
+#define DDD7 7
+#define PORTD0 0
+#define PORTD1 1
+#define PORTD2 2
+#define PORTD3 3
+#define PORTD4 4
+#define PORTD5 5
+#define PORTD6 6
+#define PORTD7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+//Timer interrupt flags and masks
+#define TOV0 0
+#define OCF0A 1
+#define OCF0B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define ICF1 5
+#define TOV2 0
+#define OCF2A 1
+#define OCF2B 2
+#define TOIE0 0
+#define OCIE0A 1
+#define OCIE0B 2
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1 5
+#define TOIE2 0
+#define OCIE2A 1
+#define OCIE2B 2
+
+//External and pin change interrupts
+#define INTF0 0
+#define INTF1 1
+#define INT0 0
+#define INT1 1
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+#define PCINT4 4
+#define PCINT5 5
+#define PCINT6 6
+#define PCINT7 7
+#define PCINT8 0
+#define PCINT9 1
+#define PCINT10 2
+#define PCINT11 3
+#define PCINT12 4
+#define PCINT13 5
+#define PCINT14 6
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+
+//EEPROM
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define EEPM0 4
+#define EEPM1 5
+
+//Timer 0
+#define WGM00 0
+#define WGM01 1
+#define COM0B0 4
+#define COM0B1 5
+#define COM0A0 6
+#define COM0A1 7
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM02 3
+#define FOC0B 6
+#define FOC0A 7
+
+//Timer 1
+#define WGM10 0
+#define WGM11 1
+#define COM1B0 4
+#define COM1B1 5
+#define COM1A0 6
+#define COM1A1 7
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+#define FOC1B 6
+#define FOC1A 7
+
+//Timer 2
+#define WGM20 0
+#define WGM21 1
+#define COM2B0 4
+#define COM2B1 5
+#define COM2A0 6
+#define COM2A1 7
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define WGM22 3
+#define FOC2B 6
+#define FOC2A 7
+#define TCR2BUB 0
+#define TCR2AUB 1
+#define OCR2BUB 2
+#define OCR2AUB 3
+#define TCN2UB 4
+#define AS2 5
+#define EXCLK 6
+
+//Sleep, MCU control, power reduction, watchdog, clock
+#define SE 0
+#define SM0 1
+#define SM1 2
+#define SM2 3
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define IVCE 0
+#define IVSEL 1
+#define PUD 4
+#define BODSE 5
+#define BODS 6
+#define PRADC 0
+#define PRUSART0 1
+#define PRSPI 2
+#define PRTIM1 3
+#define PRTIM0 5
+#define PRTIM2 6
+#define PRTWI 7
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+#define CLKPS0 0
+#define CLKPS1 1
+#define CLKPS2 2
+#define CLKPS3 3
+#define CLKPCE 7
+
+//ADC
+#define MUX0 0
+#define MUX1 1
+#define MUX2 2
+#define MUX3 3
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+#define ACME 6
+#define ADC0D 0
+#define ADC1D 1
+#define ADC2D 2
+#define ADC3D 3
+#define ADC4D 4
+#define ADC5D 5
+
+//SPI
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE 6
+#define SPIE 7
+#define SPI2X 0
+#define WCOL 6
+#define SPIF 7
+
+//TWI
+#define TWPS0 0
+#define TWPS1 1
+#define TWS3 3
+#define TWS4 4
+#define TWS5 5
+#define TWS6 6
+#define TWS7 7
+#define TWIE 0
+#define TWEN 2
+#define TWWC 3
+#define TWSTO 4
+#define TWSTA 5
+#define TWEA 6
+#define TWINT 7
+
+//USART 0
+#define MPCM0 0
+#define U2X0 1
+#define UPE0 2
+#define DOR0 3
+#define FE0 4
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define TXB80 0
+#define RXB80 1
+#define UCSZ02 2
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCPOL0 0
+#define UCSZ00 1
+#define UCSZ01 2
+#define USBS0 3
+#define UPM00 4
+#define UPM01 5
+#define UMSEL00 6
+#define UMSEL01 7
+
+//Status register
+#define SREG_C 0
+#define SREG_Z 1
+#define SREG_N 2
+#define SREG_V 3
+#define SREG_S 4
+#define SREG_H 5
+#define SREG_T 6
+#define SREG_I 7
@@ -0,0 +1,22 @@
+#pragma once
+
+//Flash and SRAM are the same on the host
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PROGMEM
+#define PGM_P char const *
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*reinterpret_cast<uint8_t const *>(address))
+#define pgm_read_word(address) (*reinterpret_cast<uint16_t const *>(address))
+#define pgm_read_dword(address) (*reinterpret_cast<uint32_t const *>(address))
+#define pgm_read_ptr(address) (*reinterpret_cast<void *const *>(address))
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define sprintf_P sprintf
+#define snprintf_P snprintf
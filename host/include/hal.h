@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+//Host (g++) stand in for the ATmega328P, so the firmware sources can be built and run on a workstation.
+//Every special function register is a Reg8/Reg16 over a 256 byte array, indexed by its data space address.
+//A simulator or bench can hook reads and writes of any register to model the peripheral behind it,
+//and hook delays and sleeps to move its own clock on.
+namespace hal {
+	constexpr uint16_t size = 0x100;
+	extern uint8_t memory[size];
+
+	//Returns the value a read sees (value is what's stored)
+	typedef uint8_t (*ReadHook)(uint8_t const address, uint8_t const value);
+	//Called after a write is stored (old is the value before it)
+	typedef void (*WriteHook)(uint8_t const address, uint8_t const value, uint8_t const old);
+	//Called for _delay_us()/_delay_ms() (cycles to wait) and sleep_cpu()
+	typedef void (*DelayHook)(uint32_t const cycles);
+	typedef void (*SleepHook)();
+
+	void on_read(uint8_t const address, ReadHook const p0);
+	void on_write(uint8_t const address, WriteHook const p0);
+	void on_delay(DelayHook const p0);
+	void on_sleep(SleepHook const p0);
+	//Clears every register and hook
+	void reset();
+
+	//Register access, going through the hooks
+	uint8_t read(uint8_t const address);
+	void write(uint8_t const address, uint8_t const value);
+	//Register access that skips the hooks (for the models themselves)
+	inline uint8_t peek(uint8_t const address) {
+		return(memory[address]);
+	}
+	inline void poke(uint8_t const address, uint8_t const value) {
+		memory[address] = value;
+	}
+	void delay(uint32_t const cycles);
+	void sleep();
+	//Counts EEPROM byte writes (for wear checks)
+	extern uint32_t eeprom_writes;
+
+	class Reg8 {
+	public:
+		constexpr explicit Reg8(uint8_t const naddress) : address(naddress) {}
+		operator uint8_t() const {
+			return(read(address));
+		}
+		//For the drivers that keep a pointer to a port
+		volatile uint8_t *operator&() const {
+			return(memory + address);
+		}
+		Reg8 const &operator=(int const p0) const {
+			write(address, static_cast<uint8_t>(p0));
+			return(*this);
+		}
+		Reg8 const &operator=(Reg8 const &p0) const {
+			write(address, p0);
+			return(*this);
+		}
+		Reg8 const &operator|=(int const p0) const {
+			write(address, static_cast<uint8_t>(read(address) | p0));
+			return(*this);
+		}
+		Reg8 const &operator&=(int const p0) const {
+			write(address, static_cast<uint8_t>(read(address) & p0));
+			return(*this);
+		}
+		Reg8 const &operator^=(int const p0) const {
+			write(address, static_cast<uint8_t>(read(address) ^ p0));
+			return(*this);
+		}
+		Reg8 const &operator+=(int const p0) const {
+			write(address, static_cast<uint8_t>(read(address) + p0));
+			return(*this);
+		}
+		Reg8 const &operator-=(int const p0) const {
+			write(address, static_cast<uint8_t>(read(address) - p0));
+			return(*this);
+		}
+		uint8_t const address;
+	};
+
+	//A 16 bit register. Like the AVR, the low byte is read first and the high byte is written first.
+	class Reg16 {
+	public:
+		constexpr explicit Reg16(uint8_t const naddress) : address(naddress) {}
+		operator uint16_t() const {
+			uint8_t const low = read(address);
+			return(static_cast<uint16_t>((read(address + 1) << 8) | low));
+		}
+		Reg16 const &operator=(uint16_t const p0) const {
+			write(address + 1, static_cast<uint8_t>(p0 >> 8));
+			write(address, static_cast<uint8_t>(p0));
+			return(*this);
+		}
+		Reg16 const &operator=(Reg16 const &p0) const {
+			return(*this = static_cast<uint16_t>(p0));
+		}
+		Reg16 const &operator+=(uint16_t const p0) const {
+			return(*this = static_cast<uint16_t>(*this + p0));
+		}
+		Reg16 const &operator-=(uint16_t const p0) const {
+			return(*this = static_cast<uint16_t>(*this - p0));
+		}
+		uint8_t const address;
+	};
+}
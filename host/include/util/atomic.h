@@ -0,0 +1,26 @@
+#pragma once
+
+//The same for loop trick avr-libc uses. Interrupts are only a bit in SREG here, so it's only as atomic as the simulator makes it.
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+static inline uint8_t __iCliRetVal() {
+	cli();
+	return(1);
+}
+static inline void __iSeiParam(uint8_t const *) {
+	sei();
+}
+static inline void __iCliParam(uint8_t const *) {
+	cli();
+}
+static inline void __iRestore(uint8_t const *p0) {
+	SREG = *p0;
+}
+
+#define ATOMIC_BLOCK(type) for (type, __ToDo = __iCliRetVal(); __ToDo; __ToDo = 0)
+#define NONATOMIC_BLOCK(type) for (type, __ToDo = (sei(), 1); __ToDo; __ToDo = 0)
+#define ATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define ATOMIC_FORCEON uint8_t sreg_save __attribute__((__cleanup__(__iSeiParam))) = 0
+#define NONATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define NONATOMIC_FORCEOFF uint8_t sreg_save __attribute__((__cleanup__(__iCliParam))) = 0
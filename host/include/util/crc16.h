@@ -0,0 +1,31 @@
+#pragma once
+
+//The same CRCs as avr-libc (which are in asm there)
+#include <stdint.h>
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t const a) {
+	crc ^= a;
+	for (uint8_t i = 0; i < 8; i++) {
+		crc = (crc & 1) ? ((crc >> 1) ^ 0xa001) : (crc >> 1);
+	}
+	return(crc);
+}
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t const data) {
+	crc ^= static_cast<uint16_t>(data) << 8;
+	for (uint8_t i = 0; i < 8; i++) {
+		crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+	}
+	return(crc);
+}
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+	data ^= static_cast<uint8_t>(crc);
+	data ^= static_cast<uint8_t>(data << 4);
+	return(static_cast<uint16_t>(((static_cast<uint16_t>(data) << 8) | (crc >> 8)) ^ static_cast<uint8_t>(data >> 4) ^ (static_cast<uint16_t>(data) << 3)));
+}
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t const data) {
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++) {
+		crc = (crc & 1) ? ((crc >> 1) ^ 0x8c) : (crc >> 1);
+	}
+	return(crc);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+//Delays hand the time over to the simulator (see hal::on_delay()) rather than spinning
+#include <stdint.h>
+#include "../hal.h"
+
+#ifndef F_CPU
+#error F_CPU must be defined for util/delay.h
+#endif
+
+static inline void _delay_us(double const us) {
+	hal::delay(static_cast<uint32_t>(us * (F_CPU / 1000000.0)));
+}
+static inline void _delay_ms(double const ms) {
+	hal::delay(static_cast<uint32_t>(ms * (F_CPU / 1000.0)));
+}
+#define __builtin_avr_delay_cycles(cycles) hal::delay(cycles)
+#define _delay_loop_1(count) hal::delay(static_cast<uint32_t>(count) * 3)
+#define _delay_loop_2(count) hal::delay(static_cast<uint32_t>(count) * 4)
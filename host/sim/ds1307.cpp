@@ -0,0 +1,153 @@
+#include "sim.h"
+#include <string.h>
+#include <time.h>
+
+//The DS1307s 64 bytes: the time (0-6), control (7) and battery backed RAM (8-63)
+static uint8_t ram[64];
+static uint8_t pointer = 0;
+//Whether the next byte written sets the pointer (the first after the address)
+static bool pointer_next = false;
+//Whether the time was written (it's taken up at the stop)
+static bool time_written = false;
+//The clock was base_seconds at base_cycles, and runs on from there unless CH (register 0 bit 7) halts it
+static int64_t base_seconds = 0;
+static uint64_t base_cycles = 0;
+static bool halted = false;
+//How many times faster than real time it runs
+static uint16_t speed = 1;
+//The time last copied into the registers (so it's only worked out again once it changes)
+static int64_t latched = -1;
+
+static uint8_t bcd(int const p0) {
+	return(static_cast<uint8_t>(((p0 / 10) << 4) | (p0 % 10)));
+}
+
+static int decimal(uint8_t const p0) {
+	return(((p0 >> 4) * 10) + (p0 & 0x0f));
+}
+
+//Copies the time into the registers (the DS1307 does this on every start condition)
+static void latch() {
+	time_t const seconds = static_cast<time_t>(sim::ds1307::get());
+	if (seconds == latched)
+		return;
+	latched = seconds;
+	tm time;
+	gmtime_r(&seconds, &time);
+	ram[0] = bcd(time.tm_sec) | (halted ? 0x80 : 0x00);
+	ram[1] = bcd(time.tm_min);
+	if (ram[2] & 0x40) {
+		int const hour = time.tm_hour % 12;
+		ram[2] = 0x40 | ((time.tm_hour >= 12) ? 0x20 : 0x00) | bcd(hour ? hour : 12);
+	}
+	else {
+		ram[2] = bcd(time.tm_hour);
+	}
+	ram[3] = static_cast<uint8_t>(time.tm_wday + 1);
+	ram[4] = bcd(time.tm_mday);
+	ram[5] = bcd(time.tm_mon + 1);
+	ram[6] = bcd(time.tm_year % 100);
+}
+
+//Takes up the time written to the registers
+static void unlatch() {
+	tm time = {};
+	time.tm_sec = decimal(ram[0] & 0x7f);
+	time.tm_min = decimal(ram[1] & 0x7f);
+	if (ram[2] & 0x40)
+		time.tm_hour = (decimal(ram[2] & 0x1f) % 12) + ((ram[2] & 0x20) ? 12 : 0);
+	else
+		time.tm_hour = decimal(ram[2] & 0x3f);
+	time.tm_mday = decimal(ram[4] & 0x3f);
+	time.tm_mon = decimal(ram[5] & 0x1f) - 1;
+	time.tm_year = decimal(ram[6]) + 100;
+	halted = ram[0] & 0x80;
+	base_seconds = timegm(&time);
+	base_cycles = sim::now;
+	latched = -1;
+}
+
+void sim::ds1307::reset() {
+	memset(ram, 0, sizeof(ram));
+	//main() shows the time as 12 hour, so the clock starts in that mode. The control register has the square wave off.
+	ram[2] = 0x40;
+	ram[7] = 0x03;
+	pointer = 0;
+	pointer_next = false;
+	time_written = false;
+	halted = false;
+	speed = 1;
+	latched = -1;
+	//2000-01-01 00:00:00
+	base_seconds = 946684800;
+	base_cycles = now;
+}
+
+void sim::ds1307::set(int64_t const seconds) {
+	base_seconds = seconds;
+	base_cycles = now;
+	latched = -1;
+}
+
+int64_t sim::ds1307::get() {
+	if (halted)
+		return(base_seconds);
+	return(base_seconds + static_cast<int64_t>(((now - base_cycles) * speed) / f_cpu));
+}
+
+void sim::ds1307::set_speed(uint16_t const p0) {
+	set(get());
+	speed = p0 ? p0 : 1;
+}
+
+bool sim::ds1307::start(bool const read) {
+	latch();
+	pointer_next = !read;
+	return(true);
+}
+
+bool sim::ds1307::write(uint8_t const p0) {
+	if (pointer_next) {
+		pointer = p0 & 0x3f;
+		pointer_next = false;
+		return(true);
+	}
+	if (pointer <= 6)
+		time_written = true;
+	ram[pointer] = p0;
+	pointer = (pointer + 1) & 0x3f;
+	return(true);
+}
+
+uint8_t sim::ds1307::read() {
+	uint8_t const value = ram[pointer];
+	pointer = (pointer + 1) & 0x3f;
+	return(value);
+}
+
+void sim::ds1307::stop() {
+	if (time_written)
+		unlatch();
+	time_written = false;
+}
+
+//Half seconds since base_cycles (the square wave is high for the first half of each second)
+static uint64_t half_seconds(uint64_t const at) {
+	return(((at - base_cycles) * speed * 2) / sim::f_cpu);
+}
+
+bool sim::ds1307::sqw() {
+	if (!(ram[7] & 0x10) || halted)
+		return(ram[7] & 0x80);
+	if (ram[7] & 0x03)
+		return(true);
+	return(!(half_seconds(now) & 0x01));
+}
+
+uint64_t sim::ds1307::sqw_next() {
+	if (!(ram[7] & 0x10) || (ram[7] & 0x03) || halted)
+		return(never);
+	uint64_t const next = half_seconds(now) + 1;
+	//The first cycle that's into the next half second
+	return(base_cycles + ((next * f_cpu) + (speed * 2) - 1) / (speed * 2));
+}
@@ -0,0 +1,292 @@
+#include "sim.h"
+#include <string.h>
+
+//DS18B20s on the 1-Wire bus (PB2), at standard speed. Each sensor follows the bus on its own and only ever pulls it low,
+//so several answer together (wired AND) the way real ones do, which is what the ROM search relies on.
+//The master is taken to start a slot when it pulls the bus low, and what it meant is worked out when it lets go:
+//held past reset_min is a reset, otherwise a write 0 if it held it past sample (when a sensor samples the bus), or a 1.
+//A sensor sending a 0 holds the bus low from the start of the slot until hold.
+
+static constexpr uint64_t us(uint64_t const p0) {
+	return(p0 * (sim::f_cpu / 1000000));
+}
+//A reset is 480us, less some slack (a slot is 120us at most)
+static constexpr uint64_t reset_min = us(400);
+static constexpr uint64_t sample = us(30);
+static constexpr uint64_t hold = us(30);
+//The presence pulse, from when the master lets go of a reset
+static constexpr uint64_t presence_start = us(30);
+static constexpr uint64_t presence_end = us(150);
+
+enum class Mode : uint8_t {
+	idle,			//Waiting for a reset
+	rom,			//Taking the ROM command
+	match,			//Match ROM: comparing the ROM code as it's written
+	search,			//Search ROM: sending a bit of the ROM code and its complement, then taking the masters choice
+	function,		//Taking the function command
+	receive,		//Write scratchpad: taking TH, TL and the configuration
+	send,			//Sending bytes (the scratchpad, or the ROM code)
+	converting		//Sending 0s until the conversion is done, then 1s
+};
+
+struct Sensor {
+	uint8_t rom[8];
+	int16_t temperature;		//What it measures (1/16 C)
+	uint8_t scratchpad[9];
+	uint8_t eeprom[3];			//TH, TL and the configuration, as copied by copy scratchpad
+	Mode mode;
+	Mode after;					//What send goes on to
+	uint8_t buffer[9];			//What's being sent or taken
+	uint8_t length;				//Bytes of it
+	uint8_t bit;				//Bits sent or taken (of the whole buffer, or the ROM code for match and search)
+	uint8_t search_step;		//0 sends the bit, 1 its complement, 2 takes the masters choice
+	bool sent;					//Whether it sent in the slot that's running (so the master letting go isn't a bit)
+	uint64_t converted_at;		//When the conversion running finishes (never if none is)
+	uint64_t pull_from;			//When it holds the bus low
+	uint64_t pull_until;
+};
+
+static Sensor sensors[sim::ds18b20::sensor_max];
+static uint8_t amount = 1;
+static bool master_low = false;
+static uint64_t fell_at = 0;
+
+static uint8_t crc8(uint8_t const data[], uint8_t const len) {
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (uint8_t j = 0; j < 8; j++) {
+			crc = (crc & 0x01) ? (crc >> 1) ^ 0x8c : crc >> 1;
+		}
+	}
+	return(crc);
+}
+
+//Conversion time at the configuration registers resolution (93.75ms at 9 bits to 750ms at 12)
+static uint64_t conversion_time(Sensor const &p0) {
+	return(sim::ms(750) >> (3 - ((p0.scratchpad[4] >> 5) & 0x03)));
+}
+
+//Takes the temperature into the scratchpad once the conversion is done (the bits below the resolution are left 0)
+static void convert(Sensor &p0) {
+	if ((p0.converted_at == sim::never) || (sim::now < p0.converted_at))
+		return;
+	p0.converted_at = sim::never;
+	uint8_t const drop = 3 - ((p0.scratchpad[4] >> 5) & 0x03);
+	uint16_t const value = static_cast<uint16_t>(p0.temperature) & ~((1 << drop) - 1);
+	p0.scratchpad[0] = static_cast<uint8_t>(value);
+	p0.scratchpad[1] = static_cast<uint8_t>(value >> 8);
+	p0.scratchpad[8] = crc8(p0.scratchpad, 8);
+}
+
+static void send(Sensor &p0, uint8_t const data[], uint8_t const len, Mode const after) {
+	memcpy(p0.buffer, data, len);
+	p0.length = len;
+	p0.bit = 0;
+	p0.mode = Mode::send;
+	p0.after = after;
+}
+
+static void take(Sensor &p0, Mode const mode, uint8_t const len) {
+	memset(p0.buffer, 0, sizeof(p0.buffer));
+	p0.length = len;
+	p0.bit = 0;
+	p0.mode = mode;
+}
+
+static void rom_command(Sensor &p0, uint8_t const command) {
+	switch (command) {
+	case 0xcc:		//Skip ROM
+		take(p0, Mode::function, 1);
+		break;
+	case 0x55:		//Match ROM
+		take(p0, Mode::match, 8);
+		break;
+	case 0x33:		//Read ROM
+		send(p0, p0.rom, 8, Mode::function);
+		break;
+	case 0xf0:		//Search ROM
+		p0.mode = Mode::search;
+		p0.bit = 0;
+		p0.search_step = 0;
+		break;
+	default:		//Alarm search (no alarms are modelled), or something it doesn't know
+		p0.mode = Mode::idle;
+		break;
+	}
+}
+
+static void function_command(Sensor &p0, uint8_t const command) {
+	switch (command) {
+	case 0x44:		//Convert T
+		p0.converted_at = sim::now + conversion_time(p0);
+		p0.mode = Mode::converting;
+		break;
+	case 0xbe:		//Read scratchpad
+		convert(p0);
+		send(p0, p0.scratchpad, 9, Mode::idle);
+		break;
+	case 0x4e:		//Write scratchpad
+		take(p0, Mode::receive, 3);
+		break;
+	case 0x48:		//Copy scratchpad
+		memcpy(p0.eeprom, p0.scratchpad + 2, 3);
+		p0.mode = Mode::idle;
+		break;
+	case 0xb8:		//Recall EEPROM
+		memcpy(p0.scratchpad + 2, p0.eeprom, 3);
+		p0.scratchpad[8] = crc8(p0.scratchpad, 8);
+		p0.mode = Mode::idle;
+		break;
+	default:		//Read power supply (it's powered, so it sends 1s, which is leaving the bus alone), or something it doesn't know
+		p0.mode = Mode::idle;
+		break;
+	}
+}
+
+//Takes a bit the master wrote
+static void receive(Sensor &p0, bool const value) {
+	if (p0.mode == Mode::search) {
+		//Only the sensors whose bit the master chose carry on
+		if (value != ((p0.rom[p0.bit >> 3] >> (p0.bit & 0x07)) & 0x01)) {
+			p0.mode = Mode::idle;
+			return;
+		}
+		p0.bit++;
+		p0.search_step = 0;
+		if (p0.bit == 64)
+			take(p0, Mode::function, 1);
+		return;
+	}
+	if (value)
+		p0.buffer[p0.bit >> 3] |= 1 << (p0.bit & 0x07);
+	p0.bit++;
+	if (p0.mode == Mode::match) {
+		if (value != ((p0.rom[(p0.bit - 1) >> 3] >> ((p0.bit - 1) & 0x07)) & 0x01))
+			p0.mode = Mode::idle;
+		else if (p0.bit == 64)
+			take(p0, Mode::function, 1);
+		return;
+	}
+	if (p0.bit < p0.length * 8)
+		return;
+	switch (p0.mode) {
+	case Mode::rom:
+		rom_command(p0, p0.buffer[0]);
+		break;
+	case Mode::function:
+		function_command(p0, p0.buffer[0]);
+		break;
+	case Mode::receive:
+		//Only the resolution bits of the configuration can be written
+		p0.scratchpad[2] = p0.buffer[0];
+		p0.scratchpad[3] = p0.buffer[1];
+		p0.scratchpad[4] = (p0.buffer[2] & 0x60) | 0x1f;
+		p0.scratchpad[8] = crc8(p0.scratchpad, 8);
+		p0.mode = Mode::idle;
+		break;
+	default:
+		break;
+	}
+}
+
+//The master started a slot. Returns the bit the sensor sends in it, or true if it isn't sending.
+static bool slot(Sensor &p0) {
+	p0.sent = true;
+	switch (p0.mode) {
+	case Mode::send:
+	{
+		bool const value = (p0.buffer[p0.bit >> 3] >> (p0.bit & 0x07)) & 0x01;
+		p0.bit++;
+		if (p0.bit == p0.length * 8) {
+			if (p0.after == Mode::function)
+				take(p0, Mode::function, 1);
+			else
+				p0.mode = p0.after;
+		}
+		return(value);
+	}
+	case Mode::search:
+		if (p0.search_step < 2) {
+			bool const value = (p0.rom[p0.bit >> 3] >> (p0.bit & 0x07)) & 0x01;
+			p0.search_step++;
+			return((p0.search_step == 1) ? value : !value);
+		}
+		break;
+	case Mode::converting:
+		convert(p0);
+		return(p0.converted_at == sim::never);
+	default:
+		break;
+	}
+	p0.sent = false;
+	return(true);
+}
+
+void sim::ds18b20::reset() {
+	master_low = false;
+	fell_at = 0;
+	for (uint8_t i = 0; i < sensor_max; i++) {
+		Sensor &sensor = sensors[i];
+		memset(&sensor, 0, sizeof(sensor));
+		//Family 0x28, then a serial number
+		uint8_t const rom[8] = { 0x28, static_cast<uint8_t>(0x10 + (i * 0x25)), 0x4e, static_cast<uint8_t>(0x9d ^ i), 0x07, 0x00, 0x00, 0x00 };
+		memcpy(sensor.rom, rom, 7);
+		sensor.rom[7] = crc8(sensor.rom, 7);
+		sensor.temperature = 21 * 16;
+		//Power on: 85C, no alarms, 12 bits
+		uint8_t const scratchpad[8] = { 0x50, 0x05, 0x4b, 0x46, 0x7f, 0xff, 0x0c, 0x10 };
+		memcpy(sensor.scratchpad, scratchpad, 8);
+		sensor.scratchpad[8] = crc8(sensor.scratchpad, 8);
+		memcpy(sensor.eeprom, sensor.scratchpad + 2, 3);
+		sensor.mode = Mode::idle;
+		sensor.converted_at = never;
+		sensor.pull_from = sensor.pull_until = 0;
+	}
+}
+
+void sim::ds18b20::set_amount(uint8_t const p0) {
+	amount = (p0 > sensor_max) ? sensor_max : p0;
+}
+
+void sim::ds18b20::set(int16_t const temperature, uint8_t const sensor) {
+	if (sensor < sensor_max)
+		sensors[sensor].temperature = temperature;
+}
+
+void sim::ds18b20::master(bool const low) {
+	if (low == master_low)
+		return;
+	master_low = low;
+	if (low) {
+		fell_at = now;
+		for (uint8_t i = 0; i < amount; i++) {
+			if (!slot(sensors[i])) {
+				sensors[i].pull_from = now;
+				sensors[i].pull_until = now + hold;
+			}
+		}
+		return;
+	}
+	uint64_t const held = now - fell_at;
+	for (uint8_t i = 0; i < amount; i++) {
+		Sensor &sensor = sensors[i];
+		if (held >= reset_min) {
+			take(sensor, Mode::rom, 1);
+			sensor.pull_from = now + presence_start;
+			sensor.pull_until = now + presence_end;
+		}
+		else if (!sensor.sent && (sensor.mode != Mode::idle) && (sensor.mode != Mode::converting)) {
+			receive(sensor, held < sample);
+		}
+		sensor.sent = false;
+	}
+}
+
+bool sim::ds18b20::pulling() {
+	for (uint8_t i = 0; i < amount; i++) {
+		if ((now >= sensors[i].pull_from) && (now < sensors[i].pull_until))
+			return(true);
+	}
+	return(false);
+}
@@ -0,0 +1,192 @@
+#include "sim.h"
+#include <string.h>
+
+//The pins, as lcd.cpp drives them: data 0-3 on PB0, PB3, PB4, PB5, RS on PD3, R/W on PD4, E on PD7
+static constexpr uint8_t data_shift[4] = { 0, 3, 4, 5 };
+static constexpr uint8_t rs_shift = 3;
+static constexpr uint8_t rw_shift = 4;
+static constexpr uint8_t enable_shift = 7;
+
+//DDRAM holds 0x00-0x27 (line 1) and 0x40-0x67 (line 2)
+static uint8_t ddram[0x80];
+static uint8_t cgram[0x40];
+static uint8_t address = 0;
+static bool in_cgram = false;
+static bool increment = true;
+static bool display_on = false;
+static bool four_bit = false;
+static bool high_next = true;
+static uint8_t high = 0;
+static uint32_t change_amount = 0;
+
+//What the pins held while E was high (the HD44780 takes it on the falling edge)
+static bool enabled = false;
+static uint8_t latched_nibble = 0;
+static bool latched_rs = false;
+static bool latched_rw = false;
+static bool drawn = false;
+
+static void step() {
+	if (in_cgram) {
+		address = (address + (increment ? 1 : -1)) & 0x3f;
+		return;
+	}
+	if (increment)
+		address = (address == 0x27) ? 0x40 : ((address == 0x67) ? 0x00 : address + 1);
+	else
+		address = (address == 0x40) ? 0x27 : ((address == 0x00) ? 0x67 : address - 1);
+}
+
+static void instruction(uint8_t const p0) {
+	if (p0 & 0x80) {
+		address = p0 & 0x7f;
+		in_cgram = false;
+	}
+	else if (p0 & 0x40) {
+		address = p0 & 0x3f;
+		in_cgram = true;
+	}
+	else if (p0 & 0x20) {
+		//Function set (only the data length matters here)
+		bool const was_four_bit = four_bit;
+		four_bit = !(p0 & 0x10);
+		if (four_bit != was_four_bit)
+			high_next = true;
+	}
+	else if (p0 & 0x10) {
+		//Cursor or display shift (only cursor moves are followed)
+		if (!(p0 & 0x08)) {
+			bool const was_increment = increment;
+			increment = p0 & 0x04;
+			step();
+			increment = was_increment;
+		}
+	}
+	else if (p0 & 0x08) {
+		display_on = p0 & 0x04;
+		change_amount++;
+	}
+	else if (p0 & 0x04) {
+		increment = p0 & 0x02;
+	}
+	else if (p0 & 0x02) {
+		address = 0;
+		in_cgram = false;
+	}
+	else if (p0 & 0x01) {
+		memset(ddram, ' ', sizeof(ddram));
+		address = 0;
+		in_cgram = false;
+		increment = true;
+		change_amount++;
+	}
+}
+
+static void data(uint8_t const p0) {
+	if (in_cgram) {
+		cgram[address] = p0;
+	}
+	else if (ddram[address] != p0) {
+		ddram[address] = p0;
+		change_amount++;
+	}
+	step();
+}
+
+static void transfer(uint8_t const nibble, bool const rs) {
+	uint8_t value;
+	//Until it's set to 4 bits, each transfer is a whole byte (with DB0-3 not wired, so 0)
+	if (!four_bit) {
+		value = nibble << 4;
+	}
+	else if (high_next) {
+		high = nibble;
+		high_next = false;
+		return;
+	}
+	else {
+		value = (high << 4) | nibble;
+		high_next = true;
+	}
+	if (rs)
+		data(value);
+	else
+		instruction(value);
+}
+
+void sim::lcd::reset() {
+	memset(ddram, ' ', sizeof(ddram));
+	memset(cgram, 0, sizeof(cgram));
+	address = 0;
+	in_cgram = false;
+	increment = true;
+	display_on = false;
+	four_bit = false;
+	high_next = true;
+	enabled = false;
+	change_amount = 0;
+	drawn = false;
+}
+
+void sim::lcd::poll() {
+	uint8_t const portd = hal::peek(0x2b);
+	if (portd & _BV(enable_shift)) {
+		uint8_t const portb = hal::peek(0x25);
+		latched_nibble = 0;
+		for (uint8_t i = 0; i < 4; i++) {
+			if (portb & _BV(data_shift[i]))
+				latched_nibble |= 1 << i;
+		}
+		latched_rs = portd & _BV(rs_shift);
+		latched_rw = portd & _BV(rw_shift);
+		enabled = true;
+		return;
+	}
+	if (!enabled)
+		return;
+	enabled = false;
+	//A read (of the busy flag or address) still uses up a nibble
+	if (latched_rw) {
+		if (four_bit)
+			high_next = !high_next;
+		return;
+	}
+	transfer(latched_nibble, latched_rs);
+}
+
+void sim::lcd::line(uint8_t const p0, char out[columns + 1]) {
+	for (uint8_t i = 0; i < columns; i++) {
+		uint8_t const c = ddram[(p0 ? 0x40 : 0x00) + i];
+		if (!display_on)
+			out[i] = ' ';
+		else if ((c < 0x10) || (c == 0xff))
+			out[i] = '#';
+		else if (c == 0xa5)
+			out[i] = '.';
+		else if ((c >= 0x20) && (c < 0x7f))
+			out[i] = static_cast<char>(c);
+		else
+			out[i] = '?';
+	}
+	out[columns] = '\0';
+}
+
+uint32_t sim::lcd::changes() {
+	return(change_amount);
+}
+
+void sim::lcd::draw(FILE *const p0, bool const in_place) {
+	char text[columns + 1];
+	if (in_place && drawn)
+		fprintf(p0, "\x1b[%uA", lines + 2);
+	drawn = true;
+	uint32_t const seconds = static_cast<uint32_t>(now / f_cpu);
+	fprintf(p0, "+ %02u:%02u:%02u.%03u --+\n", seconds / 3600, (seconds / 60) % 60, seconds % 60,
+		static_cast<uint32_t>((now % f_cpu) / (f_cpu / 1000)));
+	for (uint8_t i = 0; i < lines; i++) {
+		line(i, text);
+		fprintf(p0, "|%s|\n", text);
+	}
+	fprintf(p0, "+----------------+\n");
+	fflush(p0);
+}
@@ -0,0 +1,475 @@
+#include "sim.h"
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+//The command line front end of the simulator (see usage()).
+//A script is a timeline of inputs, one per line (times from the start of the run, # starts a comment):
+//	2s light 40							set the light level (0-255)
+//	2s audio 200						set the audio input level (0-255, 128 is silence)
+//	5s press / 5.5s release / 10s click	the power button (a click is held for 100ms)
+//	5s click input0						the same for the generic inputs (input0 or input1)
+//	1m rtc 2024-12-31 23:59:50			set the DS1307
+//	3m temp -10.5 / 3m temp 30 1		set what every DS18B20 (or just one, from 0) measures (C)
+//	5m sensors 2						plug DS18B20s in or out, so that many are on the bus (the last ones go first)
+//	90s uart m							send bytes to the UART (telemetry commands, \xNN for any byte)
+//	2m lcd								draw the LCD
+
+static void usage(FILE *const p0) {
+	fprintf(p0,
+		"usage: sim [options]\n"
+		"  -t, --time TIME        how long to run (eg 90s, 15m, 24h, default 10s)\n"
+		"  -s, --script FILE      timeline of inputs (see the top of host/sim/main.cpp)\n"
+		"  -r, --rtc DATE TIME    what the DS1307 starts at (default \"2024-01-01 12:00:00\")\n"
+		"  -x, --rtc-speed N      run the DS1307 N times faster than real time (default 1)\n"
+		"  -l, --light LEVEL      the starting light level (0-255, default 128)\n"
+		"  -w, --sensors N        DS18B20s on the 1-Wire bus (0-%u, default 1)\n"
+		"  -d, --lcd              draw the LCD whenever it changes\n"
+		"  -i, --sample TIME      time between samples (default 1s)\n"
+		"  -o, --record FILE      write the samples (LCD and neopixels) to FILE\n"
+		"  -g, --golden FILE      compare the samples with FILE (exits with 1 on a difference)\n"
+		"  -c, --counters FILE    write the per frame work counters of each sample as CSV\n"
+		"  -u, --uart FILE        write the UART output (telemetry) to FILE\n"
+		"  -a, --access-cycles N  cycles each register access costs (default %u)\n",
+		sim::ds18b20::sensor_max, sim::access_cycles);
+}
+
+//Parses a time such as 250ms, 1.5s, 90 (seconds), 15m or 24h into cycles
+static bool parse_time(char const *p0, uint64_t &out) {
+	char *end;
+	double const value = strtod(p0, &end);
+	double scale;
+	if (!strcmp(end, "ms"))
+		scale = 0.001;
+	else if (!strcmp(end, "s") || !*end)
+		scale = 1;
+	else if (!strcmp(end, "m"))
+		scale = 60;
+	else if (!strcmp(end, "h"))
+		scale = 3600;
+	else
+		return(false);
+	if ((end == p0) || (value < 0))
+		return(false);
+	out = static_cast<uint64_t>(value * scale * sim::f_cpu);
+	return(true);
+}
+
+//Parses "YYYY-MM-DD HH:MM:SS" into seconds since 1970 (UTC)
+static bool parse_date(char const *p0, int64_t &out) {
+	tm time = {};
+	if (sscanf(p0, "%d-%d-%d %d:%d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday, &time.tm_hour, &time.tm_min, &time.tm_sec) != 6)
+		return(false);
+	if ((time.tm_year < 2000) || (time.tm_year > 2099))
+		return(false);
+	time.tm_year -= 1900;
+	time.tm_mon -= 1;
+	out = timegm(&time);
+	return(true);
+}
+
+//Parses a temperature in C (to 1/16 C), and the sensor it's for (-1 for every sensor if there's none)
+static bool parse_temperature(char const *p0, int16_t &out, int &sensor) {
+	double value;
+	sensor = -1;
+	if (sscanf(p0, "%lf %d", &value, &sensor) < 1)
+		return(false);
+	if ((value < -55) || (value > 125) || (sensor >= sim::ds18b20::sensor_max))
+		return(false);
+	out = static_cast<int16_t>(lround(value * 16));
+	return(true);
+}
+
+//Parses a button name (nothing is the power button)
+static bool parse_button(char const *p0, input::Button &out) {
+	char name[16] = "power";
+	sscanf(p0, "%15s", name);
+	if (!strcmp(name, "power"))
+		out = input::Button::power;
+	else if (!strcmp(name, "input0"))
+		out = input::Button::input0;
+	else if (!strcmp(name, "input1"))
+		out = input::Button::input1;
+	else
+		return(false);
+	return(true);
+}
+
+static std::string format_time(uint64_t const p0) {
+	uint32_t const seconds = static_cast<uint32_t>(p0 / sim::f_cpu);
+	char text[32];
+	snprintf(text, sizeof(text), "%02u:%02u:%02u.%03u", seconds / 3600, (seconds / 60) % 60, seconds % 60,
+		static_cast<uint32_t>((p0 % sim::f_cpu) / (sim::f_cpu / 1000)));
+	return(text);
+}
+
+//---Script---//
+
+static bool lcd_draw = false;
+static bool lcd_in_place = false;
+
+//Reads the script, scheduling each line. Returns false (after saying why) if a line is wrong.
+static bool load_script(char const *path) {
+	FILE *const file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return(false);
+	}
+	char line[256];
+	unsigned number = 0;
+	bool good = true;
+	while (fgets(line, sizeof(line), file)) {
+		number++;
+		line[strcspn(line, "\r\n")] = '\0';
+		char *const text = line + strspn(line, " \t");
+		if (!*text || (*text == '#'))
+			continue;
+		char time_text[32];
+		char command[32];
+		int used = 0;
+		uint64_t time;
+		if ((sscanf(text, "%31s %31s %n", time_text, command, &used) < 2) || !parse_time(time_text, time)) {
+			fprintf(stderr, "%s:%u: expected a time and a command\n", path, number);
+			good = false;
+			continue;
+		}
+		std::string const argument = text + used;
+		int const value = atoi(argument.c_str());
+		int64_t seconds;
+		input::Button button;
+		int16_t temperature;
+		int sensor;
+		if (!strcmp(command, "light") && !argument.empty() && (value >= 0) && (value <= 255)) {
+			sim::schedule(time, [value]() { sim::set_light(value); });
+		}
+		else if (!strcmp(command, "audio") && !argument.empty() && (value >= 0) && (value <= 255)) {
+			sim::schedule(time, [value]() { sim::set_audio(value); });
+		}
+		else if (!strcmp(command, "press") && parse_button(argument.c_str(), button)) {
+			sim::schedule(time, [button]() { sim::set_button(true, button); });
+		}
+		else if (!strcmp(command, "release") && parse_button(argument.c_str(), button)) {
+			sim::schedule(time, [button]() { sim::set_button(false, button); });
+		}
+		else if (!strcmp(command, "click") && parse_button(argument.c_str(), button)) {
+			sim::schedule(time, [button]() { sim::set_button(true, button); });
+			sim::schedule(time + sim::ms(100), [button]() { sim::set_button(false, button); });
+		}
+		else if (!strcmp(command, "temp") && parse_temperature(argument.c_str(), temperature, sensor)) {
+			sim::schedule(time, [temperature, sensor]() {
+				for (uint8_t i = 0; i < sim::ds18b20::sensor_max; i++) {
+					if ((sensor < 0) || (sensor == i))
+						sim::ds18b20::set(temperature, i);
+				}
+			});
+		}
+		else if (!strcmp(command, "sensors") && !argument.empty() && (value >= 0) && (value <= sim::ds18b20::sensor_max)) {
+			sim::schedule(time, [value]() { sim::ds18b20::set_amount(value); });
+		}
+		else if (!strcmp(command, "rtc") && parse_date(argument.c_str(), seconds)) {
+			sim::schedule(time, [seconds]() { sim::ds1307::set(seconds); });
+		}
+		else if (!strcmp(command, "uart") && !argument.empty()) {
+			//\xNN stands for any byte (for commands with binary arguments)
+			std::string bytes;
+			for (size_t i = 0; i < argument.size(); i++) {
+				if ((argument.compare(i, 2, "\\x") == 0) && (i + 3 < argument.size()) && isxdigit(argument[i + 2]) && isxdigit(argument[i + 3])) {
+					bytes += static_cast<char>(strtol(argument.substr(i + 2, 2).c_str(), nullptr, 16));
+					i += 3;
+				}
+				else {
+					bytes += argument[i];
+				}
+			}
+			sim::schedule(time, [bytes]() { sim::uart_send(bytes.c_str(), bytes.size()); });
+		}
+		else if (!strcmp(command, "lcd")) {
+			sim::schedule(time, []() { sim::lcd::draw(stdout, false); });
+		}
+		else {
+			fprintf(stderr, "%s:%u: don't understand '%s'\n", path, number, text);
+			good = false;
+		}
+	}
+	fclose(file);
+	return(good);
+}
+
+//---Frames and samples---//
+
+static uint64_t host_ns() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return((static_cast<uint64_t>(time.tv_sec) * 1000000000) + time.tv_nsec);
+}
+
+//Per frame work, over one sample
+struct Work {
+	uint32_t frames;
+	uint64_t cycles;
+	uint64_t cycles_max;
+	uint64_t accesses;
+	uint64_t accesses_max;
+	uint64_t interrupts;
+	uint64_t interrupts_max;
+	uint64_t host_ns;
+	uint64_t host_ns_max;
+};
+static Work work = {};
+static Work total = {};
+
+//The counters at the last frame
+static uint64_t last_cycles = 0;
+static uint64_t last_accesses = 0;
+static uint64_t last_interrupts = 0;
+static uint64_t last_host_ns = 0;
+static uint32_t last_lcd_changes = 0;
+
+static std::vector<cRGB> leds;
+
+static void add(Work &p0, uint64_t const cycles, uint64_t const accesses, uint64_t const interrupts, uint64_t const ns) {
+	p0.frames++;
+	p0.cycles += cycles;
+	p0.accesses += accesses;
+	p0.interrupts += interrupts;
+	p0.host_ns += ns;
+	if (cycles > p0.cycles_max)
+		p0.cycles_max = cycles;
+	if (accesses > p0.accesses_max)
+		p0.accesses_max = accesses;
+	if (interrupts > p0.interrupts_max)
+		p0.interrupts_max = interrupts;
+	if (ns > p0.host_ns_max)
+		p0.host_ns_max = ns;
+}
+
+static void draw_lcd() {
+	if (lcd_draw && (sim::lcd::changes() != last_lcd_changes)) {
+		last_lcd_changes = sim::lcd::changes();
+		sim::lcd::draw(stdout, lcd_in_place);
+	}
+}
+
+static void frame(cRGB const led[], uint16_t const len) {
+	uint64_t const ns = host_ns();
+	sim::counters.frames++;
+	leds.assign(led, led + len);
+	uint64_t const cycles = sim::now - last_cycles;
+	uint64_t const accesses = sim::counters.accesses - last_accesses;
+	uint64_t const interrupts = sim::counters.interrupts - last_interrupts;
+	add(work, cycles, accesses, interrupts, ns - last_host_ns);
+	add(total, cycles, accesses, interrupts, ns - last_host_ns);
+	last_cycles = sim::now;
+	last_accesses = sim::counters.accesses;
+	last_interrupts = sim::counters.interrupts;
+	last_host_ns = ns;
+	draw_lcd();
+}
+
+static uint64_t sample_interval = sim::ms(1000);
+static uint64_t next_sample = 0;
+static FILE *record_file = nullptr;
+static FILE *counters_file = nullptr;
+static bool golden_used = false;
+static std::vector<std::string> golden;
+static size_t sample_index = 0;
+static uint32_t differences = 0;
+
+//One line per sample: the time, both LCD lines, and every neopixel (rrggbb)
+static std::string sample_line() {
+	std::string out = format_time(sim::now);
+	char text[sim::lcd::columns + 1];
+	out += " |";
+	for (uint8_t i = 0; i < sim::lcd::lines; i++) {
+		sim::lcd::line(i, text);
+		out += text;
+		out += "|";
+	}
+	for (cRGB const &p : leds) {
+		char colour[8];
+		snprintf(colour, sizeof(colour), " %02x%02x%02x", p.r, p.g, p.b);
+		out += colour;
+	}
+	return(out);
+}
+
+static void sample() {
+	std::string const line = sample_line();
+	if (record_file)
+		fprintf(record_file, "%s\n", line.c_str());
+	if (golden_used) {
+		std::string const expected = (sample_index < golden.size()) ? golden[sample_index] : "(nothing)";
+		if (line != expected) {
+			differences++;
+			if (differences <= 5)
+				fprintf(stderr, "golden difference at sample %zu\n  expected %s\n  got      %s\n", sample_index, expected.c_str(), line.c_str());
+		}
+	}
+	if (counters_file) {
+		uint32_t const frames = work.frames ? work.frames : 1;
+		fprintf(counters_file, "%s,%u,%llu,%llu,%llu,%llu,%.2f,%llu,%llu,%llu\n", format_time(sim::now).c_str(), work.frames,
+			static_cast<unsigned long long>(work.cycles / frames), static_cast<unsigned long long>(work.cycles_max),
+			static_cast<unsigned long long>(work.accesses / frames), static_cast<unsigned long long>(work.accesses_max),
+			static_cast<double>(work.interrupts) / frames, static_cast<unsigned long long>(work.interrupts_max),
+			static_cast<unsigned long long>(work.host_ns / frames), static_cast<unsigned long long>(work.host_ns_max));
+	}
+	work = {};
+	sample_index++;
+	draw_lcd();
+	next_sample += sample_interval;
+	sim::schedule(next_sample, sample);
+}
+
+int main(int argc, char *argv[]) {
+	static option const options[] = {
+		{ "time", required_argument, nullptr, 't' },
+		{ "script", required_argument, nullptr, 's' },
+		{ "rtc", required_argument, nullptr, 'r' },
+		{ "rtc-speed", required_argument, nullptr, 'x' },
+		{ "light", required_argument, nullptr, 'l' },
+		{ "sensors", required_argument, nullptr, 'w' },
+		{ "lcd", no_argument, nullptr, 'd' },
+		{ "sample", required_argument, nullptr, 'i' },
+		{ "record", required_argument, nullptr, 'o' },
+		{ "golden", required_argument, nullptr, 'g' },
+		{ "counters", required_argument, nullptr, 'c' },
+		{ "uart", required_argument, nullptr, 'u' },
+		{ "access-cycles", required_argument, nullptr, 'a' },
+		{ "help", no_argument, nullptr, 'h' },
+		{ nullptr, 0, nullptr, 0 }
+	};
+	uint64_t run_time = sim::ms(10000);
+	int64_t rtc;
+	parse_date("2024-01-01 12:00:00", rtc);
+	int light = 128;
+	int sensors = 1;
+	int rtc_speed = 1;
+	char const *script = nullptr;
+	char const *golden_path = nullptr;
+	FILE *uart_file = nullptr;
+	int option;
+	while ((option = getopt_long(argc, argv, "t:s:r:x:l:w:di:o:g:c:u:a:h", options, nullptr)) != -1) {
+		bool good = true;
+		switch (option) {
+		case 't':
+			good = parse_time(optarg, run_time);
+			break;
+		case 's':
+			script = optarg;
+			break;
+		case 'r':
+			good = parse_date(optarg, rtc);
+			break;
+		case 'x':
+			rtc_speed = atoi(optarg);
+			good = (rtc_speed >= 1) && (rtc_speed <= 3600);
+			break;
+		case 'l':
+			light = atoi(optarg);
+			good = (light >= 0) && (light <= 255);
+			break;
+		case 'w':
+			sensors = atoi(optarg);
+			good = (sensors >= 0) && (sensors <= sim::ds18b20::sensor_max);
+			break;
+		case 'd':
+			lcd_draw = true;
+			break;
+		case 'i':
+			good = parse_time(optarg, sample_interval) && sample_interval;
+			break;
+		case 'o':
+			good = (record_file = fopen(optarg, "w"));
+			break;
+		case 'g':
+			golden_path = optarg;
+		golden_used = true;
+			break;
+		case 'c':
+			good = (counters_file = fopen(optarg, "w"));
+			break;
+		case 'u':
+			good = (uart_file = fopen(optarg, "wb"));
+			break;
+		case 'a':
+			sim::access_cycles = atoi(optarg);
+			break;
+		case 'h':
+			usage(stdout);
+			return(0);
+		default:
+			good = false;
+			break;
+		}
+		if (!good) {
+			if (option != '?')
+				fprintf(stderr, "sim: bad value for -%c: %s\n", option, optarg);
+			usage(stderr);
+			return(2);
+		}
+	}
+
+	if (golden_path) {
+		FILE *const file = fopen(golden_path, "r");
+		if (!file) {
+			perror(golden_path);
+			return(2);
+		}
+		char line[1024];
+		while (fgets(line, sizeof(line), file)) {
+			line[strcspn(line, "\r\n")] = '\0';
+			golden.push_back(line);
+		}
+		fclose(file);
+	}
+	if (counters_file)
+		fprintf(counters_file, "time,frames,cycles_avg,cycles_max,accesses_avg,accesses_max,interrupts_avg,interrupts_max,host_ns_avg,host_ns_max\n");
+	lcd_in_place = lcd_draw && !record_file && isatty(fileno(stdout));
+
+	sim::init();
+	sim::ds1307::set(rtc);
+	sim::ds1307::set_speed(rtc_speed);
+	sim::set_light(light);
+	sim::ds18b20::set_amount(sensors);
+	sim::uart_output(uart_file);
+	ws2812::sink = frame;
+	if (script && !load_script(script))
+		return(2);
+	next_sample = sample_interval;
+	sim::schedule(next_sample, sample);
+
+	uint64_t const start = host_ns();
+	last_host_ns = start;
+	sim::run(run_time);
+	double const seconds = (host_ns() - start) / 1e9;
+
+	if (golden_path && (sample_index < golden.size())) {
+		differences++;
+		fprintf(stderr, "golden has %zu samples, the run made %zu\n", golden.size(), sample_index);
+	}
+	uint32_t const frames = total.frames ? total.frames : 1;
+	fprintf(stderr, "simulated %s in %.2fs (%.0fx real time)\n", format_time(sim::now).c_str(), seconds,
+		(static_cast<double>(sim::now) / sim::f_cpu) / (seconds > 0 ? seconds : 1e-9));
+	fprintf(stderr, "%llu frames, per frame: %llu cycles (max %llu), %llu register accesses (max %llu), %.2f interrupts (max %llu), %llu host ns (max %llu)\n",
+		static_cast<unsigned long long>(total.frames),
+		static_cast<unsigned long long>(total.cycles / frames), static_cast<unsigned long long>(total.cycles_max),
+		static_cast<unsigned long long>(total.accesses / frames), static_cast<unsigned long long>(total.accesses_max),
+		static_cast<double>(total.interrupts) / frames, static_cast<unsigned long long>(total.interrupts_max),
+		static_cast<unsigned long long>(total.host_ns / frames), static_cast<unsigned long long>(total.host_ns_max));
+	if (golden_path)
+		fprintf(stderr, "golden: %s (%u differences)\n", differences ? "FAIL" : "ok", differences);
+
+	if (record_file)
+		fclose(record_file);
+	if (counters_file)
+		fclose(counters_file);
+	if (uart_file)
+		fclose(uart_file);
+	return(differences ? 1 : 0);
+}
@@ -0,0 +1,665 @@
+#include "sim.h"
+#include <avr/io.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <string.h>
+#include <deque>
+#include <map>
+
+uint64_t sim::now = 0;
+uint8_t sim::access_cycles = 2;
+sim::Counters sim::counters = {};
+
+//Cycles an interrupt costs to enter and leave
+static constexpr uint8_t interrupt_cycles = 10;
+
+static uint64_t end_time = sim::never;
+static sigjmp_buf end_jump;
+static bool dispatching = false;
+static bool in_interrupt = false;
+
+//Scripted events, by time
+static std::multimap<uint64_t, std::function<void()>> events;
+
+//Levels on the pins that are inputs (PINB, PINC, PIND)
+static uint8_t pin_in[3];
+static uint8_t light_level = 128;
+static uint8_t audio_level = 128;
+
+//Timer 1 and 2 count from these times (when the counter was last 0) while running, or hold a value while stopped
+static int64_t t1_zero = 0;
+static uint16_t t1_hold = 0;
+static uint16_t t1_prescale = 0;
+static uint64_t t1_compa_at = sim::never;
+static uint64_t t1_compb_at = sim::never;
+static uint64_t t1_ovf_at = sim::never;
+static int64_t t2_zero = 0;
+static uint8_t t2_hold = 0;
+static uint16_t t2_prescale = 0;
+static uint64_t t2_ovf_at = sim::never;
+
+static uint64_t adc_done_at = sim::never;
+
+//The TWI operation in progress, and what it will leave in TWSR/TWDR
+static uint64_t twi_done_at = sim::never;
+static uint8_t twi_status = 0xf8;
+static uint8_t twi_data = 0;
+static bool twi_owned = false;
+static bool twi_read = false;
+static bool twi_addressed = false;
+
+static std::deque<uint8_t> uart_rx;
+static uint64_t uart_rx_at = sim::never;
+static uint64_t uart_tx_at = sim::never;
+static bool uart_tx_buffered = false;
+static uint8_t uart_tx_buffer = 0;
+static FILE *uart_file = nullptr;
+
+//The DS1307s square wave (on PB1)
+static uint64_t sqw_at = sim::never;
+
+//The soonest any of the above falls due
+static uint64_t next_due = sim::never;
+
+static void recalculate() {
+	next_due = events.empty() ? sim::never : events.begin()->first;
+	uint64_t const due[] = { t1_compa_at, t1_compb_at, t1_ovf_at, t2_ovf_at, adc_done_at, twi_done_at, uart_rx_at, uart_tx_at, sqw_at };
+	for (uint64_t const p : due) {
+		if (p < next_due)
+			next_due = p;
+	}
+}
+
+//---Pins---//
+
+static uint8_t pin_value(uint8_t const port) {
+	uint8_t const ddr = hal::peek(0x24 + (port * 3));
+	uint8_t const value = (ddr & hal::peek(0x25 + (port * 3))) | (~ddr & pin_in[port]);
+	//The DS18B20s can pull the 1-Wire bus low over its pull up
+	if ((port == 0) && sim::ds18b20::pulling())
+		return(value & ~_BV(PB2));
+	return(value);
+}
+
+//Keeps PINx up to date as peek() sees it (for the models, and anything reading a port through a pointer, which skips the hooks)
+static void update_pins() {
+	for (uint8_t port = 0; port < 3; port++) {
+		hal::poke(0x23 + (port * 3), pin_value(port));
+	}
+}
+
+//Sets the level something outside puts on input pins (port 0-2 is B-D), flagging the ports pin change interrupt if it
+//watches a pin that changed. PCMSK0-2 and PCIF0-2 follow the ports in the same order.
+static void drive(uint8_t const port, uint8_t const mask, bool const high) {
+	uint8_t const old = pin_value(port);
+	pin_in[port] = high ? (pin_in[port] | mask) : (pin_in[port] & ~mask);
+	if ((old ^ pin_value(port)) & hal::peek(0x6b + port))
+		hal::poke(0x3b, hal::peek(0x3b) | _BV(port));
+	update_pins();
+}
+
+//Follows the DS1307s SQW/OUT on PB1
+static void update_sqw() {
+	drive(0, _BV(PB1), sim::ds1307::sqw());
+	sqw_at = sim::ds1307::sqw_next();
+}
+
+//---Timers---//
+
+static uint16_t const t1_prescales[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+static uint16_t const t2_prescales[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+//The first time after now that a counter (counting from zero, wrapping at top + 1) reaches value
+static uint64_t next_count(int64_t const zero, uint16_t const prescale, uint32_t const value, uint32_t const top) {
+	int64_t const period = static_cast<int64_t>(top + 1) * prescale;
+	int64_t const now = static_cast<int64_t>(sim::now);
+	int64_t at = zero + (static_cast<int64_t>(value) * prescale);
+	if (at <= now)
+		at += ((now - at) / period + 1) * period;
+	return(static_cast<uint64_t>(at));
+}
+
+static uint16_t t1_count() {
+	if (!t1_prescale)
+		return(t1_hold);
+	return(static_cast<uint16_t>((static_cast<int64_t>(sim::now) - t1_zero) / t1_prescale));
+}
+
+static void t1_schedule() {
+	if (!t1_prescale) {
+		t1_compa_at = t1_compb_at = t1_ovf_at = sim::never;
+		return;
+	}
+	t1_compa_at = next_count(t1_zero, t1_prescale, (hal::peek(0x89) << 8) | hal::peek(0x88), 0xffff);
+	t1_compb_at = next_count(t1_zero, t1_prescale, (hal::peek(0x8b) << 8) | hal::peek(0x8a), 0xffff);
+	t1_ovf_at = next_count(t1_zero, t1_prescale, 0, 0xffff);
+}
+
+static void t1_set(uint16_t const count) {
+	t1_hold = count;
+	t1_zero = static_cast<int64_t>(sim::now) - (static_cast<int64_t>(count) * t1_prescale);
+	t1_schedule();
+}
+
+static uint8_t t2_count() {
+	if (!t2_prescale)
+		return(t2_hold);
+	return(static_cast<uint8_t>((static_cast<int64_t>(sim::now) - t2_zero) / t2_prescale));
+}
+
+static void t2_set(uint8_t const count) {
+	t2_hold = count;
+	//Writing TCNT2 doesn't reset the prescaler, so the count carries on from the same point in its prescale period
+	int64_t const phase = t2_prescale ? (static_cast<int64_t>(sim::now) - t2_zero) % t2_prescale : 0;
+	t2_zero = static_cast<int64_t>(sim::now) - phase - (static_cast<int64_t>(count) * t2_prescale);
+	t2_ovf_at = t2_prescale ? next_count(t2_zero, t2_prescale, 0, 0xff) : sim::never;
+}
+
+//---ADC---//
+
+static void adc_start() {
+	if (!(hal::peek(0x7a) & _BV(ADEN)) || (adc_done_at != sim::never))
+		return;
+	uint8_t const prescale = 1 << (hal::peek(0x7a) & 0x07);
+	adc_done_at = sim::now + (13 * ((prescale < 2) ? 2 : prescale));
+	hal::poke(0x7a, hal::peek(0x7a) | _BV(ADSC));
+}
+
+static void adc_done() {
+	adc_done_at = sim::never;
+	uint8_t const channel = hal::peek(0x7c) & 0x0f;
+	uint16_t const value = static_cast<uint16_t>((channel == 0) ? light_level : audio_level) << 2;
+	uint16_t const result = (hal::peek(0x7c) & _BV(ADLAR)) ? value << 6 : value;
+	hal::poke(0x78, static_cast<uint8_t>(result));
+	hal::poke(0x79, static_cast<uint8_t>(result >> 8));
+	hal::poke(0x7a, (hal::peek(0x7a) & ~_BV(ADSC)) | _BV(ADIF));
+}
+
+//---TWI---//
+
+static uint32_t twi_bit() {
+	uint8_t const prescale = 1 << ((hal::peek(0xb9) & 0x03) * 2);
+	return(16 + (2 * hal::peek(0xb8) * prescale));
+}
+
+//Starts what a write to TWCR (with TWINT set) asks for
+static void twi_operation(uint8_t const control) {
+	if (!(control & _BV(TWEN)) || (twi_done_at != sim::never))
+		return;
+	uint32_t bits = 9;
+	if (control & _BV(TWSTO)) {
+		if (twi_addressed)
+			sim::ds1307::stop();
+		twi_owned = false;
+		twi_addressed = false;
+		hal::poke(0xbc, hal::peek(0xbc) & ~_BV(TWSTO));
+		return;
+	}
+	if (control & _BV(TWSTA)) {
+		if (twi_addressed)
+			sim::ds1307::stop();
+		twi_status = twi_owned ? 0x10 : 0x08;
+		twi_owned = true;
+		twi_addressed = false;
+		bits = 1;
+	}
+	else if (!twi_owned) {
+		return;
+	}
+	else if (!twi_addressed) {
+		uint8_t const address = hal::peek(0xbb);
+		twi_read = address & 0x01;
+		bool const ack = ((address >> 1) == 0x68) && sim::ds1307::start(twi_read);
+		twi_addressed = ack;
+		twi_status = twi_read ? (ack ? 0x40 : 0x48) : (ack ? 0x18 : 0x20);
+	}
+	else if (twi_read) {
+		twi_data = sim::ds1307::read();
+		twi_status = (control & _BV(TWEA)) ? 0x50 : 0x58;
+	}
+	else {
+		twi_status = sim::ds1307::write(hal::peek(0xbb)) ? 0x28 : 0x30;
+	}
+	twi_done_at = sim::now + (bits * twi_bit());
+}
+
+static void twi_done() {
+	twi_done_at = sim::never;
+	hal::poke(0xb9, twi_status | (hal::peek(0xb9) & 0x03));
+	if (twi_read && (twi_status == 0x50 || twi_status == 0x58))
+		hal::poke(0xbb, twi_data);
+	hal::poke(0xbc, hal::peek(0xbc) | _BV(TWINT));
+	//The control register may have changed SQW/OUT
+	update_sqw();
+}
+
+//---UART---//
+
+static uint32_t uart_frame() {
+	uint16_t const ubrr = (hal::peek(0xc5) << 8) | hal::peek(0xc4);
+	return(10 * ((hal::peek(0xc0) & _BV(U2X0)) ? 8 : 16) * (ubrr + 1));
+}
+
+static void uart_transmit(uint8_t const p0) {
+	if (uart_file)
+		fputc(p0, uart_file);
+	uart_tx_at = sim::now + uart_frame();
+}
+
+static void uart_tx_done() {
+	uart_tx_at = sim::never;
+	//Move the buffered byte into the shift register
+	if (uart_tx_buffered) {
+		uart_tx_buffered = false;
+		uart_transmit(uart_tx_buffer);
+		hal::poke(0xc0, hal::peek(0xc0) | _BV(UDRE0));
+	}
+	else {
+		hal::poke(0xc0, hal::peek(0xc0) | _BV(TXC0));
+	}
+}
+
+static void uart_rx_done() {
+	uart_rx_at = sim::never;
+	if (uart_rx.empty())
+		return;
+	if (hal::peek(0xc1) & _BV(RXEN0)) {
+		hal::poke(0xc6, uart_rx.front());
+		hal::poke(0xc0, hal::peek(0xc0) | _BV(RXC0));
+	}
+	uart_rx.pop_front();
+	if (!uart_rx.empty())
+		uart_rx_at = sim::now + uart_frame();
+}
+
+//---Interrupts---//
+
+static void call(void (*const vector)(), uint8_t const flag_address = 0, uint8_t const flag = 0) {
+	if (flag_address)
+		hal::poke(flag_address, hal::peek(flag_address) & ~flag);
+	sim::counters.interrupts++;
+	in_interrupt = true;
+	hal::poke(0x5f, hal::peek(0x5f) & ~_BV(SREG_I));
+	sim::now += interrupt_cycles;
+	vector();
+	hal::poke(0x5f, hal::peek(0x5f) | _BV(SREG_I));
+	in_interrupt = false;
+}
+
+//Runs the highest priority interrupt that's pending (in vector order). Returns false if none is.
+static bool interrupt() {
+	if (!(hal::peek(0x5f) & _BV(SREG_I)) || in_interrupt)
+		return(false);
+	//INT0 is set to trigger on a low level, so it runs for as long as the button is held
+	if ((hal::peek(0x3d) & _BV(INT0)) && !(hal::peek(0x69) & 0x03) && !(pin_value(2) & _BV(PD2))) {
+		call(INT0_vect);
+		return(true);
+	}
+	struct Vector {
+		uint8_t flag_address;
+		uint8_t flag;
+		uint8_t mask_address;
+		uint8_t mask;
+		void (*vector)();
+		bool clears;	//Whether running it clears the flag
+	};
+	static Vector const vectors[] = {
+		{ 0x3c, _BV(INTF0), 0x3d, _BV(INT0), INT0_vect, true },
+		{ 0x3b, _BV(PCIF0), 0x68, _BV(PCIE0), PCINT0_vect, true },
+		{ 0x3b, _BV(PCIF1), 0x68, _BV(PCIE1), PCINT1_vect, true },
+		{ 0x3b, _BV(PCIF2), 0x68, _BV(PCIE2), PCINT2_vect, true },
+		{ 0x37, _BV(TOV2), 0x70, _BV(TOIE2), TIMER2_OVF_vect, true },
+		{ 0x36, _BV(OCF1A), 0x6f, _BV(OCIE1A), TIMER1_COMPA_vect, true },
+		{ 0x36, _BV(TOV1), 0x6f, _BV(TOIE1), TIMER1_OVF_vect, true },
+		{ 0xc0, _BV(RXC0), 0xc1, _BV(RXCIE0), USART_RX_vect, false },
+		{ 0xc0, _BV(UDRE0), 0xc1, _BV(UDRIE0), USART_UDRE_vect, false },
+		{ 0x7a, _BV(ADIF), 0x7a, _BV(ADIE), ADC_vect, true }
+	};
+	for (Vector const &p : vectors) {
+		if ((hal::peek(p.flag_address) & p.flag) && (hal::peek(p.mask_address) & p.mask)) {
+			call(p.vector, p.clears ? p.flag_address : 0, p.flag);
+			return(true);
+		}
+	}
+	return(false);
+}
+
+//Runs everything that has fallen due, then any interrupts that are pending
+static void service() {
+	while (sim::now >= next_due) {
+		uint64_t const at = next_due;
+		if (t1_compa_at == at) {
+			hal::poke(0x36, hal::peek(0x36) | _BV(OCF1A));
+			//Only move on the one that fired, the others may be due in this same pass
+			t1_compa_at = next_count(t1_zero, t1_prescale, (hal::peek(0x89) << 8) | hal::peek(0x88), 0xffff);
+		}
+		else if (t1_compb_at == at) {
+			hal::poke(0x36, hal::peek(0x36) | _BV(OCF1B));
+			//The ADC can be started by compare B (the audio sampling)
+			if ((hal::peek(0x7a) & _BV(ADATE)) && ((hal::peek(0x7b) & 0x07) == 5))
+				adc_start();
+			t1_compb_at = next_count(t1_zero, t1_prescale, (hal::peek(0x8b) << 8) | hal::peek(0x8a), 0xffff);
+		}
+		else if (t1_ovf_at == at) {
+			hal::poke(0x36, hal::peek(0x36) | _BV(TOV1));
+			t1_ovf_at = next_count(t1_zero, t1_prescale, 0, 0xffff);
+		}
+		else if (t2_ovf_at == at) {
+			hal::poke(0x37, hal::peek(0x37) | _BV(TOV2));
+			t2_ovf_at = next_count(t2_zero, t2_prescale, 0, 0xff);
+		}
+		else if (adc_done_at == at) {
+			adc_done();
+		}
+		else if (twi_done_at == at) {
+			twi_done();
+		}
+		else if (uart_tx_at == at) {
+			uart_tx_done();
+		}
+		else if (uart_rx_at == at) {
+			uart_rx_done();
+		}
+		else if (sqw_at == at) {
+			update_sqw();
+		}
+		else {
+			std::function<void()> const fn = events.begin()->second;
+			events.erase(events.begin());
+			fn();
+			//Setting the clock moves the square wave too
+			update_sqw();
+		}
+		recalculate();
+	}
+	if (dispatching)
+		return;
+	dispatching = true;
+	while (interrupt()) {
+		recalculate();
+	}
+	dispatching = false;
+}
+
+void sim::advance(uint64_t const cycles) {
+	now += cycles;
+	if (now >= end_time)
+		siglongjmp(end_jump, 1);
+	lcd::poll();
+	service();
+}
+
+void sim::schedule(uint64_t const time, std::function<void()> const &fn) {
+	events.emplace(time, fn);
+	recalculate();
+}
+
+//---Register hooks---//
+
+//If the firmware spins without touching a register (or only through a pointer, which skips the hooks) time never moves on,
+//so a timer signal watches for a run with no hook called and moves time on to the next scripted event itself.
+static volatile sig_atomic_t hook_depth = 0;
+static volatile uint32_t progress = 0;
+
+struct Hook {
+	Hook() {
+		hook_depth++;
+	}
+	~Hook() {
+		hook_depth--;
+		progress++;
+	}
+};
+
+static void stalled(int) {
+	static uint32_t last = 0;
+	if (hook_depth || (progress != last)) {
+		last = progress;
+		return;
+	}
+	if (events.empty() || (events.begin()->first >= end_time))
+		siglongjmp(end_jump, 1);
+	sim::now = events.begin()->first;
+	service();
+}
+
+//Reads of these registers over and over (waiting on a peripheral) skip ahead to the next event
+static bool waits_on(uint8_t const address) {
+	return((address == 0xbc) || (address == 0x7a) || (address == 0xc0) || (address == 0x3f));
+}
+
+static uint8_t last_read = 0;
+
+static uint8_t read(uint8_t const address, uint8_t const value) {
+	Hook const hook;
+	sim::counters.accesses++;
+	if (waits_on(address) && (address == last_read) && (next_due != sim::never) && (next_due > sim::now))
+		sim::advance(next_due - sim::now);
+	else
+		sim::advance(sim::access_cycles);
+	last_read = address;
+	switch (address) {
+	case 0x23:		//PINB
+	case 0x26:		//PINC
+	case 0x29:		//PIND
+		return(pin_value((address - 0x23) / 3));
+	case 0x84:		//TCNT1L (the high byte is latched for the next read, like the AVRs TEMP register)
+	{
+		uint16_t const count = t1_count();
+		hal::poke(0x85, static_cast<uint8_t>(count >> 8));
+		return(static_cast<uint8_t>(count));
+	}
+	case 0xb2:		//TCNT2
+		return(t2_count());
+	case 0xc6:		//UDR0
+		hal::poke(0xc0, hal::peek(0xc0) & ~_BV(RXC0));
+		if (!uart_rx.empty() && (uart_rx_at == sim::never))
+			uart_rx_at = sim::now + uart_frame();
+		recalculate();
+		return(value);
+	default:
+		return(hal::peek(address));
+	}
+}
+
+static void write(uint8_t const address, uint8_t const value, uint8_t const old) {
+	Hook const hook;
+	sim::counters.accesses++;
+	last_read = 0;
+	switch (address) {
+	case 0x35: case 0x36: case 0x37: case 0x3b: case 0x3c:	//TIFRx, PCIFR, EIFR (writing a 1 clears a flag)
+		hal::poke(address, old & ~value);
+		break;
+	case 0x24: case 0x25: case 0x27: case 0x28: case 0x2a: case 0x2b:	//DDRx, PORTx
+		//The 1-Wire bus is driven low by making PB2 an output (low)
+		if (address <= 0x25)
+			sim::ds18b20::master((hal::peek(0x24) & _BV(PB2)) && !(hal::peek(0x25) & _BV(PB2)));
+		update_pins();
+		break;
+	case 0x81:		//TCCR1B
+	{
+		uint16_t const count = t1_count();
+		t1_prescale = t1_prescales[value & 0x07];
+		t1_set(count);
+		break;
+	}
+	case 0x84:		//TCNT1L (the high byte was written first)
+		t1_set((hal::peek(0x85) << 8) | value);
+		break;
+	case 0x88:		//OCR1AL
+	case 0x8a:		//OCR1BL
+		t1_schedule();
+		break;
+	case 0xb1:		//TCCR2B
+	{
+		uint8_t const count = t2_count();
+		t2_prescale = t2_prescales[value & 0x07];
+		t2_set(count);
+		break;
+	}
+	case 0xb2:		//TCNT2
+		t2_set(value);
+		break;
+	case 0x7a:		//ADCSRA
+		if (adc_done_at != sim::never)
+			hal::poke(0x7a, hal::peek(0x7a) | _BV(ADSC));
+		else if (value & _BV(ADSC))
+			adc_start();
+		break;
+	case 0xbc:		//TWCR (writing TWINT starts the next operation)
+		if (value & _BV(TWINT))
+			twi_operation(value);
+		break;
+	case 0xc6:		//UDR0
+		if (uart_tx_at == sim::never) {
+			uart_transmit(value);
+		}
+		else {
+			uart_tx_buffered = true;
+			uart_tx_buffer = value;
+			hal::poke(0xc0, hal::peek(0xc0) & ~_BV(UDRE0));
+		}
+		break;
+	default:
+		//Nothing else changes when something falls due
+		sim::advance(sim::access_cycles);
+		return;
+	}
+	recalculate();
+	//This runs anything that fell due (and any pending interrupts if this enabled them)
+	sim::advance(sim::access_cycles);
+}
+
+//A delay is split at everything that falls due in it, so interrupts run on time (as they would during a busy loop)
+static void delay(uint32_t const cycles) {
+	Hook const hook;
+	last_read = 0;
+	uint64_t const end = sim::now + cycles;
+	while (sim::now < end) {
+		uint64_t const step = (next_due > sim::now) ? next_due - sim::now : 1;
+		sim::advance((step < end - sim::now) ? step : end - sim::now);
+	}
+}
+
+//Sleeps until an interrupt wakes the lamp. In power down the timers stop, so only the script can wake it.
+static void sleep() {
+	Hook const hook;
+	last_read = 0;
+	if (!(hal::peek(0x53) & _BV(SE)))
+		return;
+	bool const power_down = ((hal::peek(0x53) >> 1) & 0x07) == 0x02;
+	uint64_t const interrupts = sim::counters.interrupts;
+	service();
+	while (sim::counters.interrupts == interrupts) {
+		uint64_t const next = power_down ? (events.empty() ? sim::never : events.begin()->first) : next_due;
+		if ((next == sim::never) || (next >= end_time))
+			siglongjmp(end_jump, 1);
+		if (power_down) {
+			//Nothing clocked by the CPU moves on while it's powered down
+			uint64_t const gap = next - sim::now;
+			t1_zero += gap;
+			t2_zero += gap;
+			t1_schedule();
+			if (t2_prescale)
+				t2_ovf_at = next_count(t2_zero, t2_prescale, 0, 0xff);
+		}
+		sim::now = next;
+		service();
+	}
+}
+
+//---Set up---//
+
+void sim::init() {
+	hal::reset();
+	for (uint16_t i = 0; i < hal::size; i++) {
+		hal::on_read(i, read);
+		hal::on_write(i, write);
+	}
+	hal::on_delay(delay);
+	hal::on_sleep(sleep);
+	now = 0;
+	counters = {};
+	events.clear();
+	end_time = never;
+	dispatching = false;
+	in_interrupt = false;
+	//The 1-Wire bus idles high (the sensors only pull it low), the button is released, the LCD never reads as busy
+	pin_in[0] = _BV(PB2);
+	pin_in[1] = 0x3c;
+	pin_in[2] = _BV(PD2) | _BV(PD0);
+	update_pins();
+	hal::poke(0xc0, _BV(UDRE0));
+	hal::poke(0xb9, 0xf8);
+	t1_prescale = t2_prescale = 0;
+	t1_set(0);
+	t2_set(0);
+	adc_done_at = twi_done_at = uart_rx_at = uart_tx_at = never;
+	twi_owned = twi_addressed = false;
+	uart_rx.clear();
+	uart_tx_buffered = false;
+	ds1307::reset();
+	ds18b20::reset();
+	lcd::reset();
+	update_sqw();
+	recalculate();
+}
+
+void sim::run(uint64_t const end) {
+	end_time = end;
+	hook_depth = 0;
+	signal(SIGALRM, stalled);
+	itimerval watch = { { 0, 100000 }, { 0, 100000 } };
+	setitimer(ITIMER_REAL, &watch, nullptr);
+	//The run ends by jumping back here from whatever the firmware was doing at the time
+	if (!sigsetjmp(end_jump, 1))
+		lamp_main();
+	watch = {};
+	setitimer(ITIMER_REAL, &watch, nullptr);
+	now = end;
+	//Whatever the firmware does after this (its static destructors at exit) goes straight to the registers
+	for (uint16_t i = 0; i < hal::size; i++) {
+		hal::on_read(i, nullptr);
+		hal::on_write(i, nullptr);
+	}
+	hal::on_delay(nullptr);
+	hal::on_sleep(nullptr);
+}
+
+//---Inputs---//
+
+void sim::set_light(uint8_t const p0) {
+	light_level = p0;
+}
+
+void sim::set_audio(uint8_t const p0) {
+	audio_level = p0;
+}
+
+void sim::set_button(bool const pressed, input::Button const button) {
+	switch (button) {
+	case input::Button::power:
+		drive(2, _BV(PD2), !pressed);
+		break;
+	case input::Button::input0:
+		drive(1, _BV(PC2), !pressed);
+		break;
+	case input::Button::input1:
+		drive(1, _BV(PC3), !pressed);
+		break;
+	}
+}
+
+void sim::uart_send(char const *p0, size_t const len) {
+	for (size_t i = 0; i < len; i++) {
+		uart_rx.push_back(p0[i]);
+	}
+	if (uart_rx_at == never)
+		uart_rx_at = now + uart_frame();
+	recalculate();
+}
+
+void sim::uart_output(FILE *const p0) {
+	uart_file = p0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include "../include/hal.h"
+#include "../../include/ws2812.h"
+#include "../../include/input.h"
+
+//Runs the whole firmware (main() is built as lamp_main()) against models of the lamps peripherals.
+//Time is counted in CPU cycles. It moves on when the firmware touches a register (access_cycles each),
+//delays, waits on a peripheral or sleeps. Code that touches no registers takes no time, so loop times are a floor.
+//A wait (reading a status register over and over) jumps straight to the next thing that can end it,
+//which is what makes long runs fast.
+namespace sim {
+	constexpr uint32_t f_cpu = F_CPU;
+	constexpr uint64_t never = UINT64_MAX;
+
+	//Simulated time (cycles since reset)
+	extern uint64_t now;
+	//Cycles each register access costs (standing in for the code around it)
+	extern uint8_t access_cycles;
+
+	//Work done since reset (see the per frame counters in main.cpp)
+	struct Counters {
+		uint64_t accesses;		//Register reads and writes
+		uint64_t interrupts;	//Interrupt handlers run
+		uint64_t frames;		//Neopixel frames sent
+	};
+	extern Counters counters;
+
+	constexpr uint64_t ms(uint64_t const p0) {
+		return(p0 * (f_cpu / 1000));
+	}
+
+	//Resets the registers and every model, and hooks them up
+	void init();
+	//Runs lamp_main() until the given time. Returns once it's reached.
+	void run(uint64_t const end);
+	//Moves time on, running whatever falls due (interrupts only run if they're enabled)
+	void advance(uint64_t const cycles);
+	//Runs fn at the given time (from the script)
+	void schedule(uint64_t const time, std::function<void()> const &fn);
+
+	//Inputs
+	//Sets the light level the LDR gives (0-255, ADC0)
+	void set_light(uint8_t const p0);
+	//Sets the level on the audio input (0-255, mid scale is silence)
+	void set_audio(uint8_t const p0);
+	//Holds a button down (its pin pulled low, see input.h) or lets it go
+	void set_button(bool const pressed, input::Button const button = input::Button::power);
+	//Queues bytes to arrive on the UART
+	void uart_send(char const *p0, size_t const len);
+	//Where the UART output goes (nullptr to drop it)
+	void uart_output(FILE *const p0);
+
+	//The DS1307 real time clock (on the TWI at 0x68)
+	namespace ds1307 {
+		void reset();
+		//Sets the clock (seconds since 1970, UTC)
+		void set(int64_t const seconds);
+		//Returns the clock (seconds since 1970, UTC)
+		int64_t get();
+		//Makes the clock run p0 times faster than real time (so a long run covers more of the day)
+		void set_speed(uint16_t const p0);
+		//TWI bus side, used by the TWI model. These return true for an ACK.
+		bool start(bool const read);
+		bool write(uint8_t const p0);
+		uint8_t read();
+		void stop();
+		//The SQW/OUT pin (open drain, so true is let go). Only the 1Hz square wave is modelled, the faster ones stay high.
+		bool sqw();
+		//Returns when SQW/OUT next changes (never if it isn't oscillating)
+		uint64_t sqw_next();
+	}
+
+	//DS18B20 temperature sensors on the 1-Wire bus (PB2), see ds18b20.cpp
+	namespace ds18b20 {
+		constexpr uint8_t sensor_max = 4;
+		void reset();
+		//Sets how many sensors are on the bus (0 for none, default 1)
+		void set_amount(uint8_t const p0);
+		//Sets the temperature (1/16 C) a sensor measures (they start at 21C)
+		void set(int16_t const temperature, uint8_t const sensor);
+		//Follows the master (the firmware) pulling the bus low or letting it go
+		void master(bool const low);
+		//Returns whether a sensor is holding the bus low now
+		bool pulling();
+	}
+
+	//The HD44780 LCD (4 bit, wired as lcd.h says)
+	namespace lcd {
+		constexpr uint8_t columns = 16;
+		constexpr uint8_t lines = 2;
+		void reset();
+		//Follows the enable, RS, R/W and data pins (called on every register access, as the driver writes the ports directly)
+		void poll();
+		//Returns what's showing on a line (columns characters, custom characters as '#', blank if the display is off)
+		void line(uint8_t const p0, char out[columns + 1]);
+		//Counts every time the DDRAM or display state changes
+		uint32_t changes();
+		//Draws the display (redrawing in place on a terminal)
+		void draw(FILE *const p0, bool const in_place);
+	}
+}
+
+//The firmware
+extern "C" {
+	void INT0_vect(void);
+	void PCINT0_vect(void);
+	void PCINT1_vect(void);
+	void PCINT2_vect(void);
+	void TIMER2_OVF_vect(void);
+	void TIMER1_COMPA_vect(void);
+	void TIMER1_OVF_vect(void);
+	void USART_RX_vect(void);
+	void USART_UDRE_vect(void);
+	void ADC_vect(void);
+}
+int lamp_main();
@@ -0,0 +1,1432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include "../include/hal.h"
+#include "../sim/sim.h"
+#include "../../include/audio.h"
+#include "../../include/calibrate.h"
+#include "../../include/checkpoint.h"
+#include "../../include/colour.h"
+#include "../../include/cycles.h"
+#include "../../include/display.h"
+#include "../../include/dsp.h"
+#include "../../include/history.h"
+#include "../../include/ic_ds1307.h"
+#include "../../include/input.h"
+#include "../../include/onewire.h"
+#include "../../include/pins.h"
+#include "../../include/settings.h"
+#include "../../include/space.h"
+#include "../../include/telemetry.h"
+#include "../../include/temperature.h"
+#include "../../include/timer.h"
+
+//Unit tests of the firmwares logic, run on the host (make test). Each group sets up what it needs itself, a failed
+//check prints where it is and what it compared, and the run exits with 1 if any check failed.
+//	test [group ...]		(default all, see groups below)
+
+//---Checks---//
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+static bool check(bool const passed, char const *const text, char const *const file, int const line) {
+	checks++;
+	if (!passed) {
+		failures++;
+		printf("%s:%d: failed: %s\n", file, line, text);
+	}
+	return(passed);
+}
+
+static bool check_equal(long long const actual, long long const expected, char const *const text, char const *const file, int const line) {
+	checks++;
+	if (actual != expected) {
+		failures++;
+		printf("%s:%d: failed: %s is %lld, expected %lld\n", file, line, text, actual, expected);
+	}
+	return(actual == expected);
+}
+
+static bool check_string(char const *const actual, char const *const expected, char const *const text, char const *const file, int const line) {
+	checks++;
+	if (strcmp(actual, expected)) {
+		failures++;
+		printf("%s:%d: failed: %s is \"%s\", expected \"%s\"\n", file, line, text, actual, expected);
+	}
+	return(!strcmp(actual, expected));
+}
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) check_equal((actual), (expected), #actual, __FILE__, __LINE__)
+#define CHECK_STRING(actual, expected) check_string((actual), (expected), #actual, __FILE__, __LINE__)
+
+//---Colour---//
+
+static void test_colour() {
+	//The primaries and secondaries land exactly
+	RGBColor colour = hsv2rgb(0, 255, 255);
+	CHECK_EQUAL(colour.r, 255);
+	CHECK_EQUAL(colour.g, 0);
+	CHECK_EQUAL(colour.b, 0);
+	colour = hsv2rgb(120, 255, 255);
+	CHECK_EQUAL(colour.r, 0);
+	CHECK_EQUAL(colour.g, 255);
+	CHECK_EQUAL(colour.b, 0);
+	colour = hsv2rgb(240, 255, 255);
+	CHECK_EQUAL(colour.r, 0);
+	CHECK_EQUAL(colour.g, 0);
+	CHECK_EQUAL(colour.b, 255);
+	colour = hsv2rgb(60, 255, 255);
+	CHECK_EQUAL(colour.r, 255);
+	CHECK_EQUAL(colour.g, 255);
+	CHECK_EQUAL(colour.b, 0);
+	//No saturation is grey, at the value
+	colour = hsv2rgb(200, 0, 100);
+	CHECK_EQUAL(colour.r, 100);
+	CHECK_EQUAL(colour.g, 100);
+	CHECK_EQUAL(colour.b, 100);
+	//No value is off, whatever the hue
+	colour = hsv2rgb(300, 255, 0);
+	CHECK_EQUAL(colour.r + colour.g + colour.b, 0);
+
+	//Every hue is within a count of the floating point conversion it replaced
+	uint16_t worst_hue = 0;
+	int worst = 0;
+	for (uint16_t hue = 0; hue < 360; hue++) {
+		for (uint16_t value = 0; value <= 255; value += 51) {
+			RGBColor const fixed = hsv2rgb(hue, 255, value);
+			float const h = hue / 60.0f;
+			float const f = h - floor(h);
+			float const v = value / 255.0f;
+			float r = 0, g = 0, b = 0;
+			switch (static_cast<int>(h) % 6) {
+			case 0: r = v; g = v * f; b = 0; break;
+			case 1: r = v * (1 - f); g = v; b = 0; break;
+			case 2: r = 0; g = v; b = v * f; break;
+			case 3: r = 0; g = v * (1 - f); b = v; break;
+			case 4: r = v * f; g = 0; b = v; break;
+			case 5: r = v; g = 0; b = v * (1 - f); break;
+			}
+			int const error = std::max(std::max(abs(fixed.r - static_cast<int>(r * 255)), abs(fixed.g - static_cast<int>(g * 255))),
+				abs(fixed.b - static_cast<int>(b * 255)));
+			if (error > worst) {
+				worst = error;
+				worst_hue = hue;
+			}
+		}
+	}
+	if (!CHECK(worst <= 1))
+		printf("\t%d counts out at hue %u\n", worst, worst_hue);
+}
+
+//---Timer---//
+
+extern "C" void TIMER2_OVF_vect(void);
+
+static uint32_t hook_calls = 0;
+
+static void count_hook() {
+	hook_calls++;
+}
+
+static void test_timer() {
+	constexpr timer::Tick tick_length = timer::determine_tick(0.001, 20000000);
+	//1ms at 20MHz: 20 counts of the 1024 prescale, with no whole overflows
+	CHECK_EQUAL(tick_length.param.prescale, 0b111);
+	CHECK_EQUAL(tick_length.param.home, 19);
+	CHECK_EQUAL(tick_length.param.loop, 0);
+	CHECK_EQUAL(tick_length.nominal, 20000);
+	timer::init(tick_length);
+	CHECK_EQUAL(timer::period(), 20 * 1024);
+	CHECK_EQUAL(TCCR2B & 0x07, 0b111);
+	CHECK(TIMSK2 & _BV(TOIE2));
+
+	//Timers count down only while running, and finish at 0
+	Timer a;
+	Timer b;
+	Timer c;
+	a = 3;
+	a.start();
+	b = 5;
+	c = 2;
+	c.start();
+	timer::tick();
+	timer::tick();
+	CHECK(!a);
+	CHECK_EQUAL(static_cast<uint64_t>(a), 1);
+	CHECK(c);
+	CHECK(!c.running);
+	CHECK_EQUAL(static_cast<uint64_t>(b), 5);
+	b.start();
+	timer::tick();
+	CHECK(a);
+	CHECK_EQUAL(static_cast<uint64_t>(b), 4);
+	b.stop();
+	timer::tick();
+	CHECK_EQUAL(static_cast<uint64_t>(b), 4);
+
+	//Taking one out of the middle leaves the others ticking
+	{
+		Timer d;
+		Timer *const removed = new Timer;
+		Timer e;
+		d = 10;
+		d.start();
+		e = 10;
+		e.start();
+		delete removed;
+		b.start();
+		timer::tick();
+		CHECK_EQUAL(static_cast<uint64_t>(b), 3);
+		CHECK_EQUAL(static_cast<uint64_t>(d), 9);
+		CHECK_EQUAL(static_cast<uint64_t>(e), 9);
+	}
+	b.reset();
+	CHECK(!b.running && !b && (static_cast<uint64_t>(b) == 0));
+
+	//The hook is called every tick until it's cleared
+	timer::on_tick(count_hook);
+	timer::tick();
+	timer::tick();
+	timer::on_tick(nullptr);
+	timer::tick();
+	CHECK_EQUAL(hook_calls, 2);
+
+	//With no whole overflows every interrupt is a tick. The trim adds (or drops) one every 1000000000 / ppb of them.
+	uint32_t const start = timer::count();
+	for (uint8_t i = 0; i < 100; i++) {
+		TIMER2_OVF_vect();
+	}
+	CHECK_EQUAL(timer::count() - start, 100);
+	timer::trim(timer::trim_max * 2);
+	CHECK_EQUAL(timer::trim(), timer::trim_max);
+	for (uint8_t i = 0; i < 100; i++) {
+		TIMER2_OVF_vect();
+	}
+	CHECK_EQUAL(timer::count() - start, 210);
+	timer::trim(-timer::trim_max);
+	for (uint8_t i = 0; i < 100; i++) {
+		TIMER2_OVF_vect();
+	}
+	CHECK_EQUAL(timer::count() - start, 300);
+	timer::trim(0);
+}
+
+//---RegData---//
+
+//Sets the time from its digits. hour_12 keeps hour as 1-12 with pm in ampm_hour1.
+static IC_DS1307::RegData make_time(uint8_t const hour, uint8_t const minute, uint8_t const second, bool const hour_12, bool const pm = false) {
+	IC_DS1307::RegData time = {};
+	time.second1 = second / 10;
+	time.second0 = second % 10;
+	time.minute1 = minute / 10;
+	time.minute0 = minute % 10;
+	time.hour_12 = hour_12;
+	time.hour0 = hour % 10;
+	if (hour_12) {
+		time.hour1 = hour / 10;
+		time.ampm_hour1 = pm;
+	}
+	else {
+		time.hour1 = (hour / 10) & 0x01;
+		time.ampm_hour1 = (hour / 10) >> 1;
+	}
+	time.day = 1;
+	time.date0 = 2;
+	time.month0 = 1;
+	time.year1 = 2;
+	time.year0 = 4;
+	return(time);
+}
+
+static void test_regdata() {
+	//24 hour mode keeps the hours 20s in the AM/PM bit
+	CHECK_EQUAL(make_time(0, 0, 0, false).hour(), 0);
+	CHECK_EQUAL(make_time(9, 0, 0, false).hour(), 9);
+	CHECK_EQUAL(make_time(19, 0, 0, false).hour(), 19);
+	CHECK_EQUAL(make_time(23, 0, 0, false).hour(), 23);
+	//12 hour mode: 12AM is midnight and 12PM is noon
+	CHECK_EQUAL(make_time(12, 0, 0, true, false).hour(), 0);
+	CHECK_EQUAL(make_time(1, 0, 0, true, false).hour(), 1);
+	CHECK_EQUAL(make_time(11, 0, 0, true, false).hour(), 11);
+	CHECK_EQUAL(make_time(12, 0, 0, true, true).hour(), 12);
+	CHECK_EQUAL(make_time(11, 0, 0, true, true).hour(), 23);
+
+	IC_DS1307::RegData a = make_time(10, 20, 30, false);
+	IC_DS1307::RegData b = a;
+	CHECK(a == b);
+	b.second0 = 1;
+	CHECK(!(a == b));
+	b = a;
+	b.sqwe = 1;
+	CHECK(!(a == b));
+	b = a;
+	b.year1 = 3;
+	CHECK(!(a == b));
+}
+
+//---Display---//
+
+static void test_display() {
+	char text[display::text_size];
+	IC_DS1307::RegData time = make_time(12, 34, 56, true, true);
+	display::format(text, time, true, 21 * 16 + 8);
+	CHECK_STRING(text, "12:34:56PM 21.5C\nSun 02/01/2024");
+	display::format(text, time, false, 0);
+	CHECK_STRING(text, "12:34:56PM\nSun 02/01/2024");
+	//A 6 character temperature isn't spaced, so the line is still 16 columns
+	display::format(text, time, true, -(10 * 16 + 8));
+	CHECK_STRING(text, "12:34:56PM-10.5C\nSun 02/01/2024");
+	display::format(text, time, true, 125 * 16);
+	CHECK_STRING(text, "12:34:56PM125.0C\nSun 02/01/2024");
+	display::format(text, time, true, -(5 * 16 + 8));
+	CHECK_STRING(text, "12:34:56PM -5.5C\nSun 02/01/2024");
+	//24 hour leaves AM/PM blank
+	time = make_time(0, 5, 9, false);
+	time.day = 7;
+	time.date1 = 3;
+	time.date0 = 1;
+	time.month1 = 1;
+	time.month0 = 2;
+	display::format(text, time, false, 0, true);
+	CHECK_STRING(text, "00:05:09  \nSat 31/12/2024");
+	display::format(text, time, false, 0, false);
+	CHECK_STRING(text, "12:05:09AM\nSat 31/12/2024");
+	//A day the DS1307 can't have
+	time.day = 0;
+	display::format(text, time, false, 0);
+	CHECK_STRING(text, "12:05:09AM\n--- 31/12/2024");
+
+	display::Screen screen;
+	memset(screen, 0, sizeof(screen));
+	display::format_big(screen, make_time(9, 41, 7, true, true));
+	//No leading 0, and 9 is glyph 0, 6, 2 over 5 (bottom right corner) at the bottom right
+	CHECK_EQUAL(screen[0][0], ' ');
+	CHECK_EQUAL(screen[0][3], display::big_glyph_code + 0);
+	CHECK_EQUAL(screen[1][5], 0xff);
+	CHECK_EQUAL(screen[0][6], 0xa5);
+	CHECK_EQUAL(screen[0][14], '0');
+	CHECK_EQUAL(screen[0][15], '7');
+	CHECK_EQUAL(screen[1][14], 'P');
+	CHECK_EQUAL(screen[1][15], 'M');
+	//Every cell of every part is written
+	for (uint8_t i = 0; i < display::big_part_amount; i++) {
+		for (uint8_t column = display::big_parts[i].column; column < display::big_parts[i].column + display::big_parts[i].width; column++) {
+			if (!CHECK(screen[0][column] && screen[1][column]))
+				printf("\tcolumn %u\n", column);
+		}
+	}
+}
+
+//---DSP---//
+
+//audio.cpps bands
+static constexpr uint16_t band_freq[audio::band_amount] = { 125, 250, 500, 1000 };
+static constexpr int16_t band_coeff[audio::band_amount] = {
+	dsp::goertzel_coeff(band_freq[0], audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(band_freq[1], audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(band_freq[2], audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(band_freq[3], audio::sample_rate, audio::block_size)
+};
+
+//Sample t of up to two tones (cosines) around offset, as the ADC would give it (less 0x80)
+static int8_t synthesise(uint16_t const t, int8_t const offset, uint8_t const amplitude0, uint16_t const freq0,
+	uint8_t const amplitude1 = 0, uint16_t const freq1 = 0) {
+	double const x = offset + (amplitude0 * cos(2 * M_PI * freq0 * t / audio::sample_rate)) +
+		(amplitude1 * cos(2 * M_PI * freq1 * t / audio::sample_rate));
+	return(static_cast<int8_t>(std::max(-128.0, std::min(127.0, round(x)))));
+}
+
+//The level of each band for a block
+static void band_levels(int8_t const samples[], uint8_t levels[]) {
+	int8_t const offset = dsp::mean(samples, audio::block_size);
+	for (uint8_t i = 0; i < audio::band_amount; i++) {
+		levels[i] = dsp::level(dsp::goertzel(samples, audio::block_size, offset, band_coeff[i]));
+	}
+}
+
+static void test_dsp() {
+	int8_t samples[audio::block_size];
+	uint8_t levels[audio::band_amount];
+
+	//8 steps a doubling, and never lower for more power
+	CHECK_EQUAL(dsp::level(0), 0);
+	for (uint8_t i = 0; i < 32; i++) {
+		if (!CHECK_EQUAL(dsp::level(static_cast<uint32_t>(1) << i), i * 8))
+			break;
+	}
+	uint8_t last = 0;
+	for (uint32_t power = 1; power < 0x7fffffff; power += (power >> 4) + 1) {
+		uint8_t const level = dsp::level(power);
+		if (!CHECK(level >= last)) {
+			printf("\tat %u\n", power);
+			break;
+		}
+		last = level;
+	}
+
+	//A tone on each band is the loudest band, and only it is above silence
+	for (uint8_t band = 0; band < audio::band_amount; band++) {
+		for (uint8_t t = 0; t < audio::block_size; t++) {
+			samples[t] = synthesise(t, 10, 100, band_freq[band]);
+		}
+		CHECK_EQUAL(dsp::mean(samples, audio::block_size), 10);
+		band_levels(samples, levels);
+		for (uint8_t i = 0; i < audio::band_amount; i++) {
+			bool const passed = (i == band) ? CHECK(levels[i] > audio::silence) : CHECK(levels[i] <= audio::silence);
+			if (!passed)
+				printf("\ttone on band %u, band %u is at %u\n", band, i, levels[i]);
+		}
+	}
+
+	//Two tones come out on their own bands
+	for (uint8_t t = 0; t < audio::block_size; t++) {
+		samples[t] = synthesise(t, -20, 50, band_freq[1], 50, band_freq[3]);
+	}
+	band_levels(samples, levels);
+	CHECK(levels[1] > audio::silence);
+	CHECK(levels[3] > audio::silence);
+	CHECK(levels[0] <= audio::silence);
+	CHECK(levels[2] <= audio::silence);
+
+	//A constant input (at any offset) has no power in any band
+	for (int8_t const offset : { 0, 40, -128, 127 }) {
+		memset(samples, offset, sizeof(samples));
+		band_levels(samples, levels);
+		for (uint8_t i = 0; i < audio::band_amount; i++) {
+			CHECK_EQUAL(levels[i], 0);
+		}
+	}
+
+	//A louder tone is never a lower level, and doubling it is about 16 steps (4 times the power)
+	uint8_t previous = 0;
+	uint8_t at_half = 0;
+	for (uint8_t amplitude = 2; amplitude <= 120; amplitude++) {
+		for (uint8_t t = 0; t < audio::block_size; t++) {
+			samples[t] = synthesise(t, 0, amplitude, band_freq[2]);
+		}
+		band_levels(samples, levels);
+		if (!CHECK(levels[2] >= previous))
+			printf("\tamplitude %u\n", amplitude);
+		previous = levels[2];
+		if (amplitude == 30)
+			at_half = levels[2];
+		if (amplitude == 60)
+			CHECK((levels[2] - at_half >= 14) && (levels[2] - at_half <= 18));
+	}
+}
+
+//---Audio---//
+
+extern "C" void ADC_vect(void);
+
+//Takes a sample (as the ADC reads it) from the ADC interrupt
+static void convert(uint8_t const value) {
+	ADCH = value;
+	ADC_vect();
+}
+
+//Returns what update() makes a band of a block, from nothing
+static uint8_t band_value(uint8_t const level) {
+	if (level <= audio::silence)
+		return(0);
+	return(((level - audio::silence) >= 64) ? 255 : (level - audio::silence) << 2);
+}
+
+static void test_audio() {
+	audio::start();
+	CHECK(!audio::update());
+	//A low tone on a DC offset. Two blocks are taken before update() is called, so the first is dropped.
+	//The first sample of the second is the light reading, which should be left out of the block, holding the sample before it.
+	auto const input = [](uint16_t const t) {
+		return(synthesise(t, 60, 60, band_freq[0]));
+	};
+	int8_t expected[audio::block_size];
+	for (uint16_t t = 0; t < 2 * audio::block_size; t++) {
+		uint8_t const light = 0x33;
+		convert((t == audio::block_size) ? light : static_cast<uint8_t>(input(t) + 0x80));
+		if (t >= audio::block_size)
+			expected[t - audio::block_size] = (t == audio::block_size) ? input(t - 1) : input(t);
+	}
+	CHECK_EQUAL(audio::overruns(), 1);
+	CHECK_EQUAL(audio::light(), 0x33);
+	CHECK(audio::update());
+	CHECK(!audio::update());
+	uint8_t levels[audio::band_amount];
+	band_levels(expected, levels);
+	for (uint8_t i = 0; i < audio::band_amount; i++) {
+		if (!CHECK_EQUAL(audio::band(i), band_value(levels[i])))
+			printf("\tband %u\n", i);
+	}
+	CHECK(audio::band(0) > 0);
+	CHECK(audio::band(0) > audio::band(3));
+
+	//Silence lets the bands fall, a little each block, to nothing
+	uint8_t previous = audio::band(0);
+	for (uint8_t block = 0; block < 40; block++) {
+		for (uint8_t t = 0; t < audio::block_size; t++) {
+			convert(0x80);
+		}
+		CHECK(audio::update());
+		if (!CHECK(audio::band(0) <= previous))
+			break;
+		previous = audio::band(0);
+	}
+	for (uint8_t i = 0; i < audio::band_amount; i++) {
+		CHECK_EQUAL(audio::band(i), 0);
+	}
+	audio::stop();
+}
+
+//---Space---//
+
+static void test_space() {
+	//Each neopixel against what its table entry should hold
+	for (uint8_t i = 0; i < space::led_count; i++) {
+		space::Vector const p = space::position(i);
+		CHECK_EQUAL(pgm_read_word(&space::table[i].distance2), (p.x * p.x) + (p.y * p.y) + (p.z * p.z));
+	}
+	//A plane through a neopixel is brightest there, and fades with distance along the normal
+	space::Vector const up = { 0, 0, space::unit };
+	for (uint8_t i = 0; i < space::led_count; i++) {
+		space::Vector const p = space::position(i);
+		CHECK_EQUAL(space::plane(i, { up, p.z, 2 }), 255);
+		CHECK_EQUAL(space::plane(i, { up, static_cast<int8_t>(p.z + 10), 2 }), 255 - 40);
+		CHECK_EQUAL(space::plane(i, { up, static_cast<int8_t>(p.z - 10), 2 }), 255 - 40);
+		CHECK_EQUAL(space::plane(i, { up, static_cast<int8_t>((p.z > 0) ? p.z - 100 : p.z + 100), 2 }), 0);
+	}
+	//A shell through a neopixel is brightest there, from the centre or anywhere else
+	for (uint8_t i = 0; i < space::led_count; i++) {
+		space::Vector const p = space::position(i);
+		uint8_t const radius = static_cast<uint8_t>(lround(sqrt((p.x * p.x) + (p.y * p.y) + (p.z * p.z))));
+		CHECK(space::shell(i, space::sphere({ 0, 0, 0 }, radius, 5)) >= 250);
+		CHECK_EQUAL(space::shell(i, space::sphere({ 0, 0, 0 }, radius + 60, 5)), 0);
+		space::Vector const centre = { static_cast<int8_t>(p.x - 20), p.y, p.z };
+		CHECK_EQUAL(space::shell(i, space::sphere(centre, 20, 5)), 255);
+	}
+	//The sweep and pulse over a turn of the hues (step * 2 * unit and step * 220 are past 16 bits, as int is on the lamp)
+	CHECK_EQUAL(space::sweep(0, 359), -space::unit);
+	CHECK_EQUAL(space::sweep(180, 359), 0);
+	CHECK_EQUAL(space::sweep(359, 359), space::unit);
+	CHECK_EQUAL(space::pulse(0, 359, 220), 0);
+	CHECK_EQUAL(space::pulse(180, 359, 220), 110);
+	CHECK_EQUAL(space::pulse(298, 359, 220), 182);
+	CHECK_EQUAL(space::pulse(359, 359, 220), 220);
+	int8_t offset = space::sweep(0, 359);
+	uint8_t radius = space::pulse(0, 359, 220);
+	for (uint16_t step = 1; step < 360; step++) {
+		CHECK(space::sweep(step, 359) >= offset);
+		CHECK(space::pulse(step, 359, 220) >= radius);
+		offset = space::sweep(step, 359);
+		radius = space::pulse(step, 359, 220);
+	}
+}
+
+//---Clock and buses---//
+
+//The groups below run the firmware against a clock, and just enough of the lamps buses, kept here (sim/sim.cpp has the whole lamp).
+//Time is sim::now in CPU cycles, which the DS18B20 model (sim/ds18b20.cpp, linked in) follows as well. It only moves on in
+//run_until() and delays, so everything between is instant.
+uint64_t sim::now = 0;
+
+//The DS1307 on the TWI: its registers and RAM, whether it answers, and how many bytes were written to it
+static uint8_t rtc_ram[64];
+static uint8_t rtc_pointer = 0;
+static bool rtc_pointer_next = false;
+static bool rtc_present = true;
+static uint32_t rtc_writes = 0;
+//The TWI operation running (reads of TWCR until it's done, 0 if none), and what it ends with
+static uint8_t twi_pending = 0;
+static uint8_t twi_status = 0xf8;
+static uint8_t twi_data = 0;
+static bool twi_owned = false;
+static bool twi_addressed = false;
+static bool twi_read = false;
+
+//What the UART sent, and how far frame_next() has got through it
+static uint8_t uart_sent[1024];
+static uint16_t uart_sent_length = 0;
+static uint16_t uart_taken = 0;
+
+//Timer1 counts CPU cycles (free running at prescale 1)
+static uint8_t read_tcnt1(uint8_t const address, uint8_t const value) {
+	(void)value;
+	return(static_cast<uint8_t>(sim::now >> ((address - 0x84) * 8)));
+}
+
+//The 1-Wire bus (PB2) is low while the firmware drives it (an output, low) or a sensor pulls it
+static bool bus_driven() {
+	return((hal::peek(0x24) & _BV(PB2)) && !(hal::peek(0x25) & _BV(PB2)));
+}
+
+static uint8_t read_pinb(uint8_t const address, uint8_t const value) {
+	(void)address;
+	return((bus_driven() || sim::ds18b20::pulling()) ? (value & ~_BV(PB2)) : (value | _BV(PB2)));
+}
+
+static void write_portb(uint8_t const address, uint8_t const value, uint8_t const old) {
+	(void)address;
+	(void)value;
+	(void)old;
+	sim::ds18b20::master(bus_driven());
+}
+
+//Starts what a write to TWCR (with TWINT set) asks for, as sim/sim.cpp does. It finishes on the second read of TWCR after, so a
+//read-modify-write of TWCR straight after starting one (as recv_packet() does) doesn't start another, as the AVR would still be busy.
+static void write_twcr(uint8_t const address, uint8_t const value, uint8_t const old) {
+	(void)address;
+	(void)old;
+	if (!(value & _BV(TWINT)) || !(value & _BV(TWEN)) || twi_pending)
+		return;
+	if (value & _BV(TWSTO)) {
+		twi_owned = false;
+		twi_addressed = false;
+		hal::poke(0xbc, hal::peek(0xbc) & ~_BV(TWSTO));
+		return;
+	}
+	if (value & _BV(TWSTA)) {
+		twi_status = twi_owned ? 0x10 : 0x08;
+		twi_owned = true;
+		twi_addressed = false;
+	}
+	else if (!twi_owned) {
+		return;
+	}
+	else if (!twi_addressed) {
+		uint8_t const slave = hal::peek(0xbb);
+		twi_read = slave & 0x01;
+		twi_addressed = rtc_present && ((slave >> 1) == IC_DS1307::twi_address_d);
+		rtc_pointer_next = !twi_read;
+		twi_status = twi_read ? (twi_addressed ? 0x40 : 0x48) : (twi_addressed ? 0x18 : 0x20);
+	}
+	else if (twi_read) {
+		twi_data = rtc_ram[rtc_pointer];
+		rtc_pointer = (rtc_pointer + 1) & 0x3f;
+		twi_status = (value & _BV(TWEA)) ? 0x50 : 0x58;
+	}
+	else {
+		if (rtc_pointer_next) {
+			rtc_pointer = hal::peek(0xbb) & 0x3f;
+			rtc_pointer_next = false;
+		}
+		else {
+			rtc_ram[rtc_pointer] = hal::peek(0xbb);
+			rtc_pointer = (rtc_pointer + 1) & 0x3f;
+			rtc_writes++;
+		}
+		twi_status = 0x28;
+	}
+	twi_pending = 2;
+}
+
+static uint8_t read_twcr(uint8_t const address, uint8_t const value) {
+	(void)address;
+	if (!twi_pending)
+		return(value);
+	twi_pending--;
+	if (twi_pending)
+		return(value);
+	hal::poke(0xb9, twi_status | (hal::peek(0xb9) & 0x03));
+	if (twi_read && ((twi_status == 0x50) || (twi_status == 0x58)))
+		hal::poke(0xbb, twi_data);
+	hal::poke(0xbc, value | _BV(TWINT));
+	return(hal::peek(0xbc));
+}
+
+static void write_udr0(uint8_t const address, uint8_t const value, uint8_t const old) {
+	(void)address;
+	(void)old;
+	if (uart_sent_length < sizeof(uart_sent)) {
+		uart_sent[uart_sent_length] = value;
+		uart_sent_length++;
+	}
+}
+
+//Delays (as the blocking DS18B20 functions use) move time on, without running any interrupts
+static void delay(uint32_t const cycles) {
+	sim::now += cycles;
+}
+
+//Starts the clock from 0 with a 1ms tick, hooks the buses up, and empties them
+static void harness_init() {
+	sim::now = 0;
+	hal::on_read(0x84, read_tcnt1);
+	hal::on_read(0x85, read_tcnt1);
+	hal::on_read(0x23, read_pinb);
+	hal::on_write(0x24, write_portb);
+	hal::on_write(0x25, write_portb);
+	hal::on_read(0xbc, read_twcr);
+	hal::on_write(0xbc, write_twcr);
+	hal::on_write(0xc6, write_udr0);
+	hal::on_delay(delay);
+	sim::ds18b20::reset();
+	memset(rtc_ram, 0, sizeof(rtc_ram));
+	rtc_present = true;
+	rtc_writes = 0;
+	twi_pending = 0;
+	twi_owned = false;
+	uart_sent_length = 0;
+	uart_taken = 0;
+	timer::init(timer::determine_tick(0.001, F_CPU));
+}
+
+//Moves time on to end, running the Timer1 compare A and overflow, and Timer2 overflow (the tick), interrupts as they fall due
+static void run_until(uint64_t const end) {
+	static void (*const vectors[3])(void) = { TIMER1_COMPA_vect, TIMER1_OVF_vect, TIMER2_OVF_vect };
+	while (true) {
+		//When each is next due (never while it's off)
+		uint64_t const due[3] = {
+			(TIMSK1 & _BV(OCIE1A)) ? sim::now + static_cast<uint16_t>(OCR1A - static_cast<uint16_t>(sim::now)) : sim::never,
+			(TIMSK1 & _BV(TOIE1)) ? ((sim::now >> 16) + 1) << 16 : sim::never,
+			(TIMSK2 & _BV(TOIE2)) ? ((sim::now / timer::period()) + 1) * timer::period() : sim::never
+		};
+		uint64_t const at = std::min(std::min(due[0], due[1]), due[2]);
+		if (at > end) {
+			sim::now = std::max(sim::now, end);
+			return;
+		}
+		sim::now = at;
+		//Several can fall due at once
+		for (uint8_t i = 0; i < 3; i++) {
+			if (due[i] == at)
+				vectors[i]();
+		}
+	}
+}
+
+static void run_ticks(uint32_t const ticks) {
+	run_until(((sim::now / timer::period()) + ticks) * timer::period());
+}
+
+//Sends everything in the UARTs transmit buffer
+static void uart_drain() {
+	while (UCSR0B & _BV(UDRIE0)) {
+		USART_UDRE_vect();
+	}
+}
+
+static uint16_t crc_xmodem(uint8_t const p0[], uint8_t const len) {
+	uint16_t crc = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		crc ^= static_cast<uint16_t>(p0[i]) << 8;
+		for (uint8_t j = 0; j < 8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return(crc);
+}
+
+static uint8_t crc_dallas(uint8_t const p0[], uint8_t const len) {
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		crc ^= p0[i];
+		for (uint8_t j = 0; j < 8; j++) {
+			crc = (crc & 0x01) ? (crc >> 1) ^ 0x8c : crc >> 1;
+		}
+	}
+	return(crc);
+}
+
+//Takes the next frame the UART sent (see telemetry.h) into out, decoded and without its CRC. Returns its length (type, sequence
+//and payload), or -1 if there isn't a whole frame left or it fails the CRC.
+static int16_t frame_next(uint8_t out[]) {
+	uint8_t raw[256];
+	uint16_t raw_length = 0;
+	uint16_t i = uart_taken;
+	//Each run of non zero bytes follows its length + 1, and stands for the run and a 0 (except the last)
+	while ((i < uart_sent_length) && uart_sent[i]) {
+		uint8_t const code = uart_sent[i];
+		i++;
+		for (uint8_t j = 1; (j < code) && (i < uart_sent_length); j++) {
+			raw[raw_length] = uart_sent[i];
+			raw_length++;
+			i++;
+		}
+		if ((i < uart_sent_length) && uart_sent[i]) {
+			raw[raw_length] = 0;
+			raw_length++;
+		}
+	}
+	if (i >= uart_sent_length)
+		return(-1);
+	uart_taken = i + 1;
+	if ((raw_length < 4) || (crc_xmodem(raw, raw_length - 2) != (raw[raw_length - 2] | (raw[raw_length - 1] << 8))))
+		return(-1);
+	memcpy(out, raw, raw_length - 2);
+	return(raw_length - 2);
+}
+
+//---Input---//
+
+//Sets the level on a buttons pin, running its pin change interrupt if the pin is watched, as the AVR would
+template <typename P>
+static void set_pin(bool const high, void (*const vector)(void), hal::Reg8 const &mask, uint8_t const enable) {
+	uint8_t const address = P::input_io + 0x20;
+	bool const changed = ((hal::peek(address) & P::mask) != 0) != high;
+	hal::poke(address, high ? (hal::peek(address) | P::mask) : (hal::peek(address) & ~P::mask));
+	if (changed && (PCICR & enable) && (mask & P::mask))
+		vector();
+}
+
+//The buttons are pulled up, so pressed is low
+static void set_button(input::Button const button, bool const pressed) {
+	switch (button) {
+	case input::Button::power:
+		set_pin<pins::power>(!pressed, PCINT2_vect, PCMSK2, _BV(PCIE2));
+		break;
+	case input::Button::input0:
+		set_pin<pins::input0>(!pressed, PCINT1_vect, PCMSK1, _BV(PCIE1));
+		break;
+	default:
+		set_pin<pins::input1>(!pressed, PCINT1_vect, PCMSK1, _BV(PCIE1));
+		break;
+	}
+}
+
+static bool is_event(input::Event const event, input::Kind const kind, input::Button const button) {
+	return((event.kind == kind) && (event.button == button));
+}
+
+static void test_input() {
+	harness_init();
+	set_button(input::Button::power, false);
+	set_button(input::Button::input0, false);
+	set_button(input::Button::input1, false);
+	input::init();
+	CHECK(input::next().kind == input::Kind::none);
+	CHECK(PCICR & _BV(PCIE1));
+	CHECK(PCICR & _BV(PCIE2));
+
+	//A bounce that settles back where it was is no event, and the pin is watched again after it
+	set_button(input::Button::power, true);
+	CHECK(!(PCMSK2 & pins::power::mask));
+	run_ticks(5);
+	set_button(input::Button::power, false);
+	run_ticks(input::debounce_ms);
+	CHECK(input::next().kind == input::Kind::none);
+	CHECK(!input::held(input::Button::power));
+	CHECK(PCMSK2 & pins::power::mask);
+
+	//A press is taken once the pin has been left alone for debounce_ms
+	set_button(input::Button::power, true);
+	run_ticks(input::debounce_ms - 1);
+	CHECK(input::next().kind == input::Kind::none);
+	run_ticks(1);
+	CHECK(is_event(input::next(), input::Kind::press, input::Button::power));
+	CHECK(input::held(input::Button::power));
+
+	//Held, it long presses long_press_ms after (the tick the press is taken on counts), then repeats every repeat_ms
+	run_ticks(input::long_press_ms - 2);
+	CHECK(input::next().kind == input::Kind::none);
+	run_ticks(1);
+	CHECK(is_event(input::next(), input::Kind::long_press, input::Button::power));
+	run_ticks(input::repeat_ms - 1);
+	CHECK(input::next().kind == input::Kind::none);
+	run_ticks(1);
+	CHECK(is_event(input::next(), input::Kind::repeat, input::Button::power));
+	run_ticks(input::repeat_ms);
+	CHECK(is_event(input::next(), input::Kind::repeat, input::Button::power));
+
+	//Let go, it's released after the debounce, and nothing follows
+	set_button(input::Button::power, false);
+	run_ticks(input::debounce_ms);
+	CHECK(is_event(input::next(), input::Kind::release, input::Button::power));
+	CHECK(!input::held(input::Button::power));
+	run_ticks(input::repeat_ms * 2);
+	CHECK(input::next().kind == input::Kind::none);
+
+	//The generic inputs share an interrupt, but each is debounced on its own
+	set_button(input::Button::input0, true);
+	run_ticks(10);
+	set_button(input::Button::input1, true);
+	run_ticks(10);
+	CHECK(is_event(input::next(), input::Kind::press, input::Button::input0));
+	CHECK(input::next().kind == input::Kind::none);
+	run_ticks(10);
+	CHECK(is_event(input::next(), input::Kind::press, input::Button::input1));
+
+	//Left held with nothing taking the events, the queue fills and the rest are dropped (and counted): a long press and
+	//4 repeats each is 10 events
+	run_ticks(input::long_press_ms + (input::repeat_ms * 4));
+	CHECK_EQUAL(input::dropped(), 10 - input::queue_size);
+	uint8_t taken = 0;
+	while (input::next().kind != input::Kind::none) {
+		taken++;
+	}
+	CHECK_EQUAL(taken, input::queue_size);
+	set_button(input::Button::input0, false);
+	set_button(input::Button::input1, false);
+	run_ticks(input::debounce_ms + 10);
+	CHECK(is_event(input::next(), input::Kind::release, input::Button::input0));
+	CHECK(is_event(input::next(), input::Kind::release, input::Button::input1));
+
+	//In standby only the power button is watched (and the queue is emptied). What changed meanwhile is picked up on waking.
+	set_button(input::Button::power, true);
+	input::standby(true);
+	CHECK(!(PCICR & _BV(PCIE1)));
+	set_button(input::Button::input1, true);
+	run_ticks(input::debounce_ms * 2);
+	CHECK(is_event(input::next(), input::Kind::press, input::Button::power));
+	CHECK(input::next().kind == input::Kind::none);
+	input::standby(false);
+	run_ticks(input::debounce_ms);
+	CHECK(is_event(input::next(), input::Kind::press, input::Button::input1));
+	CHECK(input::next().kind == input::Kind::none);
+	set_button(input::Button::power, false);
+	set_button(input::Button::input1, false);
+	run_ticks(input::debounce_ms);
+	input::flush();
+	CHECK(input::next().kind == input::Kind::none);
+}
+
+//---Settings---//
+
+//Lets the values settle, then writes the record a byte per update()
+static void settings_write() {
+	run_ticks(settings::write_delay);
+	for (uint8_t i = 0; i <= settings::slot_size; i++) {
+		settings::update();
+	}
+}
+
+static bool same_location(settings::Location const &a, settings::Location const &b) {
+	return((a.sequence == b.sequence) && (a.slot == b.slot) && (a.digest == b.digest));
+}
+
+static void test_settings() {
+	harness_init();
+	settings::init();
+	CHECK_EQUAL(settings::get().similarity, 31);
+	CHECK_EQUAL(settings::get().speed, 1);
+	CHECK(settings::get().effect == settings::Effect::rainbow);
+	CHECK(!settings::pending());
+
+	//Out of range values are turned down and leave the value as it was. Setting what's there already isn't a change.
+	CHECK(!settings::set(settings::Field::similarity, 0));
+	CHECK(!settings::set(settings::Field::speed, 60001));
+	CHECK(!settings::set(settings::Field::effect, static_cast<uint8_t>(settings::Effect::pulse) + 1));
+	CHECK(!settings::set(settings::Field::hour_24, 2));
+	CHECK(!settings::set(settings::Field::amount, 0));
+	CHECK(settings::set(settings::Field::speed, 1));
+	CHECK_EQUAL(settings::get().similarity, 31);
+	CHECK(!settings::pending());
+
+	//Nothing's written until the values have stayed the same for write_delay, then the record goes in the next slot
+	settings::Location const first = settings::location();
+	CHECK(settings::set(settings::Field::similarity, 40));
+	CHECK(settings::set(settings::Field::speed, 500));
+	CHECK(settings::pending());
+	uint32_t const writes = hal::eeprom_writes;
+	run_ticks(settings::write_delay - 1);
+	settings::update();
+	CHECK_EQUAL(hal::eeprom_writes, writes);
+	CHECK(settings::set(settings::Field::effect, static_cast<uint8_t>(settings::Effect::sweep)));
+	run_ticks(settings::write_delay - 1);
+	settings::update();
+	CHECK_EQUAL(hal::eeprom_writes, writes);
+	settings_write();
+	CHECK(!settings::pending());
+	CHECK(hal::eeprom_writes > writes);
+	CHECK_EQUAL(settings::location().sequence, first.sequence + 1);
+	CHECK_EQUAL(settings::location().slot, (first.slot + 1) % settings::slots);
+	settings::init();
+	CHECK_EQUAL(settings::get().similarity, 40);
+	CHECK_EQUAL(settings::get().speed, 500);
+	CHECK(settings::get().effect == settings::Effect::sweep);
+
+	//Past the last slot the log wraps around, and the newest record is still the one loaded
+	settings::Location before = settings::location();
+	for (uint8_t i = 0; i < 20; i++) {
+		before = settings::location();
+		CHECK(settings::set(settings::Field::speed, 1000 + i));
+		settings_write();
+	}
+	settings::Location const wrapped = settings::location();
+	CHECK_EQUAL(wrapped.sequence, first.sequence + 21);
+	CHECK_EQUAL(wrapped.slot, (first.slot + 21) % settings::slots);
+	settings::init();
+	CHECK(same_location(settings::location(), wrapped));
+	CHECK_EQUAL(settings::get().speed, 1019);
+	CHECK_EQUAL(settings::get().similarity, 40);
+
+	//A hint that still matches its slot saves the search. One a record has been written after (or that's nonsense) is passed over.
+	settings::init(&wrapped);
+	CHECK(same_location(settings::location(), wrapped));
+	settings::init(&before);
+	CHECK(same_location(settings::location(), wrapped));
+	settings::Location const nonsense = { wrapped.sequence, settings::slots, wrapped.digest };
+	settings::init(&nonsense);
+	CHECK(same_location(settings::location(), wrapped));
+	CHECK_EQUAL(settings::get().speed, 1019);
+
+	//A write cut short (over an older record) fails its CRC, so the record before it is loaded
+	CHECK(settings::set(settings::Field::speed, 2000));
+	run_ticks(settings::write_delay);
+	for (uint8_t i = 0; i < 6; i++) {
+		settings::update();
+	}
+	CHECK(settings::pending());
+	settings::init();
+	CHECK(same_location(settings::location(), wrapped));
+	CHECK_EQUAL(settings::get().speed, 1019);
+	CHECK(!settings::pending());
+
+	//And the next write goes over it
+	CHECK(settings::set(settings::Field::speed, 2000));
+	settings_write();
+	CHECK_EQUAL(settings::location().sequence, wrapped.sequence + 1);
+	settings::init();
+	CHECK_EQUAL(settings::get().speed, 2000);
+}
+
+//---History---//
+
+static void test_history() {
+	harness_init();
+	telemetry::init();
+	history::init();
+	//Samples that move a lot (some past 16 bits), a little (inside the deadbands, see history.cpp), and not at all
+	constexpr uint8_t sample_amount = 30;
+	int32_t expected[sample_amount][5];
+	uint16_t faults = 0;
+	for (uint8_t k = 0; k < sample_amount; k++) {
+		history::Sample sample;
+		sample.temperature = (k % 5 == 4) ? static_cast<int16_t>(0x8000) : static_cast<int16_t>(-168 + (k * 37));
+		sample.light = (k % 2) ? 200 : 201;
+		sample.loops = 12000 + ((k % 4) * 10) + ((k == 7) ? 50000 : 0);
+		sample.frames = (k % 7) * 100;
+		uint16_t const added = k / 3;
+		faults += added;
+		sample.faults = faults;
+		expected[k][0] = sample.temperature;
+		expected[k][1] = sample.light;
+		expected[k][2] = sample.loops;
+		expected[k][3] = sample.frames;
+		expected[k][4] = added;
+		IC_DS1307::RegData const time = make_time(k / 6, (k % 6) * 10, 0, false);
+		for (uint16_t i = 0; i < history::interval; i++) {
+			history::second(sample, time);
+			history::update();
+		}
+	}
+	//Finishing a full block that's being written (which the last sample may have started)
+	for (uint8_t i = 0; i < history::block_size; i++) {
+		history::update();
+	}
+
+	//Sent oldest first, each block checked and decoded on its own, the samples come back within their deadbands
+	constexpr int32_t deadband[5] = { 2, 2, 16, 2, 1 };
+	uint8_t decoded = 0;
+	uint8_t blocks = 0;
+	for (uint8_t i = 0; history::dump(i); i++) {
+		uart_drain();
+	}
+	uint8_t frame[256];
+	int16_t length;
+	while ((length = frame_next(frame)) >= 0) {
+		if (!CHECK_EQUAL(length, 2 + history::block_size) || !CHECK_EQUAL(frame[0], static_cast<uint8_t>(telemetry::Type::history)))
+			break;
+		uint8_t const *const block = frame + 2;
+		CHECK_EQUAL(crc_dallas(block, history::block_size - 1), block[history::block_size - 1]);
+		CHECK_EQUAL(block[0] | (block[1] << 8), blocks);
+		CHECK_EQUAL(block[3], 2);
+		CHECK_EQUAL(block[4] | (block[5] << 8), ((decoded / 6) * 60) + ((decoded % 6) * 10));
+		blocks++;
+		int32_t value[5] = {};
+		uint8_t const *p = block + 6;
+		for (uint8_t s = 0; s < block[2]; s++, decoded++) {
+			if (!CHECK(decoded < sample_amount))
+				return;
+			uint8_t const changed = *p;
+			p++;
+			for (uint8_t f = 0; f < 5; f++) {
+				int32_t const moved = expected[decoded][f] - value[f];
+				if (!CHECK_EQUAL((changed >> f) & 0x01, (moved >= deadband[f]) || (moved <= -deadband[f])))
+					printf("\tsample %u field %u\n", decoded, f);
+				if (!(changed & _BV(f)))
+					continue;
+				uint32_t zigzag = 0;
+				uint8_t shift = 0;
+				do {
+					zigzag |= static_cast<uint32_t>(*p & 0x7f) << shift;
+					shift += 7;
+					p++;
+				} while (p[-1] & 0x80);
+				value[f] += (zigzag & 0x01) ? -static_cast<int32_t>(zigzag >> 1) - 1 : static_cast<int32_t>(zigzag >> 1);
+				CHECK_EQUAL(value[f], expected[decoded][f]);
+			}
+		}
+		CHECK(p <= block + history::block_size - 1);
+	}
+	CHECK_EQUAL(decoded, sample_amount);
+	CHECK(blocks > 2);
+}
+
+//---Telemetry---//
+
+static void test_telemetry() {
+	harness_init();
+	telemetry::init();
+	uint8_t frame[256];
+
+	//Zeros in the payload are COBS encoded away, so the only 0 sent ends the frame
+	uint8_t const payload[] = { 0x00, 0x11, 0x00, 0x00, 0x22 };
+	CHECK(telemetry::send(telemetry::Type::status, payload, sizeof(payload)));
+	uart_drain();
+	CHECK_EQUAL(uart_sent_length, 2 + sizeof(payload) + 2 + 2);
+	CHECK_EQUAL(std::count(uart_sent, uart_sent + uart_sent_length, 0), 1);
+	CHECK_EQUAL(uart_sent[uart_sent_length - 1], 0);
+	CHECK_EQUAL(frame_next(frame), 2 + sizeof(payload));
+	CHECK_EQUAL(frame[0], static_cast<uint8_t>(telemetry::Type::status));
+	uint8_t const sequence = frame[1];
+	CHECK(!memcmp(frame + 2, payload, sizeof(payload)));
+
+	//The largest payload, with no zeros at all
+	uint8_t full[telemetry::payload_max];
+	memset(full, 0xa5, sizeof(full));
+	CHECK(telemetry::send(telemetry::Type::history, full, sizeof(full)));
+	uart_drain();
+	CHECK_EQUAL(frame_next(frame), 2 + sizeof(full));
+	CHECK_EQUAL(frame[0], static_cast<uint8_t>(telemetry::Type::history));
+	CHECK_EQUAL(frame[1], static_cast<uint8_t>(sequence + 1));
+	CHECK(!memcmp(frame + 2, full, sizeof(full)));
+
+	//Too long a payload, or too little room in the transmit buffer, drops the frame (counted), without taking a sequence number
+	uint16_t const dropped = telemetry::dropped();
+	uint8_t too_long[telemetry::payload_max + 1] = {};
+	CHECK(!telemetry::send(telemetry::Type::status, too_long, sizeof(too_long)));
+	CHECK(telemetry::send(telemetry::Type::status, full, sizeof(full)));
+	CHECK(!telemetry::send(telemetry::Type::status, full, sizeof(full)));
+	CHECK_EQUAL(telemetry::dropped(), dropped + 2);
+	uart_drain();
+	CHECK(telemetry::send(telemetry::Type::status, payload, 1));
+	uart_drain();
+	CHECK_EQUAL(frame_next(frame), 2 + sizeof(full));
+	CHECK_EQUAL(frame[1], static_cast<uint8_t>(sequence + 2));
+	CHECK_EQUAL(frame_next(frame), 3);
+	CHECK_EQUAL(frame[1], static_cast<uint8_t>(sequence + 3));
+	CHECK_EQUAL(frame_next(frame), -1);
+
+	//A corrupted byte fails the CRC
+	CHECK(telemetry::send(telemetry::Type::status, payload, sizeof(payload)));
+	uart_drain();
+	uart_sent[uart_sent_length - 3] ^= 0x40;
+	CHECK_EQUAL(frame_next(frame), -1);
+}
+
+//---1-Wire---//
+
+//Runs a transaction to the end (a few ms), returning how it finished
+static onewire::Status onewire_run() {
+	onewire::start();
+	for (uint8_t i = 0; (i < 50) && onewire::busy(); i++) {
+		run_ticks(1);
+	}
+	return(onewire::status());
+}
+
+static void test_onewire() {
+	harness_init();
+	onewire::init();
+	CHECK(onewire::status() == onewire::Status::idle);
+
+	//Read ROM, from the only sensor
+	CHECK(onewire::begin());
+	onewire::reset();
+	onewire::write(DS18B20_CMD_READROM);
+	onewire::read(DS18B20_ROMSIZE);
+	onewire::start();
+	CHECK(onewire::busy());
+	CHECK(!onewire::begin());
+	CHECK(onewire_run() == onewire::Status::done);
+	CHECK_EQUAL(onewire::received()[0], 0x28);
+	CHECK_EQUAL(crc_dallas(onewire::received(), DS18B20_ROMSIZE), 0);
+
+	//The scratchpad as it powers up (85C, 12 bits)
+	CHECK(onewire::begin());
+	onewire::reset();
+	onewire::write(DS18B20_CMD_SKIPROM);
+	onewire::write(DS18B20_CMD_RSCRATCHPAD);
+	onewire::read(DS18B20_SCRATCHPADSIZE);
+	CHECK(onewire_run() == onewire::Status::done);
+	CHECK_EQUAL(onewire::received()[0], 0x50);
+	CHECK_EQUAL(onewire::received()[1], 0x05);
+	CHECK_EQUAL(onewire::received()[4], 0x7f);
+	CHECK_EQUAL(crc_dallas(onewire::received(), DS18B20_SCRATCHPADSIZE), 0);
+	CHECK(!bus_driven());
+
+	//With nothing on the bus the reset isn't answered
+	sim::ds18b20::set_amount(0);
+	CHECK(onewire::begin());
+	onewire::reset();
+	onewire::write(DS18B20_CMD_SKIPROM);
+	CHECK(onewire_run() == onewire::Status::no_presence);
+	CHECK(!bus_driven());
+	sim::ds18b20::set_amount(1);
+
+	//An interrupt that runs too late to sample the presence pulse spoils the transaction
+	CHECK(onewire::begin());
+	onewire::reset();
+	onewire::write(DS18B20_CMD_SKIPROM);
+	onewire::start();
+	for (uint8_t i = 0; i < 3; i++) {
+		//Due, then the reset, then the sample (late by 40us)
+		sim::now += static_cast<uint16_t>(OCR1A - static_cast<uint16_t>(sim::now)) + ((i == 2) ? 40 * (F_CPU / 1000000) : 0);
+		TIMER1_COMPA_vect();
+	}
+	CHECK(onewire::status() == onewire::Status::late);
+	CHECK(!onewire::busy());
+	CHECK(!(TIMSK1 & _BV(OCIE1A)));
+	CHECK(!bus_driven());
+}
+
+//---Temperature---//
+
+//Runs the tick along, calling update() every tick until it has new readings. Returns false if it didn't within ticks.
+static bool temperature_run(uint16_t const ticks) {
+	for (uint16_t i = 0; i < ticks; i++) {
+		run_ticks(1);
+		if (temperature::update())
+			return(true);
+	}
+	return(false);
+}
+
+static void test_temperature() {
+	harness_init();
+	sim::ds18b20::set_amount(2);
+	sim::ds18b20::set(344, 0);
+	sim::ds18b20::set(-168, 1);
+	temperature::init();
+
+	//The bus is searched first (the ROM cache is empty), then both are converted at once and read in turn
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK_EQUAL(temperature::sensors(), 2);
+	CHECK(temperature::valid(0));
+	CHECK(temperature::valid(1));
+	CHECK_EQUAL(temperature::get(0), 344);
+	CHECK_EQUAL(temperature::get(1), -168);
+	CHECK_EQUAL(temperature::conversion_time(), 750);
+
+	//A reading every interval
+	sim::ds18b20::set(400, 0);
+	uint64_t const start = sim::now;
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK(sim::now - start <= (temperature::interval + 50) * static_cast<uint64_t>(timer::period()));
+	CHECK_EQUAL(temperature::get(0), 400);
+	temperature::Errors const errors = temperature::errors();
+	CHECK_EQUAL(errors.crc + errors.no_presence + errors.late + errors.failed, 0);
+
+	//A sensor that's unplugged fails every retry (its scratchpad reads as all 1s), keeping its last reading while the other is
+	//still read. After rescan_after intervals of that the bus is searched again, and it's dropped.
+	sim::ds18b20::set_amount(1);
+	for (uint8_t i = 0; i < temperature::rescan_after; i++) {
+		CHECK(temperature_run(temperature::interval * 2));
+		CHECK(temperature::valid(0));
+		CHECK(!temperature::valid(1));
+		CHECK_EQUAL(temperature::get(1), -168);
+		CHECK_EQUAL(temperature::sensors(), 2);
+	}
+	CHECK_EQUAL(temperature::errors().failed, temperature::rescan_after);
+	CHECK_EQUAL(temperature::errors().crc, temperature::rescan_after * (temperature::retries + 1));
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK_EQUAL(temperature::sensors(), 1);
+	CHECK(temperature::valid(0));
+	CHECK(!temperature::valid(1));
+
+	//With none left nothing answers the reset, so there's no reading, and the bus is searched every interval after
+	sim::ds18b20::set_amount(0);
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK(!temperature::valid(0));
+	CHECK(temperature::errors().no_presence > 0);
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK_EQUAL(temperature::sensors(), 0);
+	sim::ds18b20::set_amount(1);
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK(temperature_run(temperature::interval * 2));
+	CHECK_EQUAL(temperature::sensors(), 1);
+	CHECK(temperature::valid(0));
+	CHECK_EQUAL(temperature::get(0), 400);
+}
+
+//---Checkpoint---//
+
+//Where the checkpoint is in the DS1307s registers (its RAM starts at 0x08)
+static constexpr uint8_t checkpoint_register = 0x08 + checkpoint::address;
+
+static void test_checkpoint() {
+	harness_init();
+	IC_DS1307 const rtc;
+	checkpoint::State state = { 123, { 0x1234, 5, 0x5a } };
+
+	//All zero RAM (a new battery) isn't a checkpoint, and leaves state alone
+	CHECK(!checkpoint::restore(rtc, state));
+	CHECK_EQUAL(state.hue_phase, 123);
+
+	//Saved and read back
+	CHECK_EQUAL(checkpoint::save(rtc, state), 0);
+	CHECK_EQUAL(rtc_ram[checkpoint_register], 1);
+	checkpoint::State restored = {};
+	CHECK(checkpoint::restore(rtc, restored));
+	CHECK_EQUAL(restored.hue_phase, 123);
+	CHECK_EQUAL(restored.settings.sequence, 0x1234);
+	CHECK_EQUAL(restored.settings.slot, 5);
+	CHECK_EQUAL(restored.settings.digest, 0x5a);
+
+	//A save only writes from the first byte that changed to the last (the CRC), and nothing if none did
+	uint32_t const writes = rtc_writes;
+	CHECK_EQUAL(checkpoint::save(rtc, state), 0);
+	CHECK_EQUAL(rtc_writes, writes);
+	state.settings.digest = 0x5b;
+	CHECK_EQUAL(checkpoint::save(rtc, state), 0);
+	CHECK_EQUAL(rtc_writes - writes, 2);
+	CHECK(checkpoint::restore(rtc, restored));
+	CHECK_EQUAL(restored.settings.digest, 0x5b);
+
+	//A byte that changed fails the CRC, and a hue phase past a turn is thrown out
+	rtc_ram[checkpoint_register + 3] ^= 0x01;
+	restored = {};
+	CHECK(!checkpoint::restore(rtc, restored));
+	CHECK_EQUAL(restored.settings.sequence, 0);
+	state.hue_phase = 360;
+	CHECK_EQUAL(checkpoint::save(rtc, state), 0);
+	CHECK(!checkpoint::restore(rtc, restored));
+
+	//Without the DS1307 there's no checkpoint, and saving fails
+	rtc_present = false;
+	state.hue_phase = 7;
+	CHECK(!checkpoint::restore(rtc, restored));
+	CHECK(checkpoint::save(rtc, state) != 0);
+	rtc_present = true;
+	CHECK_EQUAL(checkpoint::save(rtc, state), 0);
+	CHECK(checkpoint::restore(rtc, restored));
+	CHECK_EQUAL(restored.hue_phase, 7);
+}
+
+//---Calibrate---//
+
+//Runs the DS1307s 1Hz square wave (on PB1, rising at each second) for seconds seconds of second cycles each, calling
+//calibrate::update() on every edge
+static void square_wave(uint8_t const seconds, uint64_t const second) {
+	uint64_t const start = sim::now;
+	for (uint8_t i = 0; i < seconds; i++) {
+		for (uint8_t half = 0; half < 2; half++) {
+			run_until(start + (i * second) + (half * (second / 2)));
+			set_pin<pins::square_wave>(!half, PCINT0_vect, PCMSK0, _BV(PCIE0));
+			calibrate::update();
+		}
+	}
+}
+
+static void test_calibrate() {
+	harness_init();
+	cycles::init();
+	timer::trim(0);
+	set_pin<pins::square_wave>(false, PCINT0_vect, PCMSK0, _BV(PCIE0));
+
+	//A CPU crystal 50ppm fast. Each second of the square wave is 1000 cycles more than F_CPU, every one the same.
+	uint64_t const second = F_CPU + 1000;
+	//How much longer the tick is than it should be, at that speed (+ is slow)
+	double const tick = ((static_cast<double>(timer::period()) * F_CPU) / (static_cast<double>(timer::nominal()) * second) - 1) * 1e9;
+	calibrate::start(false);
+	CHECK(calibrate::running());
+	CHECK_EQUAL(rtc_ram[7], 0x10);
+	square_wave(calibrate::window + 1, second);
+	CHECK(!calibrate::running());
+	CHECK_EQUAL(rtc_ram[7], 0x80);
+	calibrate::Result const result = calibrate::result();
+	CHECK_EQUAL(result.seconds, calibrate::window);
+	CHECK_EQUAL(result.flags, 0);
+	CHECK_EQUAL(result.clock, 50000);
+	CHECK(std::abs(result.tick - tick) < 2);
+	//Off by up to a tick over the window
+	CHECK(std::abs(result.counted - tick) < 1e9 / (calibrate::window * 1000));
+	CHECK_EQUAL(result.jitter, 0);
+	CHECK_EQUAL(result.jitter_spread, 0);
+	CHECK_EQUAL(result.trim, 0);
+	CHECK_EQUAL(timer::trim(), 0);
+
+	//Stored, the tick error becomes the trim, and it's applied again at the next start up
+	calibrate::start(true);
+	square_wave(calibrate::window + 1, second);
+	CHECK(!calibrate::running());
+	CHECK_EQUAL(calibrate::result().flags, calibrate::flag_stored);
+	CHECK_EQUAL(timer::trim(), calibrate::result().tick);
+	CHECK_EQUAL(calibrate::result().trim, calibrate::result().tick);
+	timer::trim(0);
+	calibrate::init();
+	CHECK_EQUAL(timer::trim(), calibrate::result().tick);
+	timer::trim(0);
+
+	//Without the square wave it gives up once it has been gone for a while, with no result
+	calibrate::start(true);
+	for (uint16_t i = 0; (i < 5000) && calibrate::running(); i++) {
+		run_ticks(1);
+		calibrate::update();
+	}
+	CHECK(!calibrate::running());
+	CHECK_EQUAL(calibrate::result().seconds, 0);
+	CHECK_EQUAL(calibrate::result().flags, calibrate::flag_timeout);
+	CHECK_EQUAL(timer::trim(), 0);
+
+	//Or straight away, if the DS1307 doesn't answer
+	rtc_present = false;
+	calibrate::start(false);
+	CHECK(!calibrate::running());
+	CHECK_EQUAL(calibrate::result().flags, calibrate::flag_timeout);
+	rtc_present = true;
+}
+
+//---Runner---//
+
+int main(int argc, char *argv[]) {
+	struct Group {
+		char const *name;
+		void (*run)();
+	};
+	static Group const groups[] = {
+		{ "colour", test_colour },
+		{ "timer", test_timer },
+		{ "regdata", test_regdata },
+		{ "display", test_display },
+		{ "dsp", test_dsp },
+		{ "audio", test_audio },
+		{ "space", test_space },
+		{ "input", test_input },
+		{ "settings", test_settings },
+		{ "history", test_history },
+		{ "telemetry", test_telemetry },
+		{ "onewire", test_onewire },
+		{ "temperature", test_temperature },
+		{ "checkpoint", test_checkpoint },
+		{ "calibrate", test_calibrate }
+	};
+	bool ran = false;
+	for (Group const &group : groups) {
+		bool chosen = argc == 1;
+		for (int i = 1; i < argc; i++) {
+			if (!strcmp(argv[i], group.name))
+				chosen = true;
+		}
+		if (!chosen)
+			continue;
+		hal::reset();
+		uint32_t const failed = failures;
+		uint32_t const checked = checks;
+		group.run();
+		printf("%-10s %4u checks, %u failed\n", group.name, checks - checked, failures - failed);
+		ran = true;
+	}
+	if (!ran) {
+		fprintf(stderr, "usage: test [group ...]\ngroups:");
+		for (Group const &group : groups) {
+			fprintf(stderr, " %s", group.name);
+		}
+		fprintf(stderr, "\n");
+		return(2);
+	}
+	return(failures ? 1 : 0);
+}
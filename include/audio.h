@@ -0,0 +1,39 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+#ifndef __INTELLISENSE__
+#include <util/atomic.h>
+#endif
+
+#include "config.h"
+#include "dsp.h"
+
+//Samples the audio input from the ADC interrupt (triggered by Timer1 compare B) into a double buffer,
+//and splits each full block into a few Goertzel bands.
+//Timer1 must be free running at prescale 1 (see sfr_init()).
+namespace audio {
+	constexpr uint16_t sample_rate = 4000;
+	constexpr uint8_t block_size = 64;
+	constexpr uint8_t band_amount = 4;
+	//Cycles between samples
+	constexpr uint16_t period = F_CPU / sample_rate;
+	//Band levels below this are treated as silence
+	constexpr uint8_t silence = 96;
+	//A light (ADC0) sample is taken in place of every this many audio samples
+	constexpr uint8_t light_interval = block_size;
+
+	//Starts sampling (takes over the ADC)
+	void start();
+	//Stops sampling and hands the ADC back (set to ADC0)
+	void stop();
+	//Processes a full block if one is ready. Returns true if the band levels were updated.
+	bool update();
+	//Returns the level (0-255) of a band
+	uint8_t band(uint8_t const index);
+	//Returns the last light (ADC0) reading, since the ADC can't be polled while sampling
+	uint8_t light();
+	//Returns how many blocks were dropped because update() wasn't called in time
+	uint8_t overruns();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <inttypes.h>
+
+//Checks the tick (see timer.h) against the DS1307s crystal. The DS1307 puts a 1Hz square wave out on SQW/OUT (wired to PB1),
+//and each rising edge is timestamped in CPU cycles (see cycles.h), along with the tick count, for window seconds.
+//(The 32.768kHz wave would be more edges than the interrupt could keep up with, and a second of cycles is already 0.05ppm.)
+//From that it works out, in parts per billion:
+//	clock		how fast the CPUs crystal runs (+ is fast)
+//	tick		how slow the tick is (+ is slow), from the clock and the tick length determine_parameters() rounds to
+//	counted		how slow the ticks counted over the window were (with the trim, so it's the error the trim leaves)
+//	jitter		the standard deviation, and the spread (largest - smallest), of the one second periods (mostly interrupt latency)
+//Start it with the 'c' telemetry command (or 'C', which also stores the tick error as the trim). The result is sent as a frame.
+namespace calibrate {
+	//Seconds to count over (the clock is measured to about 1 / (window * F_CPU), the counted ticks to 1 / (window * 1000))
+	constexpr uint8_t window = 60;
+
+	struct Result {
+		uint8_t seconds;		//Seconds counted over (less than window if the square wave stopped)
+		int32_t clock;
+		int32_t tick;
+		int32_t counted;
+		int32_t jitter;
+		int32_t jitter_spread;
+		int32_t trim;			//The trim in use once it finished
+		uint8_t flags;			//See below
+	};
+	//Result flags
+	constexpr uint8_t flag_stored = 0x01;	//The tick error was stored as the trim
+	constexpr uint8_t flag_timeout = 0x02;	//The square wave stopped (or never started), so there's no result
+
+	//Call once after timer::init(). Applies the trim stored by the last calibration.
+	void init();
+	//Turns on the DS1307s square wave and starts counting. With store, the tick error is stored as the trim at the end.
+	void start(bool const store);
+	//Returns whether a calibration is running
+	bool running();
+	//Call every loop. Once the window is up it turns the square wave off and sends the result as a telemetry frame:
+	//	seconds (1), clock (4), tick (4), counted (4), jitter (4), jitter spread (4), trim (4), flags (1), all little endian
+	void update();
+	//Returns the last result
+	Result const &result();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <inttypes.h>
+#include "ic_ds1307.h"
+#include "settings.h"
+
+//Keeps what the lamp is doing in the DS1307s battery backed RAM, so after the power has been off it carries on from there:
+//the hues pick up where they were, and the settings load from the slot the checkpoint points at, instead of every slot being read.
+//It's read in one burst at the start, and saved every interval ms and before the lamp sleeps. A save only writes the bytes that
+//changed (see IC_DS1307::update_nvram), so one with nothing new costs no TWI time. It's stored at address in the RAM as:
+//	layout (1), hue phase (2), settings sequence (2), settings slot (1), settings digest (1), CRC-8 (Dallas/Maxim) of the rest
+//(The effect is one of the settings, so it comes back with them.)
+namespace checkpoint {
+	constexpr uint8_t address = 0;
+	//Time (ms) between saves
+	constexpr uint16_t interval = 10000;
+
+	struct State {
+		uint16_t hue_phase;				//Steps the hues have taken since they were spread (0-359)
+		settings::Location settings;	//See settings::location()
+	};
+
+	//Reads the checkpoint. Returns false (leaving state) if there isn't a valid one.
+	bool restore(IC_DS1307 const &rtc, State &state);
+	//Saves state. Returns 0, or the error from the DS1307 (see IC_DS1307::update_nvram).
+	uint8_t save(IC_DS1307 const &rtc, State const &state);
+}
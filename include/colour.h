@@ -1,9 +1,13 @@
 #pragma once
 
+#include <inttypes.h>
+
 typedef struct RGBColor {
-	int r;
-	int g;
-	int b;
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
 } RGBColor;
 
-RGBColor hsv2rgb(float H, float S, float V);
+//Converts a colour from HSV to RGB in fixed point (no floating point, or divides).
+//H is the hue in degrees (0-359), S and V are the saturation and value (0-255). Each channel comes out 0-255.
+RGBColor hsv2rgb(uint16_t H, uint8_t S, uint8_t V);
@@ -4,5 +4,12 @@
 // Define I/O pin (ws2812)
 ///////////////////////////////////////////////////////////////////////
 
-#define ws2812_port C     // Data port 
-#define ws2812_pin  1     // Data out pin
+#define ws2812_port c     // Data port (b, c or d)
+#define ws2812_pin  1     // Data out pin (of the first strip)
+#define ws2812_strips 1   // Strips driven in parallel, on consecutive pins from ws2812_pin
+
+///////////////////////////////////////////////////////////////////////
+// Define analogue inputs
+///////////////////////////////////////////////////////////////////////
+
+#define audio_adc_channel 6     // Audio/signal input for the reactive effect (ADC6, TQFP/QFN only)
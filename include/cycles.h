@@ -0,0 +1,22 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+#ifndef __INTELLISENSE__
+#include <util/atomic.h>
+#endif
+
+//A 32 bit CPU cycle count, made from Timer1 (free running at prescale 1, see sfr_init()) and a count of its overflows.
+//It wraps every 2^32 cycles (about 3.5 minutes at 20MHz), so only use it to time things shorter than that.
+//Interrupts mustn't be off for longer than a Timer1 period (65536 cycles) or an overflow is lost.
+namespace cycles {
+	//Call once after Timer1 is set up. Enables the overflow interrupt.
+	void init();
+	//Returns the cycles since init() (safe to call with interrupts on or off)
+	uint32_t now();
+	//Converts cycles to microseconds at compile time
+	constexpr uint32_t to_us(uint32_t const p0) {
+		return(p0 / (F_CPU / 1000000));
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <inttypes.h>
+#include "ic_ds1307.h"
+
+//Formats what the LCD shows. Kept apart from the LCD driver so it can be run (and checked) in the host build.
+namespace display {
+	//Characters on each line of the LCD, and the number of lines
+	constexpr uint8_t columns = 16;
+	constexpr uint8_t lines = 2;
+	//The most format() writes: every line, the '\n' between them and the terminating '\0'
+	constexpr uint8_t text_size = (columns * lines) + 2;
+
+	//Writes the time (and the temperature in 1/16 C, if valid) on the first line and the date on the second, eg
+	//	12:34:56PM 21.5C
+	//	Sun 01/02/2024
+	//The time is shown as 12 hour (with AM/PM), or 24 hour with hour_24 (two spaces where AM/PM goes), whichever mode the DS1307 keeps it in.
+	//text must hold text_size characters
+	void format(char text[], IC_DS1307::RegData const &time, bool const temperature_valid, int16_t const temperature, bool const hour_24 = false);
+
+	//A whole screen of character codes, a line at a time (no '\n' or '\0')
+	typedef uint8_t Screen[lines][columns];
+	//The columns a part of the screen takes (on both lines). Parts are redrawn whole (see lcd::draw()).
+	struct Part {
+		uint8_t column;
+		uint8_t width;
+	};
+
+	//Big digits: the hours and minutes 3 columns wide over both lines, built from the custom glyphs in big_glyphs
+	//(shown as characters big_glyph_code on, so they have to be loaded into CGRAM first), with the seconds and AM/PM small:
+	//	|HH HH : MM MM 56|
+	//	|HH HH : MM MM PM|
+	constexpr uint8_t big_glyph_amount = 8;
+	constexpr uint8_t big_glyph_code = 0x08;
+	//8 rows of 5 pixels (the low 5 bits) each, top first, in PROGMEM
+	extern uint8_t const big_glyphs[big_glyph_amount][8];
+	//The parts format_big() draws: each digit, the colon, a gap, and the seconds and AM/PM
+	constexpr uint8_t big_part_amount = 7;
+	extern Part const big_parts[big_part_amount];
+	//Draws the time in big digits (12 hour, or 24 hour with hour_24)
+	void format_big(Screen screen, IC_DS1307::RegData const &time, bool const hour_24 = false);
+}
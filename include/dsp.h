@@ -0,0 +1,26 @@
+#pragma once
+
+#include <inttypes.h>
+
+//Fixed point signal processing. Nothing in here touches the hardware.
+namespace dsp {
+	//The bin (k) nearest to freq, for n samples taken at rate
+	constexpr uint8_t bin(double const freq, double const rate, uint8_t const n) {
+		return(static_cast<uint8_t>((freq * n / rate) + 0.5));
+	}
+	constexpr double cos_series(double const x, double const term, uint8_t const n) {
+		return((n > 12) ? term : term + cos_series(x, -term * x * x / ((2 * n - 1) * (2 * n)), n + 1));
+	}
+	//Goertzel coefficient 2cos(2*pi*k/n) (Q14) for the bin nearest freq
+	constexpr int16_t goertzel_coeff(double const freq, double const rate, uint8_t const n) {
+		return(static_cast<int16_t>(2 * cos_series(2 * 3.14159265358979 * bin(freq, rate, n) / n, 1, 1) * 16384));
+	}
+
+	//Returns the mean of the samples (the DC offset)
+	int8_t mean(int8_t const samples[], uint8_t const len);
+	//Runs a Goertzel filter over the samples (minus offset) and returns the power in its bin.
+	//Keep the bin at 2 or more, or the filter state can overflow on a full scale input.
+	uint32_t goertzel(int8_t const samples[], uint8_t const len, int8_t const offset, int16_t const coeff);
+	//Converts a power to a logarithmic level (8 steps per doubling)
+	uint8_t level(uint32_t const power);
+}
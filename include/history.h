@@ -0,0 +1,44 @@
+#pragma once
+
+#include <inttypes.h>
+#include "ic_ds1307.h"
+
+//Keeps a rolling history of the lamps status: one sample every interval seconds, each the average (or the total) over it.
+//Samples are delta compressed into blocks. The block being filled is in SRAM, and once it's full it's written to EEPROM
+//(a byte per update(), so the main loop never waits), where the last blocks blocks are kept, the oldest written over first.
+//A sample takes a byte, and 1-3 more for each field that moved past its deadband (see history.cpp). In a steady room that's
+//2-3 bytes, 11-16 samples a block, so the blocks hold 22-32 hours. When every field moves every sample it's 5-6 bytes,
+//5-6 samples a block, and about 12 hours.
+//The 'h' telemetry command sends it all, oldest block first, a block per frame.
+//Each block is (all little endian):
+//	sequence (2), samples (1), date (1, day of the month), minute of the day (2) the first sample was taken at,
+//	the samples, padding, CRC-8 (Dallas/Maxim) of the rest
+//Each sample is a byte with a bit set for each field (see Sample, in order) that changed since it was last stored in the
+//block, then the change of each of those fields, zigzag encoded (0, -1, 1, -2... as 0, 1, 2, 3...) as a varint (7 bits a byte,
+//low first, bit 7 set on all but the last). Each block starts from all fields 0, so it can be decoded on its own.
+//The samples in SRAM are lost if the power goes, and none are taken while the lamp sleeps.
+namespace history {
+	//Seconds between samples (more if a full block is still being written to EEPROM)
+	constexpr uint16_t interval = 600;
+	constexpr uint8_t block_size = 40;
+	//Blocks kept in EEPROM
+	constexpr uint8_t blocks = 12;
+
+	struct Sample {
+		int16_t temperature;	//1/16 C (0x8000 if not valid), the last over the interval
+		uint8_t light;			//Light level, averaged
+		uint16_t loops;			//Loops per second, averaged
+		uint16_t frames;		//Neopixel frames per second, averaged
+		uint16_t faults;		//Temperature errors, audio overruns, dropped frames and dropped input events. Given as the running total, stored as the amount in the interval.
+	};
+
+	//Call once at the start. Finds the newest block in EEPROM.
+	void init();
+	//Call every second with the status over it (telemetry::update() does)
+	void second(Sample const &sample, IC_DS1307::RegData const &time);
+	//Call every loop. Writes a full block to EEPROM.
+	void update();
+	//Sends the history as telemetry frames (for the 'h' command), the blocks as they're stored.
+	//Returns false once index is past the end.
+	bool dump(uint8_t const index);
+}
@@ -22,13 +22,15 @@ namespace twi {
 	bool stop();
 	bool address(uint8_t const addr, bool const read);
 	bool recv_packet(uint8_t buffer[], uint8_t const len, bool const nack = true);
-	bool send_packet(uint8_t buffer[], uint8_t const len);
+	bool send_packet(uint8_t const buffer[], uint8_t const len);
 }
 
 class IC_DS1307 {
 public:
 	struct RegData {
 		bool operator==(RegData const &p0);
+		//Returns the hour (0-23) in either mode
+		uint8_t hour() const;
 		uint8_t second1 : 3;	//Seconds 10s digit
 		uint8_t second0 : 4;	//Seconds 1s digit
 		uint8_t minute1 : 3;	//Minutes 10s digit
@@ -49,6 +51,8 @@ public:
 		uint8_t rs : 2;			//(sqwe frequency) 0 = 1Hz; 1 = 4.096kHz; 2 = 8.192kHz; 3 = 32.768kHz;
 	};
 	constexpr static uint8_t twi_address_d = 0b1101000;
+	//Bytes of battery backed RAM (registers 0x08 to 0x3f). It keeps its contents while the lamp is off.
+	constexpr static uint8_t nvram_size = 56;
 
 	//Calls get_all
 	uint8_t update();
@@ -56,6 +60,15 @@ public:
 	uint8_t get_all();
 	//Sets the time and configuration on the ds1307 
 	uint8_t set_all() const;
+	//Sets only the configuration (out, sqwe and rs) on the ds1307, leaving the time running
+	uint8_t set_control() const;
+	//Reads len bytes of the battery backed RAM, from address (0 to nvram_size - 1) on, in one burst.
+	//Returns 0, the step that failed (like get_all), or 8 if it runs past the end of the RAM.
+	uint8_t get_nvram(uint8_t const address, uint8_t data[], uint8_t const len) const;
+	//Writes len bytes of the battery backed RAM from address on, skipping what's the same as cache (what the RAM already holds there).
+	//Only the span from the first to the last changed byte is sent, so writing unchanged data costs no TWI time at all.
+	//cache is updated as it's written. Returns like get_nvram.
+	uint8_t update_nvram(uint8_t const address, uint8_t const data[], uint8_t cache[], uint8_t const len) const;
 
 	IC_DS1307();
 	IC_DS1307(uint8_t const ntwi_address);
@@ -65,6 +78,13 @@ public:
 
 	RegData regData;
 protected:
+	//The register the battery backed RAM starts at
+	constexpr static uint8_t nvram_address = 0x08;
+
 	uint8_t get_raw_data(uint8_t data[]) const;
+	//Reads len bytes from the register at address on
+	uint8_t get_raw_data(uint8_t const address, uint8_t data[], uint8_t const len) const;
 	uint8_t set_raw_data(uint8_t data[]) const;
+	//Writes len bytes from the register at address on
+	uint8_t set_raw_data(uint8_t const address, uint8_t const data[], uint8_t const len) const;
 };
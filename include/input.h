@@ -0,0 +1,56 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+#ifndef __INTELLISENSE__
+#include <util/atomic.h>
+#endif
+
+//Reads the buttons (the power button and the generic inputs, see pins.h) from pin change interrupts, so nothing is polled
+//while they're idle. An edge masks the pins interrupt and starts a debounce, counted by the timer tick (see timer::on_tick()).
+//Once the pin has settled its level is taken, an event is queued, and the interrupt is unmasked.
+//While a button is held it's timed for a long press, then repeats. The main loop takes the events with next().
+//The buttons are pulled up, so pressed is low.
+namespace input {
+	enum class Button : uint8_t {
+		power,		//PD2
+		input0,		//PC2
+		input1		//PC3
+	};
+	constexpr uint8_t button_amount = 3;
+
+	enum class Kind : uint8_t {
+		none,			//The queue is empty
+		press,
+		release,
+		long_press,		//Held for long_press_ms
+		repeat			//Still held, every repeat_ms after the long press
+	};
+
+	struct Event {
+		Kind kind;
+		Button button;
+	};
+
+	//Ticks (ms) a pin has to be left alone after an edge before its level is taken
+	constexpr uint8_t debounce_ms = 20;
+	constexpr uint16_t long_press_ms = 1000;
+	constexpr uint16_t repeat_ms = 250;
+	//Events kept for the main loop (any more are dropped)
+	constexpr uint8_t queue_size = 8;
+
+	//Call once after timer::init(). Takes the buttons as they are (without events), and enables their interrupts.
+	void init();
+	//Returns the oldest event, and removes it from the queue (Kind::none if there isn't one)
+	Event next();
+	//Returns whether a button is down (debounced)
+	bool held(Button const p0);
+	//Empties the queue
+	void flush();
+	//Call with true before the lamp powers down, so only the power button can wake it (the generic inputs interrupts are
+	//turned off, and the queue is emptied). Call with false once it's awake, which picks up anything that changed meanwhile.
+	void standby(bool const on);
+	//Returns how many events were dropped because the queue was full
+	uint8_t dropped();
+}
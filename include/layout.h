@@ -0,0 +1,20 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////
+// Physical LED layout (used by space.h)
+///////////////////////////////////////////////////////////////////////
+
+//Distance (mm) from the lamp centre that maps to the edge of lamp space
+#define layout_extent 60
+
+//One entry per neopixel, in strip order (all of the first strip, then all of the next...).
+//Positions are in mm from the lamp centre (z is up).
+//POINT(x, y, z) places an LED directly.
+//POLAR(angle, radius, z) places an LED around the vertical axis (angle in degrees).
+//The default is a single turn helix, one LED every 72 degrees, rising 10mm per LED.
+#define LAYOUT(POINT, POLAR) \
+	POLAR(0, 30, -20) \
+	POLAR(72, 30, -10) \
+	POLAR(144, 30, 0) \
+	POLAR(216, 30, 10) \
+	POLAR(288, 30, 20)
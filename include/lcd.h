@@ -0,0 +1,35 @@
+#pragma once
+
+#include <inttypes.h>
+#include "display.h"
+
+//Drives the HD44780 display (4 bit, 2 lines), which is only ever written to.
+//The pins are fixed at compile time (see pins.h): data 0-3 on PB0, PB3, PB4, PB5, RS on PD3, R/W on PD4 (held low) and E on PD7.
+//The data pins are scattered over PORTB, so each nibble is looked up in a table of the pins it sets, and put out with one write of PORTB.
+namespace lcd {
+	//Custom glyphs CGRAM holds. Characters 0-7 (and 8-15) show them.
+	constexpr uint8_t glyph_slots = 8;
+
+	//Call once at the start (the pins have to be outputs). Sets the display up, on with no cursor, and clears it.
+	void init();
+	//Sends an instruction
+	void command(uint8_t const p0);
+	//Writes a character (or a CGRAM row) at the cursor
+	void write(uint8_t const p0);
+	//Writes a string at the cursor. '\n' moves to the start of the second line.
+	void print(char const *p0);
+	//Moves the cursor to a column of a line
+	void move(uint8_t const line, uint8_t const column);
+	//Clears the display, and moves the cursor to the start
+	void clear();
+	//Turns the display on or off (it keeps what it shows)
+	void power(bool const on);
+	//Loads amount glyphs (8 rows each, in PROGMEM) into the CGRAM slots from first on.
+	//Each slot remembers the glyph it was loaded with, and isn't written again for the same one. Leaves the cursor unknown.
+	void load_glyphs(uint8_t const glyphs[][8], uint8_t const first, uint8_t const amount);
+	//Forgets what the CGRAM slots hold (eg if the display might have lost power), so the next load_glyphs() writes them
+	void forget_glyphs();
+	//Draws screen. Only the parts that differ from shown (what the display holds) are written, each part whole
+	//on both lines, then shown is updated to match. Cells outside every part aren't written.
+	void draw(display::Screen const screen, display::Screen shown, display::Part const parts[], uint8_t const amount);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+//Watches how close the stack gets to the heap.
+//At start up (before main()) the free SRAM is painted with a known byte. update() then finds the lowest the stack
+//has ever been by looking for the first byte above the heap that isn't painted any more.
+namespace memory {
+	//The byte the free SRAM is painted with
+	constexpr uint8_t paint = 0xc5;
+	//Free SRAM (bytes) below which low() is true. Raise it if the neopixel or timer arrays grow.
+	constexpr uint16_t warning = 128;
+
+	struct Usage {
+		uint16_t data;			//.data (initialised variables)
+		uint16_t bss;			//.bss (zeroed variables)
+		uint16_t heap;			//malloc()ed (the timer array)
+		uint16_t stack;			//Stack in use now
+		uint16_t stack_max;		//The deepest the stack has been
+		uint16_t free_min;		//The least free SRAM there has been between the heap and the stack
+	};
+
+	//Scans the SRAM and returns the usage (takes up to about 1ms)
+	Usage const &update();
+	//Returns the usage found by the last update()
+	Usage const &usage();
+	//Returns whether free SRAM has dropped below warning
+	bool low();
+	//Sends the usage as a telemetry frame (for the 'm' command)
+	//The payload (little endian, 2 each) is: sram size, data, bss, heap, stack, stack max, free min, warning
+	bool dump(uint8_t const index);
+}
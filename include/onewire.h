@@ -0,0 +1,50 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+#ifndef __INTELLISENSE__
+#include <util/atomic.h>
+#endif
+
+#include "../avr_lib_ds18b20_02/src/ds18b20/ds18b20.h"
+
+//Runs 1-Wire transactions in the background, on the DS18B20 bus pin.
+//A transaction is queued up (resets, bytes to write, bytes to read), then start() runs it from the Timer1 compare A interrupt, one bit slot per interrupt.
+//Only the start of each slot (up to about 15us) runs with interrupts off, everything in between is left to the rest of the program.
+//Timer1 must be free running at prescale 1 (see sfr_init()). Don't use the blocking ds18b20_ functions while a transaction is running.
+namespace onewire {
+	enum class Status : uint8_t {
+		idle,
+		busy,
+		done,
+		no_presence,	//Nothing answered a reset
+		late			//An interrupt ran too late for a slot to be timed right (so the transaction can't be trusted)
+	};
+
+	//The most operations in one transaction (a reset, a ROM select and a read command need 12)
+	constexpr uint8_t queue_size = 16;
+	//The most bytes one transaction can read
+	constexpr uint8_t receive_size = 9;
+
+	//Call once at start up. Releases the bus.
+	void init();
+	//Empties the queue for a new transaction. Returns false if one is still running.
+	bool begin();
+	//Queues a reset (and presence check)
+	void reset();
+	//Queues a byte to write
+	void write(uint8_t const byte);
+	//Queues several bytes to write
+	void write(uint8_t const bytes[], uint8_t const len);
+	//Queues len bytes to read into received() (anything past receive_size is dropped)
+	void read(uint8_t const len);
+	//Runs the queued transaction
+	void start();
+	//Returns the status of the last transaction
+	Status status();
+	//Returns whether a transaction is running
+	bool busy();
+	//Returns the bytes read by the last transaction
+	uint8_t const *received();
+}
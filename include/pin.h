@@ -0,0 +1,107 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+//The ports, as the I/O address of their PINx register (DDRx and PORTx follow it)
+enum class Port : uint8_t {
+	b = 0x03,
+	c = 0x06,
+	d = 0x09
+};
+
+//An I/O pin, fixed at compile time. Everything is inline with constant addresses, so setting, clearing and testing the pin
+//compile to single sbi, cbi and sbis/sbic instructions, with nothing kept in RAM.
+//The registers are also given whole, for drivers that write several pins of a port at once.
+template <Port P, uint8_t B>
+struct Pin {
+	static_assert(B < 8, "A pin must be bit 0-7 of its port");
+	static constexpr Port port = P;
+	static constexpr uint8_t bit = B;
+	static constexpr uint8_t mask = 1 << B;
+	//I/O addresses of the registers (for inline assembly)
+	static constexpr uint8_t input_io = static_cast<uint8_t>(P);
+	static constexpr uint8_t direction_io = input_io + 1;
+	static constexpr uint8_t output_io = input_io + 2;
+
+	//PINx, DDRx and PORTx
+	static inline auto input_register() -> decltype(_SFR_IO8(0)) {
+		return(_SFR_IO8(input_io));
+	}
+	static inline auto direction_register() -> decltype(_SFR_IO8(0)) {
+		return(_SFR_IO8(direction_io));
+	}
+	static inline auto output_register() -> decltype(_SFR_IO8(0)) {
+		return(_SFR_IO8(output_io));
+	}
+
+	static inline void output() {
+		direction_register() |= mask;
+	}
+	static inline void input() {
+		direction_register() &= ~mask;
+	}
+	//Drives an output high (or turns the pull up of an input on)
+	static inline void high() {
+		output_register() |= mask;
+	}
+	//Drives an output low (or turns the pull up of an input off)
+	static inline void low() {
+		output_register() &= ~mask;
+	}
+	static inline void set(bool const p0) {
+		if (p0)
+			high();
+		else
+			low();
+	}
+	//Returns the level on the pin
+	static inline bool is_high() {
+		return(input_register() & mask);
+	}
+};
+
+//Consecutive pins of one port, driven together (eg parallel neopixel strips)
+template <Port P, uint8_t First, uint8_t Count>
+struct PinGroup {
+	static_assert((Count >= 1) && (First + Count <= 8), "A pin group must fit on its port");
+	static constexpr Port port = P;
+	static constexpr uint8_t first = First;
+	static constexpr uint8_t mask = ((1 << Count) - 1) << First;
+	static constexpr uint8_t input_io = static_cast<uint8_t>(P);
+	static constexpr uint8_t direction_io = input_io + 1;
+	static constexpr uint8_t output_io = input_io + 2;
+
+	static inline auto direction_register() -> decltype(_SFR_IO8(0)) {
+		return(_SFR_IO8(direction_io));
+	}
+	static inline auto output_register() -> decltype(_SFR_IO8(0)) {
+		return(_SFR_IO8(output_io));
+	}
+};
+
+//A list of pins (or pin groups), for compile time checks of how the ports are used
+template <typename... Pins>
+struct PinList;
+
+template <>
+struct PinList<> {
+	static constexpr uint8_t mask(Port const) {
+		return(0);
+	}
+	static constexpr bool distinct() {
+		return(true);
+	}
+};
+
+template <typename First, typename... Rest>
+struct PinList<First, Rest...> {
+	//Returns the pins of the list on a port
+	static constexpr uint8_t mask(Port const p0) {
+		return(((First::port == p0) ? First::mask : 0) | PinList<Rest...>::mask(p0));
+	}
+	//Returns false if any pin is in the list twice
+	static constexpr bool distinct() {
+		return(!(PinList<Rest...>::mask(First::port) & First::mask) && PinList<Rest...>::distinct());
+	}
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pin.h"
+#include "config.h"
+
+//Every pin the lamp uses, and how sfr_init() sets the ports up. The drivers take their pins from here.
+namespace pins {
+	//Power button (pressed is low, INT0 wakes the lamp)
+	typedef Pin<Port::d, 2> power;
+	//HD44780 display (see lcd.h). Data 0-3 are the displays D4-D7.
+	typedef Pin<Port::d, 3> lcd_rs;
+	typedef Pin<Port::d, 4> lcd_rw;
+	typedef Pin<Port::d, 7> lcd_enable;
+	typedef Pin<Port::b, 0> lcd_data0;
+	typedef Pin<Port::b, 3> lcd_data1;
+	typedef Pin<Port::b, 4> lcd_data2;
+	typedef Pin<Port::b, 5> lcd_data3;
+	//Display and power LED brightness (OC0A and OC0B)
+	typedef Pin<Port::d, 6> display_pwm;
+	typedef Pin<Port::d, 5> power_pwm;
+	//DS1307 square wave (open drain, see calibrate.h)
+	typedef Pin<Port::b, 1> square_wave;
+	//DS18B20 1-Wire bus (only ever driven low, see onewire.h). The blocking ds18b20_ functions use the librarys own macros.
+	typedef Pin<Port::b, 2> onewire;
+	//Neopixel data, one pin per strip (from config.h)
+	typedef PinGroup<Port::ws2812_port, ws2812_pin, ws2812_strips> neopixels;
+	//Light level (ADC0) and the generic inputs
+	typedef Pin<Port::c, 0> light;
+	typedef Pin<Port::c, 2> input0;
+	typedef Pin<Port::c, 3> input1;
+
+	typedef PinList<lcd_rs, lcd_rw, lcd_enable, lcd_data0, lcd_data1, lcd_data2, lcd_data3, display_pwm, power_pwm, neopixels> outputs;
+	typedef PinList<power, square_wave, onewire, light, input0, input1> inputs;
+
+	//What sfr_init() sets DDRx and PORTx to. Pins not above are outputs (driven low), except for the UART, TWI and crystal pins,
+	//which their peripherals take over.
+	//DDRx: 1 = output
+	constexpr uint8_t direction_b = 0b11111001;
+	constexpr uint8_t direction_c = 0b000010;
+	constexpr uint8_t direction_d = 0b11111011;
+	//PORTx: the pull ups
+	constexpr uint8_t pullup_b = square_wave::mask;
+	constexpr uint8_t pullup_c = input0::mask | input1::mask;
+	constexpr uint8_t pullup_d = power::mask;
+
+	static_assert(PinList<lcd_rs, lcd_rw, lcd_enable, lcd_data0, lcd_data1, lcd_data2, lcd_data3, display_pwm, power_pwm, neopixels,
+		power, square_wave, onewire, light, input0, input1>::distinct(), "A pin is assigned twice");
+	static_assert(((direction_b & outputs::mask(Port::b)) == outputs::mask(Port::b)) && !(direction_b & inputs::mask(Port::b)),
+		"direction_b doesn't match the PORTB pins");
+	static_assert(((direction_c & outputs::mask(Port::c)) == outputs::mask(Port::c)) && !(direction_c & inputs::mask(Port::c)),
+		"direction_c doesn't match the PORTC pins");
+	static_assert(((direction_d & outputs::mask(Port::d)) == outputs::mask(Port::d)) && !(direction_d & inputs::mask(Port::d)),
+		"direction_d doesn't match the PORTD pins");
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <inttypes.h>
+#include "cycles.h"
+
+//The main loop stages that can be timed. The names are sent with the dump, so tools/telemetry.py doesn't need to know them.
+#define PROFILE_STAGES(STAGE) \
+	STAGE(loop) \
+	STAGE(button) \
+	STAGE(light) \
+	STAGE(colour) \
+	STAGE(leds) \
+	STAGE(temperature) \
+	STAGE(clock) \
+	STAGE(display)
+
+//Times stages of the main loop in CPU cycles (see cycles.h), keeping the min, max, average and a coarse histogram of each.
+//Build with -DPROFILE (see CPPDEFS in the Makefile) to use it. Without it the macros below are empty, and no table is kept.
+namespace profile {
+#define PROFILE_ENUM(name) name,
+	enum class Stage : uint8_t {
+		PROFILE_STAGES(PROFILE_ENUM)
+		amount
+	};
+#undef PROFILE_ENUM
+	//The longest stage name (the dump has room for this many characters)
+	constexpr uint8_t name_size = 12;
+	//Histogram bins. Bin i counts times under 256 * 4^i cycles (about 12.8us * 4^i at 20MHz), the last bin counts the rest.
+	constexpr uint8_t bins = 8;
+
+	struct Stats {
+		uint16_t count;
+		uint32_t min;
+		uint32_t max;
+		uint32_t sum;		//Halved along with count (and the histogram) before it can overflow
+		uint16_t histogram[bins];
+	};
+
+	//Adds a time to a stage
+	void record(Stage const stage, uint32_t const time);
+	//Adds the time since the last lap of a stage (for timing a whole loop)
+	void lap(Stage const stage);
+	//Clears every stage
+	void reset();
+	//Sends a stage as a telemetry frame. Returns false once index is past the last stage.
+	//The payload (little endian) is: stage (1), count (2), min (4), max (4), average (4), histogram (2 each), name
+	bool dump(uint8_t const index);
+}
+
+#ifdef PROFILE
+#define PROFILE_BEGIN(stage) uint32_t const profile_start_##stage = cycles::now()
+#define PROFILE_END(stage) profile::record(profile::Stage::stage, cycles::now() - profile_start_##stage)
+#define PROFILE_LAP(stage) profile::lap(profile::Stage::stage)
+#else
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+#define PROFILE_LAP(stage)
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <inttypes.h>
+
+//The lamps tunables, kept in EEPROM so they can be changed over the UART without a reflash (see telemetry.h).
+//They're stored as a log of records in slots slots, each new record going in the slot after the newest, so the writes
+//are spread over all of them. Each record is:
+//	sequence (2, little endian), length of the values (1), the values (see Field), padding, CRC-8 (Dallas/Maxim) of the rest
+//The CRC is written last, so a write that's cut short leaves the previous record the newest valid one.
+//A change isn't written straight away. It waits until nothing has changed for write_delay ms, so a burst of changes is one record,
+//and then it's written a byte per update() as the EEPROM is ready, so the main loop never waits on it.
+namespace settings {
+	constexpr uint8_t slots = 16;
+	constexpr uint8_t slot_size = 16;
+	//Time (ms) settings have to stay the same before they're written
+	constexpr uint16_t write_delay = 3000;
+
+	//The neopixel effects
+	enum class Effect : uint8_t {
+		rainbow,	//The hues slowly drift through the lamp
+		reactive,	//Each neopixel follows the level of one audio band
+		sweep,		//The rainbow, lit by a plane sweeping up the lamp (once per turn of the hues)
+		pulse		//The rainbow, lit by a shell growing out from the centre of the lamp (once per turn of the hues)
+	};
+	//How the light level maps to brightness
+	enum class Curve : uint8_t {
+		linear,
+		square		//Dimmer in the dark, for the same light level (brightness = level^2 / 255)
+	};
+
+	//The values, in the order they're stored. New ones go on the end, so older records still load
+	//(the ones they don't have take their defaults).
+	enum class Field : uint8_t {
+		similarity,	//Increase this for less colour variation through the lamp (1-255, 1 is every neopixel the same)
+		speed,		//Time (ms) between each step of the hues (1-60000, 2 bytes)
+		effect,		//See Effect
+		hour_24,	//0 = show the time as 12 hour, 1 = 24 hour
+		curve,		//See Curve
+		big_digits,	//0 = show the time and date as text, 1 = the time in big digits (see display::format_big())
+		amount
+	};
+
+	struct Values {
+		uint8_t similarity = 31;
+		uint16_t speed = 1;
+		Effect effect = Effect::rainbow;
+		bool hour_24 = false;
+		Curve curve = Curve::linear;
+		bool big_digits = false;
+	};
+
+	//Where the newest record is, and its CRC (which covers the values, so it doubles as a digest of them)
+	struct Location {
+		uint16_t sequence;
+		uint8_t slot;
+		uint8_t digest;
+	};
+
+	//Call once at the start. Loads the newest valid record (or the defaults if there isn't one).
+	//Every slot is read, unless hint (a location() kept from before, see checkpoint.h) still matches its slot and the slot
+	//after it doesn't hold a newer record. Then only those two are.
+	void init(Location const *const hint = nullptr);
+	//Call every loop. Writes the values once they've settled.
+	void update();
+	//Returns the values in use
+	Values const &get();
+	//Sets one value (written later, see update()). Returns false if it's out of range (and leaves it).
+	bool set(Field const field, uint16_t const value);
+	//Returns where the newest record is (slot is slots - 1 and digest 0 if there isn't one)
+	Location location();
+	//Returns whether there's a change that isn't in EEPROM yet
+	bool pending();
+	//Sends the values as a telemetry frame. Returns false once index is past the end.
+	//The payload is: sequence (2), slot (1), pending (1), then the values as they're stored
+	bool dump(uint8_t const index);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+#include "layout.h"
+
+namespace space {
+	//Full scale of a coordinate. layout_extent mm from the centre becomes +-unit.
+	constexpr int8_t unit = 127;
+
+	//A point or direction in lamp space (fixed point, +-unit on each axis)
+	struct Vector {
+		int8_t x;
+		int8_t y;
+		int8_t z;
+	};
+
+	//An entry of the LED table. distance2 (|p|^2) is precomputed so spheres don't need it per frame.
+	struct Led {
+		constexpr Led(int8_t const nx, int8_t const ny, int8_t const nz) : position{ nx, ny, nz },
+			distance2(static_cast<uint16_t>(nx * nx) + static_cast<uint16_t>(ny * ny) + static_cast<uint16_t>(nz * nz)) {}
+		Vector position;
+		uint16_t distance2;
+	};
+
+	//A plane swept through the lamp. Brightest on the plane, fading by 2^shift per unit of distance.
+	struct Plane {
+		Vector normal;		//Unit normal (length unit)
+		int8_t offset;		//Distance of the plane from the centre along the normal
+		uint8_t shift;
+	};
+
+	//A spherical shell around a point. Use sphere() to prepare it once per frame.
+	struct Sphere {
+		Vector centre;
+		int32_t bias;		//|c|^2 - r^2
+		uint8_t shift;		//Fade by 1 per 2^shift units of (d^2 - r^2)
+	};
+
+	//Converts millimetres to lamp space at compile time
+	constexpr int8_t fixed(double const mm) {
+		return(static_cast<int8_t>((mm * unit / layout_extent) + ((mm < 0) ? -0.5 : 0.5)));
+	}
+	//sin() for constexpr evaluation only (Taylor series, x in radians within +-pi)
+	constexpr double sin_series(double const x, double const term, uint8_t const n) {
+		return((n > 12) ? term : term + sin_series(x, -term * x * x / ((2 * n) * (2 * n + 1)), n + 1));
+	}
+	constexpr double sin_deg(double const deg) {
+		return((deg > 180) ? sin_deg(deg - 360) : sin_series(deg * 3.14159265358979 / 180, deg * 3.14159265358979 / 180, 1));
+	}
+	constexpr double cos_deg(double const deg) {
+		return(sin_deg((deg + 90 >= 360) ? deg + 90 - 360 : deg + 90));
+	}
+
+	//The LED table, generated from LAYOUT in layout.h
+	extern Led const table[] PROGMEM;
+#define SPACE_COUNT_POINT(x, y, z) + 1
+#define SPACE_COUNT_POLAR(angle, radius, z) + 1
+	constexpr uint8_t led_count = 0 LAYOUT(SPACE_COUNT_POINT, SPACE_COUNT_POLAR);
+#undef SPACE_COUNT_POINT
+#undef SPACE_COUNT_POLAR
+
+	//Returns the position of an LED
+	Vector position(uint8_t const led);
+	//Returns (p . direction) / unit, the LEDs distance along a unit direction
+	int16_t dot(uint8_t const led, Vector const &direction);
+	//Returns 0-255 depending on how close an LED is to the plane
+	uint8_t plane(uint8_t const led, Plane const &p0);
+	//Prepares a spherical shell, once per frame
+	Sphere sphere(Vector const &centre, uint8_t const radius, uint8_t const shift);
+	//Returns 0-255 depending on how close an LED is to the shell
+	uint8_t shell(uint8_t const led, Sphere const &p0);
+	//Returns where a plane sweeping through the lamp is at step (of 0-last): -unit at 0 to unit at last
+	int8_t sweep(uint16_t const step, uint16_t const last);
+	//Returns the radius a shell growing out to radius_max has at step (of 0-last)
+	uint8_t pulse(uint16_t const step, uint16_t const last, uint8_t const radius_max);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <inttypes.h>
+#include "ic_ds1307.h"
+
+//Sends the lamps status over the UART as small binary frames, for tools/telemetry.py to decode.
+//Each frame is COBS encoded and ends with a 0 byte, so a reader can pick up the stream anywhere:
+//	type (1), sequence (1), payload, CRC-16/XMODEM of everything before it (2, little endian)
+//Sending never waits for the UART. If the transmit buffer is too full, the frame is dropped (and counted).
+//Single byte commands can be sent back (see update()). Longer replies (dumps) are sent a frame at a time as the buffer empties.
+namespace telemetry {
+	constexpr uint32_t baud = 19200;
+	//Time (ms) between status frames
+	constexpr uint16_t interval = 1000;
+	//Time (ms) a commands arguments have to follow it in, or the command is dropped (3 bytes take under 2ms at baud)
+	constexpr uint16_t argument_timeout = 100;
+	//The most payload one frame can carry
+	constexpr uint8_t payload_max = 48;
+
+	//Frame types
+	enum class Type : uint8_t {
+		status = 1,		//See update()
+		profile = 2,	//See profile::dump()
+		trace = 3,		//See trace::dump()
+		memory = 4,		//See memory::dump()
+		calibration = 5,	//See calibrate::update()
+		settings = 6,		//See settings::dump()
+		history = 7		//See history.h
+	};
+	//Sends one frame of a dump, returns false once index is past the end
+	typedef bool(*Dumper)(uint8_t const index);
+
+	//Call once after timer::init(). Sets up the UART.
+	void init();
+	//Call once every main loop
+	void loop();
+	//Call every time the neopixels are sent
+	void frame();
+	//Call every loop. Handles a received command:
+	//	'p' dumps the profile (if built with PROFILE), 'P' clears it
+	//	't' dumps the trace (if built with TRACE), 'T' clears it
+	//	'm' sends the SRAM usage
+	//	'c' checks the tick against the DS1307 (see calibrate.h), 'C' does too and stores the trim
+	//	'S' sends the settings, 's' followed by a field and a value (2, little endian) sets one and sends them (see settings.h).
+	//	The field and value have to arrive within argument_timeout, or the 's' is dropped and the bytes taken as commands.
+	//	'h' sends the history (see history.h)
+	//Once every interval it sends a status frame, and adds the status to the history (all little endian):
+	//	loops per second (2), neopixel frames per second (2), light level (1),
+	//	temperature in 1/16 C (2, 0x8000 if not valid), sensors (1), hour (1, 24 hour), minute (1), second (1),
+	//	temperature errors (crc, no presence, late, failed, 2 each), audio overruns (1), frames dropped (2),
+	//	least free SRAM (2), warnings (1, bit 0 = free SRAM below memory::warning), input events dropped (1)
+	void update(uint8_t const light, IC_DS1307::RegData const &time);
+	//Sends one frame. Returns false if it was dropped.
+	bool send(Type const type, uint8_t const payload[], uint8_t const len);
+	//Starts sending a dump (replacing any dump in progress)
+	void dump(Dumper const p0);
+	//Returns how many frames were dropped
+	uint16_t dropped();
+}
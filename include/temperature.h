@@ -0,0 +1,57 @@
+#pragma once
+
+#include <inttypes.h>
+#include "timer.h"
+#include "../avr_lib_ds18b20_02/src/ds18b20/ds18b20.h"
+
+//Reads the DS18B20 sensors in two phases, so the main loop never waits for a conversion.
+//update() starts a conversion on every sensor at once, then reads each one in turn once the conversion time has passed (counted with a Timer).
+//The bus traffic runs in the background (see onewire.h), only searching the bus and setting the resolution block.
+//The sensors ROM codes are cached in EEPROM. The bus is searched again when the cache is empty, when nothing answers a reset,
+//when a sensor has failed every retry for rescan_after intervals in a row (eg it was unplugged or replaced, while the others
+//still answer), and every rescan_every intervals regardless, so a sensor that was added is found.
+//The resolution sets how long a conversion takes (94ms at 9 bits, up to 750ms at 12 bits), so lower it to read more often.
+namespace temperature {
+	//Time (ms) from the start of one conversion to the start of the next.
+	//If a conversion takes longer, the next one starts as soon as it's read.
+	constexpr uint16_t interval = 1000;
+	//Resolution (bits) the sensors are set to at start up (0.5C steps at 9 bits, 0.0625C steps at 12 bits)
+	constexpr uint8_t resolution = 12;
+	static_assert((resolution >= DS18B20_MINRESOLUTION) && (resolution <= DS18B20_MAXRESOLUTION), "The DS18B20 resolution must be 9-12 bits");
+	//The most sensors that will be read
+	constexpr uint8_t sensor_max = 4;
+	//How many more times a scratchpad read is tried if it fails
+	constexpr uint8_t retries = 2;
+	//Intervals in a row a sensor has to fail in before the bus is searched again
+	constexpr uint8_t rescan_after = 3;
+	//Intervals between searches of the bus when nothing's wrong (about an hour)
+	constexpr uint16_t rescan_every = 3600;
+
+	//Counts of what went wrong, since start up (they stop at their maximum)
+	struct Errors {
+		uint16_t crc;			//Scratchpads that failed the CRC check
+		uint16_t no_presence;	//Resets nothing answered
+		uint16_t late;			//Transactions spoilt by another interrupt running too long
+		uint16_t failed;		//Readings given up on after every retry
+	};
+
+	//Call once after timer::init(). Loads the ROM cache (searching the bus if it's not valid).
+	void init();
+	//Searches the bus again, and replaces the ROM cache
+	void rescan();
+	//Call every loop. Returns true when new readings were taken.
+	bool update();
+	//Sets the resolution (9-12 bits) of every sensor. With persist it's also saved in the sensors EEPROM.
+	//Returns true if every sensor accepted it. Takes effect from the next conversion.
+	bool set_resolution(uint8_t const bits, bool const persist = false);
+	//Returns the time (ms) a conversion takes at the current resolution
+	uint16_t conversion_time();
+	//Returns the amount of sensors found
+	uint8_t sensors();
+	//Returns whether the last reading of a sensor succeeded
+	bool valid(uint8_t const sensor = 0);
+	//Returns the last reading of a sensor in 1/16 degrees C
+	int16_t get(uint8_t const sensor = 0);
+	//Returns the error counts
+	Errors const &errors();
+}
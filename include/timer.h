@@ -12,6 +12,8 @@
 class Timer;
 
 namespace timer {
+	//Called from the tick interrupt
+	typedef void (*TickHook)();
 	struct Parameter {
 		constexpr Parameter() {}
 		constexpr Parameter(uint8_t const nprescale, uint8_t const nhome, uint8_t const nloop) : prescale(nprescale), home(nhome), loop(nloop) {}
@@ -19,6 +21,13 @@ namespace timer {
 		uint8_t home = 0;
 		size_t loop = 0;
 	};
+	//What init() needs for a tick length. Make it with determine_tick(), as a constexpr.
+	struct Tick {
+		constexpr Tick(Parameter const nparam, uint32_t const nnominal) : param(nparam), nominal(nnominal) {}
+		Parameter param;
+		//The length a tick should be, in CPU cycles
+		uint32_t nominal;
+	};
 	struct Runtime {
 		Parameter param;
 		size_t loop_index = 0;
@@ -26,7 +35,18 @@ namespace timer {
 		size_t timer_amount = 0;
 		//Array of pointers
 		Timer **timer_buf = nullptr;
+		//Ticks since init()
+		uint32_t count = 0;
+		//The length a tick should be, in CPU cycles
+		uint32_t nominal = 0;
+		//Parts per billion the tick is slow by, and how far the ticks have fallen behind because of it (a tick is 1000000000)
+		int32_t trim = 0;
+		int32_t trim_error = 0;
+		//Called every tick (nullptr for none)
+		TickHook hook = nullptr;
 	};
+	//The largest trim (10%)
+	constexpr int32_t trim_max = 100000000;
 	constexpr double determine_cycles(double const prescale, double const interval, double const cpu_freq) {
 		return(interval / (1 / (cpu_freq / prescale)));
 	}
@@ -66,12 +86,29 @@ namespace timer {
 					determine_prescale_valid(1, interval, cpu_freq) ? determine_loop(1, interval, cpu_freq) :
 					0)));
 	}
-	void init(double const interval = 0.001);
+	//The determine_ functions use floating point, so they must only be worked out at compile time
+	constexpr Tick determine_tick(double const interval = 0.001, double const cpu_freq = F_CPU) {
+		return(Tick(determine_parameters(interval, cpu_freq), static_cast<uint32_t>(interval * cpu_freq)));
+	}
+	void init(Tick const &p0);
 	void next_tick();
 	void add(Timer *const ntimer);
 	void remove(Timer const *const ntimer);
 	size_t find(Timer const *const ntimer);
 	void tick();
+	//Returns the ticks since init() (including the ones added by the trim)
+	uint32_t count();
+	//Returns the length of a tick in CPU cycles, as determine_parameters() rounds it (without the trim)
+	uint32_t period();
+	//Returns the length a tick should be in CPU cycles (the interval given to determine_tick())
+	uint32_t nominal();
+	//Sets the trim, the parts per billion the tick is slow by (see calibrate.h). Every so often a tick is added (if it's slow)
+	//or dropped (if it's fast) to make up for it. It's limited to trim_max either way.
+	void trim(int32_t const ppb);
+	int32_t trim();
+	//Sets a function to call every tick, after the timers (nullptr for none). It runs in the tick interrupt, so keep it short.
+	//Set it only while there's work for it (it can be set and cleared from the hook itself), so an idle tick costs nothing extra.
+	void on_tick(TickHook const p0);
 }
 
 class Timer {
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+//Records timestamped events (interrupts, the neopixel blackout, TWI transactions...) in a small ring buffer,
+//so 't' (see telemetry.h) can dump them for tools/trace2chrome.py to show on a timeline.
+//Build with -DTRACE (see CPPDEFS and CDEFS in the Makefile) to use it. Without it the macros below are empty, and no buffer is kept.
+//This header is also used from C: the build gives it to the UART library with -include (see CDEFS in the Makefile),
+//for the UART_TRACE_ hooks at the bottom.
+
+//Records kept (a power of 2). The oldest are overwritten.
+#ifndef TRACE_SIZE
+#define TRACE_SIZE 64
+#endif
+
+//Event ids. TRACE_END() sets TRACE_ENDFLAG on the id of the matching TRACE_BEGIN().
+#define TRACE_LOOP 1		//The start of a main loop
+#define TRACE_LEDS 2		//The neopixels being sent (interrupts are off)
+#define TRACE_TWI 3			//Reading the clock
+#define TRACE_TIMER2 4		//The timer tick interrupt
+#define TRACE_INT0 5		//The power button waking the lamp
+#define TRACE_UARTRX 6		//A UART byte received (arg is the byte)
+#define TRACE_UARTTX 7		//A UART byte sent
+#define TRACE_ONEWIRE 8		//A 1-Wire slot interrupt
+#define TRACE_PCINT 9		//A button pin change interrupt (arg is the PCINT group)
+#define TRACE_ENDFLAG 0x80
+
+#ifdef TRACE
+
+//One event. The time is 24 bits of the cycle count (see cycles.h), so it wraps about every 0.84s at 20MHz.
+typedef struct {
+	uint16_t time;
+	uint8_t time_high;
+	uint8_t event;
+	uint8_t arg;
+} trace_record_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern trace_record_t trace_buffer[TRACE_SIZE];
+extern volatile uint8_t trace_head;
+extern volatile uint8_t trace_count;
+extern volatile uint8_t trace_enabled;
+//Counted by the Timer1 overflow interrupt (see cycles.cpp)
+extern volatile uint16_t cycles_overflows;
+
+//Adds an event (about 40 cycles, safe to call from an interrupt)
+static inline void trace_write(uint8_t event, uint8_t arg) {
+	uint8_t const sreg = SREG;
+	cli();
+	if (trace_enabled) {
+		uint16_t const time = TCNT1;
+		uint8_t high = (uint8_t)cycles_overflows;
+		trace_record_t *const record = &trace_buffer[trace_head];
+		//An overflow that hasn't been counted yet (interrupts are off)
+		if ((TIFR1 & _BV(TOV1)) && !(time & 0x8000))
+			high++;
+		record->time = time;
+		record->time_high = high;
+		record->event = event;
+		record->arg = arg;
+		trace_head = (trace_head + 1) & (TRACE_SIZE - 1);
+		if (trace_count < TRACE_SIZE)
+			trace_count++;
+	}
+	SREG = sreg;
+}
+
+#ifdef __cplusplus
+}
+
+namespace trace {
+	//Sends some of the records (oldest first) as a telemetry frame. Returns false once every record has been sent.
+	//Recording stops from the first frame, and the buffer is cleared after the last.
+	//The payload is: first record (1), records in the whole dump (1), records (time (2, little endian), time high (1), event (1), arg (1))
+	bool dump(uint8_t const index);
+	//Clears the buffer
+	void clear();
+}
+#endif
+
+#define TRACE_EVENT(event, arg) trace_write((event), (arg))
+#define TRACE_BEGIN(event) trace_write((event), 0)
+#define TRACE_END(event) trace_write((event) | TRACE_ENDFLAG, 0)
+
+#else
+
+#define TRACE_EVENT(event, arg)
+#define TRACE_BEGIN(event)
+#define TRACE_END(event)
+
+#endif
+
+//The UART library's hooks (empty unless built with TRACE)
+#define UART_TRACE_RX(data) TRACE_EVENT(TRACE_UARTRX, (data))
+#define UART_TRACE_TX() TRACE_EVENT(TRACE_UARTTX, 0)
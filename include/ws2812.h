@@ -0,0 +1,41 @@
+#pragma once
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include "pins.h"
+
+//A neopixel colour, in the order the WS2812 expects it (same layout as light_ws2812's cRGB)
+struct cRGB {
+	uint8_t g;
+	uint8_t r;
+	uint8_t b;
+};
+
+//Drives up to 8 WS2812 strips on one port at the same time.
+//Each bit slot is a single port write for every strip, so sending N neopixels over K strips takes N/K slots.
+namespace ws2812 {
+	constexpr uint8_t strips = ws2812_strips;
+	//Mask of the data pins on the port (pins::neopixels checks they fit)
+	constexpr uint8_t mask = pins::neopixels::mask;
+
+	//Bytes of bit planes needed for strips of len neopixels (one byte per bit slot, one bit per strip)
+	constexpr uint16_t plane_size(uint16_t const len) {
+		return((strips > 1) ? len * 24 : 1);
+	}
+
+	//Sets the data pins to outputs
+	void init();
+	//Builds the bit planes of len neopixels per strip (nothing with one strip). led holds each strip one after the other.
+	//Call it before setleds(), with interrupts still on.
+	void transpose(cRGB const led[], uint16_t const len, uint8_t plane[]);
+	//Sends len neopixels to every strip. With more than one strip it sends plane, which transpose() has to have built from led
+	//(plane_size(len) bytes). Disable interrupts around this (and only this), as the timing is cycle counted.
+	void setleds(cRGB const led[], uint16_t const len, uint8_t const plane[]);
+
+#ifdef HOST
+	//Host builds have no pins to drive, so setleds() hands the neopixels to this instead (if set).
+	//len is the neopixels of every strip, as led holds them (one strip after the other).
+	typedef void (*Sink)(cRGB const led[], uint16_t const len);
+	extern Sink sink;
+#endif
+}
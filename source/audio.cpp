@@ -0,0 +1,136 @@
+#include "../include/audio.h"
+
+//The bands (Goertzel coefficients), roughly an octave apart
+static constexpr int16_t band_coeff[audio::band_amount] = {
+	dsp::goertzel_coeff(125, audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(250, audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(500, audio::sample_rate, audio::block_size),
+	dsp::goertzel_coeff(1000, audio::sample_rate, audio::block_size)
+};
+static_assert(dsp::bin(125, audio::sample_rate, audio::block_size) >= 2, "Lowest band is too close to DC");
+
+//Mask of the ADMUX channel bits
+static constexpr uint8_t mux_mask = _BV(MUX3) | _BV(MUX2) | _BV(MUX1) | _BV(MUX0);
+
+//The ISR fills one buffer while update() reads the other
+static volatile int8_t buffer[2][audio::block_size];
+static volatile uint8_t fill_buffer = 0;
+static volatile uint8_t fill_index = 0;
+//The last audio sample taken (it may be in the other buffer)
+static volatile int8_t last_sample = 0;
+//Index of the buffer waiting for update(), or -1
+static volatile int8_t ready_buffer = -1;
+//Whether the conversion in progress is a light (ADC0) sample
+static volatile bool light_sample = false;
+static volatile uint8_t light_level = 0;
+static volatile uint8_t overrun_amount = 0;
+static uint8_t band_level[audio::band_amount];
+
+#ifndef __INTELLISENSE__
+ISR(ADC_vect) {
+	//Schedule the next conversion, and clear the compare flag so it triggers again
+	OCR1B += audio::period;
+	TIFR1 = _BV(OCF1B);
+	uint8_t const value = ADCH;
+	int8_t sample = static_cast<int8_t>(value - 0x80);
+	if (light_sample) {
+		light_level = value;
+		ADMUX = (ADMUX & ~mux_mask) | audio_adc_channel;
+		light_sample = false;
+		//Repeat the last audio sample in place of the light sample
+		sample = last_sample;
+	}
+	last_sample = sample;
+	buffer[fill_buffer][fill_index] = sample;
+	fill_index++;
+	if ((fill_index % audio::light_interval) == 0) {
+		//The next conversion reads the light sensor
+		ADMUX &= ~mux_mask;
+		light_sample = true;
+	}
+	if (fill_index == audio::block_size) {
+		if (ready_buffer != -1)
+			overrun_amount++;
+		ready_buffer = fill_buffer;
+		fill_buffer ^= 1;
+		fill_index = 0;
+	}
+}
+#endif
+
+void audio::start() {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		fill_buffer = 0;
+		fill_index = 0;
+		last_sample = 0;
+		ready_buffer = -1;
+		light_sample = false;
+		ADMUX = (ADMUX & ~mux_mask) | audio_adc_channel;
+		//ADC clock of F_CPU/32 (625kHz), fine for 8 bit results
+		ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | _BV(ADPS2) | _BV(ADPS0);
+		//Trigger on Timer1 compare match B
+		ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | _BV(ADTS2) | _BV(ADTS0);
+		OCR1B = TCNT1 + period;
+		TIFR1 = _BV(OCF1B);
+		//Enable auto triggering and the interrupt (writing ADIF clears it)
+		ADCSRA |= _BV(ADATE) | _BV(ADIE) | _BV(ADIF);
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+void audio::stop() {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		ADCSRA &= ~(_BV(ADATE) | _BV(ADIE));
+		ADMUX &= ~mux_mask;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	//Let a conversion in progress finish
+	while (ADCSRA & _BV(ADSC));
+}
+
+bool audio::update() {
+	int8_t ready;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		ready = ready_buffer;
+		ready_buffer = -1;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	if (ready == -1)
+		return(false);
+	//The ISR won't touch this buffer until the other one is full
+	int8_t const *const samples = const_cast<int8_t const *>(buffer[ready]);
+	int8_t const offset = dsp::mean(samples, block_size);
+	for (uint8_t i = 0; i < band_amount; i++) {
+		uint8_t const level = dsp::level(dsp::goertzel(samples, block_size, offset, band_coeff[i]));
+		uint8_t value = 0;
+		if (level > silence)
+			value = ((level - silence) >= 64) ? 255 : (level - silence) << 2;
+		//Rise straight away, fall slowly
+		if (value >= band_level[i])
+			band_level[i] = value;
+		else
+			band_level[i] -= (band_level[i] - value + 7) >> 3;
+	}
+	return(true);
+}
+
+uint8_t audio::band(uint8_t const index) {
+	return(band_level[index]);
+}
+
+uint8_t audio::light() {
+	return(light_level);
+}
+
+uint8_t audio::overruns() {
+	return(overrun_amount);
+}
@@ -0,0 +1,258 @@
+#include "../include/calibrate.h"
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "../include/timer.h"
+#include "../include/cycles.h"
+#include "../include/ic_ds1307.h"
+#include "../include/telemetry.h"
+#include "../include/pins.h"
+
+#ifndef __INTELLISENSE__
+#include <util/atomic.h>
+#endif
+
+//The trim, with a check byte so blank (or half written) EEPROM isn't taken for one
+struct StoredTrim {
+	int32_t ppb;
+	uint8_t check;
+};
+
+static StoredTrim EEMEM trim_eeprom;
+
+//Set by the pin change interrupt, read once it's finished (or timed out)
+static volatile bool counting = false;
+static volatile uint8_t edges = 0;
+static uint32_t first_cycles = 0;
+static uint32_t last_cycles = 0;
+static uint32_t first_ticks = 0;
+static uint32_t last_ticks = 0;
+//The one second periods, less F_CPU
+static int64_t error_sum = 0;
+static uint64_t error_squares = 0;
+static int32_t error_min = 0;
+static int32_t error_max = 0;
+
+static bool active = false;
+static bool store_trim = false;
+static calibrate::Result last_result = {};
+
+//Gives up if the square wave stops for this long
+static Timer timeout;
+static constexpr uint16_t timeout_ms = 2500;
+
+//Clocks the DS1307s square wave. Its own instance, so the main loops clock isn't disturbed.
+static IC_DS1307 rtc;
+//PCINT0 covers PORTB (PCINT0-7 are PB0-7)
+typedef pins::square_wave sqw;
+static_assert(sqw::port == Port::b, "The square wave must be on PORTB, for PCINT0");
+
+static uint8_t check(int32_t const ppb) {
+	uint8_t sum = 0x5a;
+	for (uint8_t i = 0; i < 4; i++) {
+		sum += static_cast<uint8_t>(ppb >> (i * 8));
+	}
+	return(sum);
+}
+
+#ifndef __INTELLISENSE__
+ISR(PCINT0_vect) {
+	//Only the rising edges of PB1
+	if (!counting || !sqw::is_high())
+		return;
+	uint32_t const now = cycles::now();
+	uint32_t const ticks = timer::count();
+	if (edges == 0) {
+		first_cycles = now;
+		first_ticks = ticks;
+	}
+	else {
+		//Wraps every 2^32 cycles, but a period is only F_CPU
+		int32_t const error = static_cast<int32_t>(now - last_cycles) - static_cast<int32_t>(F_CPU);
+		error_sum += error;
+		error_squares += static_cast<uint64_t>(static_cast<int64_t>(error) * error);
+		if ((edges == 1) || (error < error_min))
+			error_min = error;
+		if ((edges == 1) || (error > error_max))
+			error_max = error;
+	}
+	last_cycles = now;
+	last_ticks = ticks;
+	edges++;
+	if (edges > calibrate::window)
+		counting = false;
+}
+#endif
+
+//Returns the square root, rounded down
+static uint32_t isqrt(uint64_t const p0) {
+	uint64_t result = 0;
+	uint64_t bit = static_cast<uint64_t>(1) << 62;
+	uint64_t rest = p0;
+	while (bit > rest) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (rest >= result + bit) {
+			rest -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return(static_cast<uint32_t>(result));
+}
+
+//Works the result out from the edges counted (called with the interrupt finished with them)
+static void finish() {
+	calibrate::Result &result = last_result;
+	result = {};
+	uint8_t const n = (edges > 0) ? edges - 1 : 0;
+	result.seconds = n;
+	if (n == 0) {
+		result.flags = calibrate::flag_timeout;
+		result.trim = timer::trim();
+		return;
+	}
+	if (n < calibrate::window)
+		result.flags |= calibrate::flag_timeout;
+	int64_t const expected = static_cast<int64_t>(n) * F_CPU;
+	//The CPU ran error_sum / n cycles a second more than F_CPU
+	result.clock = static_cast<int32_t>((error_sum * 1000000000) / expected);
+	//A tick lasts period / (F_CPU + error_sum / n) seconds, and should last nominal / F_CPU. How much longer it is:
+	//	(period * n * F_CPU) / (nominal * (n * F_CPU + error_sum)) - 1
+	//(split up so nothing overflows 64 bits)
+	int64_t const actual = static_cast<int64_t>(timer::period()) * F_CPU * n;
+	int64_t const ideal = static_cast<int64_t>(timer::nominal()) * (expected + error_sum);
+	result.tick = static_cast<int32_t>(((actual - ideal) * 1000) / (ideal / 1000000));
+	//The ticks there should have been (n * F_CPU / nominal) against the ticks counted, so it's comparable with tick
+	int64_t const counted = static_cast<int64_t>(last_ticks - first_ticks) * timer::nominal();
+	if (counted)
+		result.counted = static_cast<int32_t>(((expected - counted) * 1000000000) / counted);
+	//The spread of the periods (cycles squared), then in parts per billion of a second
+	int64_t const mean = error_sum / n;
+	int64_t const variance = static_cast<int64_t>(error_squares / n) - (mean * mean);
+	result.jitter = static_cast<int32_t>((static_cast<int64_t>(isqrt((variance > 0) ? variance : 0)) * 1000000000) / F_CPU);
+	result.jitter_spread = static_cast<int32_t>((static_cast<int64_t>(error_max - error_min) * 1000000000) / F_CPU);
+	if (store_trim && !(result.flags & calibrate::flag_timeout)) {
+		timer::trim(result.tick);
+		StoredTrim const stored = { timer::trim(), check(timer::trim()) };
+		eeprom_update_block(&stored, &trim_eeprom, sizeof(stored));
+		result.flags |= calibrate::flag_stored;
+	}
+	result.trim = timer::trim();
+}
+
+//Sends the result as a telemetry frame (see update())
+static bool dump(uint8_t const index) {
+	if (index)
+		return(false);
+	calibrate::Result const &result = last_result;
+	int32_t const values[] = { result.clock, result.tick, result.counted, result.jitter, result.jitter_spread, result.trim };
+	uint8_t payload[1 + sizeof(values) + 1];
+	payload[0] = result.seconds;
+	for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		for (uint8_t j = 0; j < 4; j++) {
+			payload[1 + (i * 4) + j] = static_cast<uint8_t>(values[i] >> (j * 8));
+		}
+	}
+	payload[sizeof(payload) - 1] = result.flags;
+	telemetry::send(telemetry::Type::calibration, payload, sizeof(payload));
+	return(true);
+}
+
+void calibrate::init() {
+	StoredTrim stored;
+	eeprom_read_block(&stored, &trim_eeprom, sizeof(stored));
+	if ((stored.check == check(stored.ppb)) && (stored.ppb <= timer::trim_max) && (stored.ppb >= -timer::trim_max))
+		timer::trim(stored.ppb);
+}
+
+void calibrate::start(bool const store) {
+	if (active)
+		return;
+	store_trim = store;
+	//SQW/OUT is open drain, so PB1 is an input with its pull up
+	sqw::input();
+	sqw::high();
+	//1Hz
+	rtc.regData.out = 0;
+	rtc.regData.sqwe = 1;
+	rtc.regData.rs = 0;
+	if (rtc.set_control()) {
+		last_result = {};
+		last_result.flags = flag_timeout;
+		last_result.trim = timer::trim();
+		telemetry::dump(dump);
+		return;
+	}
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		edges = 0;
+		error_sum = 0;
+		error_squares = 0;
+		counting = true;
+		PCMSK0 |= sqw::mask;
+		PCIFR = _BV(PCIF0);
+		PCICR |= _BV(PCIE0);
+#ifndef __INTELLISENSE__
+	}
+#endif
+	active = true;
+	timeout.reset();
+	timeout = timeout_ms;
+	timeout.start();
+}
+
+bool calibrate::running() {
+	return(active);
+}
+
+void calibrate::update() {
+	if (!active)
+		return;
+	uint8_t seen;
+	bool still_counting;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		seen = edges;
+		still_counting = counting;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	//Every edge puts the timeout off
+	static uint8_t seen_last = 0;
+	if (seen != seen_last) {
+		seen_last = seen;
+		timeout.reset();
+		timeout = timeout_ms;
+		timeout.start();
+	}
+	if (still_counting && !timeout)
+		return;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		counting = false;
+		PCMSK0 &= ~sqw::mask;
+		PCICR &= ~_BV(PCIE0);
+#ifndef __INTELLISENSE__
+	}
+#endif
+	seen_last = 0;
+	active = false;
+	timeout.stop();
+	//Square wave off (SQW/OUT left high)
+	rtc.regData.out = 1;
+	rtc.regData.sqwe = 0;
+	rtc.set_control();
+	finish();
+	telemetry::dump(dump);
+}
+
+calibrate::Result const &calibrate::result() {
+	return(last_result);
+}
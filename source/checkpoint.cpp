@@ -0,0 +1,57 @@
+#include "../include/checkpoint.h"
+#include <util/crc16.h>
+
+//Bumped if the layout changes, so an old checkpoint isn't misread (it also stops all zero RAM passing the CRC)
+static constexpr uint8_t layout = 1;
+static constexpr uint8_t size = 8;
+static_assert(checkpoint::address + size <= IC_DS1307::nvram_size, "The checkpoint must fit in the DS1307s RAM");
+
+//What the RAM holds (valid once it has been read or written)
+static uint8_t cache[size];
+static bool cached = false;
+
+static uint8_t crc(uint8_t const p0[]) {
+	uint8_t result = 0;
+	for (uint8_t i = 0; i < size - 1; i++) {
+		result = _crc_ibutton_update(result, p0[i]);
+	}
+	return(result);
+}
+
+bool checkpoint::restore(IC_DS1307 const &rtc, State &state) {
+	cached = !rtc.get_nvram(address, cache, size);
+	if (!cached || (cache[0] != layout) || (crc(cache) != cache[size - 1]))
+		return(false);
+	uint16_t const hue_phase = cache[1] | (static_cast<uint16_t>(cache[2]) << 8);
+	if (hue_phase >= 360)
+		return(false);
+	state.hue_phase = hue_phase;
+	state.settings.sequence = cache[3] | (static_cast<uint16_t>(cache[4]) << 8);
+	state.settings.slot = cache[5];
+	state.settings.digest = cache[6];
+	return(true);
+}
+
+uint8_t checkpoint::save(IC_DS1307 const &rtc, State const &state) {
+	uint8_t data[size];
+	data[0] = layout;
+	data[1] = static_cast<uint8_t>(state.hue_phase);
+	data[2] = static_cast<uint8_t>(state.hue_phase >> 8);
+	data[3] = static_cast<uint8_t>(state.settings.sequence);
+	data[4] = static_cast<uint8_t>(state.settings.sequence >> 8);
+	data[5] = state.settings.slot;
+	data[6] = state.settings.digest;
+	data[size - 1] = crc(data);
+	//The cache has to match the RAM for only the changes to be written
+	if (!cached) {
+		uint8_t const result = rtc.get_nvram(address, cache, size);
+		if (result)
+			return(result);
+		cached = true;
+	}
+	uint8_t const result = rtc.update_nvram(address, data, cache, size);
+	//A write that failed part way leaves the RAM unknown
+	if (result)
+		cached = false;
+	return(result);
+}
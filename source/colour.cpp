@@ -1,34 +1,34 @@
 #include "../include/colour.h"
-#include <math.h>
 
+//Returns p0 / 255 (rounded down) for p0 up to 255 * 255, with a shift and add rather than a divide
+static inline uint8_t div255(uint16_t const p0) {
+	return((p0 + 1 + (p0 >> 8)) >> 8);
+}
 
-
-RGBColor hsv2rgb(float H, float S, float V) {
-	float r, g, b;
-
-	float h = H / 360;
-	float s = S / 100;
-	float v = V / 100;
-
-	int i = floor(h * 6);
-	float f = h * 6 - i;
-	float p = v * (1 - s);
-	float q = v * (1 - f * s);
-	float t = v * (1 - (1 - f) * s);
-
-	switch (i % 6) {
-	case 0: r = v, g = t, b = p; break;
-	case 1: r = q, g = v, b = p; break;
-	case 2: r = p, g = v, b = t; break;
-	case 3: r = p, g = q, b = v; break;
-	case 4: r = t, g = p, b = v; break;
-	case 5: r = v, g = p, b = q; break;
+RGBColor hsv2rgb(uint16_t H, uint8_t S, uint8_t V) {
+	//Which sixth of the hue circle it's in (subtracting is quicker than a 16 bit divide)
+	uint8_t sector = 0;
+	while (H >= 60) {
+		H -= 60;
+		sector++;
 	}
+	//How far through the sixth it is, 0-255 (255 / 60 is 17 / 4)
+	uint8_t const f = (static_cast<uint16_t>(H) * 17) >> 2;
+
+	//The products are up to 255 * 255, past a 16 bit int (which the lamps is), so they're done unsigned
+	uint8_t const p = div255(static_cast<uint16_t>(V) * static_cast<uint8_t>(255 - S));
+	uint8_t const q = div255(static_cast<uint16_t>(V) * static_cast<uint8_t>(255 - div255(static_cast<uint16_t>(S) * f)));
+	uint8_t const t = div255(static_cast<uint16_t>(V) * static_cast<uint8_t>(255 - div255(static_cast<uint16_t>(S) * static_cast<uint8_t>(255 - f))));
 
 	RGBColor color;
-	color.r = r * 255;
-	color.g = g * 255;
-	color.b = b * 255;
+	switch (sector) {
+	case 0: color = { V, t, p }; break;
+	case 1: color = { q, V, p }; break;
+	case 2: color = { p, V, t }; break;
+	case 3: color = { p, q, V }; break;
+	case 4: color = { t, p, V }; break;
+	default: color = { V, p, q }; break;
+	}
 
-	return color;
+	return(color);
 }
@@ -0,0 +1,35 @@
+#include "../include/cycles.h"
+
+//Not static, so trace.h can read it from C
+extern "C" {
+	volatile uint16_t cycles_overflows = 0;
+}
+
+#ifndef __INTELLISENSE__
+ISR(TIMER1_OVF_vect) {
+	cycles_overflows++;
+}
+#endif
+
+void cycles::init() {
+	cycles_overflows = 0;
+	TIFR1 = _BV(TOV1);
+	TIMSK1 |= _BV(TOIE1);
+}
+
+uint32_t cycles::now() {
+	uint16_t low;
+	uint16_t high;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		low = TCNT1;
+		high = cycles_overflows;
+		//An overflow that hasn't been counted yet (interrupts are off). If the low half is small, it happened before TCNT1 was read.
+		if ((TIFR1 & _BV(TOV1)) && (low < 0x8000))
+			high++;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	return((static_cast<uint32_t>(high) << 16) | low);
+}
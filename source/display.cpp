@@ -0,0 +1,116 @@
+#include "../include/display.h"
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "../avr_lib_ds18b20_02/src/ds18b20/ds18b20.h"
+
+//The DS1307 counts days 1 (Sunday) to 7
+static char const day_names[7][4] PROGMEM = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+//The widths of line 1: hh:mm:ss, AM/PM (or blank), and the temperature with the space before it (-55.0C to 125.0C,
+//the space dropped when it's 6 characters)
+static constexpr uint8_t time_width = 8;
+static constexpr uint8_t ampm_width = 2;
+static constexpr uint8_t temperature_max = 6;
+static_assert(time_width + ampm_width + temperature_max <= display::columns, "The first line must fit on the display");
+
+void display::format(char text[], IC_DS1307::RegData const &time, bool const temperature_valid, int16_t const temperature, bool const hour_24) {
+	char day_string[4];
+	if ((time.day >= 1) && (time.day <= 7))
+		strcpy_P(day_string, day_names[time.day - 1]);
+	else
+		strcpy(day_string, "---");
+	//The temperature to one decimal place (eg " 21.5C"), or blank if it couldn't be read.
+	//It's spaced from the time only when it's at most 5 characters, so -10.5C and 100.5C still fit.
+	char temp_string[8];
+	temp_string[0] = '\0';
+	if (temperature_valid) {
+		temp_string[0] = ' ';
+		strcpy(ds18b20_tostring(temperature, temp_string + 1, 1), "C");
+		if (strlen(temp_string + 1) > temperature_max - 1)
+			memmove(temp_string, temp_string + 1, temperature_max + 1);
+	}
+	uint8_t hour = time.hour();
+	//Blank in 24 hour, so the line is as long and the AM/PM left on the LCD is written over
+	char const *ampm = "  ";
+	if (!hour_24) {
+		ampm = (hour >= 12) ? "PM" : "AM";
+		hour %= 12;
+		if (hour == 0)
+			hour = 12;
+	}
+	sprintf(text, "%02u:%u%u:%u%u%s%s\n%s %u%u/%u%u/20%u%u",
+		hour, time.minute1, time.minute0,
+		time.second1, time.second0, ampm, temp_string,
+		day_string, time.date1, time.date0, time.month1, time.month0,
+		time.year1, time.year0);
+}
+
+uint8_t const display::big_glyphs[big_glyph_amount][8] PROGMEM = {
+	{ 0x07, 0x0f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f },	//Top left corner
+	{ 0x1f, 0x1f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00 },	//Top bar
+	{ 0x1c, 0x1e, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f },	//Top right corner
+	{ 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x0f, 0x07 },	//Bottom left corner
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x1f, 0x1f },	//Bottom bar
+	{ 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1e, 0x1c },	//Bottom right corner
+	{ 0x1f, 0x1f, 0x1f, 0x00, 0x00, 0x00, 0x1f, 0x1f },	//Top bar with the middle
+	{ 0x1f, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x1f, 0x1f }	//Bottom bar with the middle
+};
+
+display::Part const display::big_parts[big_part_amount] = { { 0, 3 }, { 3, 3 }, { 6, 1 }, { 7, 3 }, { 10, 3 }, { 13, 1 }, { 14, 2 } };
+
+//Each digit (top line, then bottom), as glyph numbers. The HD44780s own full block (0xff) and space fill the rest.
+static constexpr uint8_t full = 0xf0;
+static constexpr uint8_t blank = 0xf1;
+static uint8_t const big_digits[10][2][3] PROGMEM = {
+	{ { 0, 1, 2 }, { 3, 4, 5 } },
+	{ { 1, 2, blank }, { 4, full, 4 } },
+	{ { 6, 6, 2 }, { 3, 7, 7 } },
+	{ { 6, 6, 2 }, { 7, 7, 5 } },
+	{ { 3, 4, 2 }, { blank, blank, full } },
+	{ { full, 6, 6 }, { 7, 7, 5 } },
+	{ { 0, 6, 6 }, { 3, 7, 5 } },
+	{ { 1, 1, 2 }, { blank, blank, full } },
+	{ { 0, 6, 2 }, { 3, 7, 5 } },
+	{ { 0, 6, 2 }, { blank, blank, full } }
+};
+
+//Draws a digit (or blank, past 9) at column
+static void big_digit(display::Screen screen, uint8_t const column, uint8_t const digit) {
+	for (uint8_t line = 0; line < display::lines; line++) {
+		for (uint8_t i = 0; i < 3; i++) {
+			uint8_t const cell = (digit <= 9) ? pgm_read_byte(&big_digits[digit][line][i]) : blank;
+			if (cell == full)
+				screen[line][column + i] = 0xff;
+			else if (cell == blank)
+				screen[line][column + i] = ' ';
+			else
+				screen[line][column + i] = display::big_glyph_code + cell;
+		}
+	}
+}
+
+void display::format_big(Screen screen, IC_DS1307::RegData const &time, bool const hour_24) {
+	uint8_t hour = time.hour();
+	char const *ampm = "  ";
+	if (!hour_24) {
+		ampm = (hour >= 12) ? "PM" : "AM";
+		hour %= 12;
+		if (hour == 0)
+			hour = 12;
+	}
+	//No leading 0 on a 12 hour clock
+	big_digit(screen, big_parts[0].column, ((hour < 10) && !hour_24) ? 0xff : hour / 10);
+	big_digit(screen, big_parts[1].column, hour % 10);
+	big_digit(screen, big_parts[3].column, time.minute1);
+	big_digit(screen, big_parts[4].column, time.minute0);
+	//The colon is the HD44780s middle dot, on both lines
+	screen[0][big_parts[2].column] = 0xa5;
+	screen[1][big_parts[2].column] = 0xa5;
+	screen[0][big_parts[5].column] = ' ';
+	screen[1][big_parts[5].column] = ' ';
+	screen[0][big_parts[6].column] = '0' + time.second1;
+	screen[0][big_parts[6].column + 1] = '0' + time.second0;
+	screen[1][big_parts[6].column] = ampm[0];
+	screen[1][big_parts[6].column + 1] = ampm[1];
+}
@@ -0,0 +1,36 @@
+#include "../include/dsp.h"
+
+int8_t dsp::mean(int8_t const samples[], uint8_t const len) {
+	int16_t sum = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		sum += samples[i];
+	}
+	return(static_cast<int8_t>(sum / len));
+}
+
+uint32_t dsp::goertzel(int8_t const samples[], uint8_t const len, int8_t const offset, int16_t const coeff) {
+	int16_t s1 = 0;
+	int16_t s2 = 0;
+	for (uint8_t i = 0; i < len; i++) {
+		//Halve the input, so a full scale tone at bin 2 still fits in 16 bits
+		int16_t const x = (samples[i] - offset) >> 1;
+		int16_t const s0 = x + static_cast<int16_t>((static_cast<int32_t>(coeff) * s1) >> 14) - s2;
+		s2 = s1;
+		s1 = s0;
+	}
+	int32_t const power = static_cast<int32_t>(s1) * s1 + static_cast<int32_t>(s2) * s2 -
+		static_cast<int32_t>(static_cast<int16_t>((static_cast<int32_t>(coeff) * s1) >> 14)) * s2;
+	return((power < 0) ? 0 : power);
+}
+
+uint8_t dsp::level(uint32_t const power) {
+	if (power == 0)
+		return(0);
+	uint8_t top = 31;
+	while (!(power & (static_cast<uint32_t>(1) << top))) {
+		top--;
+	}
+	//Use the 3 bits below the top bit as the fraction
+	uint8_t const fraction = (top >= 3) ? ((power >> (top - 3)) & 0x07) : ((power << (3 - top)) & 0x07);
+	return((top << 3) | fraction);
+}
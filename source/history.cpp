@@ -0,0 +1,236 @@
+#include "../include/history.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "../include/telemetry.h"
+
+//Sequence (2), samples (1), date (1), minute (2)
+static constexpr uint8_t header_size = 6;
+static constexpr uint8_t field_amount = 5;
+//The most a sample can take: the changed bits, then 3 bytes for each field (a 17 bit zigzag value)
+static constexpr uint8_t sample_max = 1 + (field_amount * 3);
+static_assert(header_size + sample_max + 1 <= history::block_size, "A block must hold at least one sample");
+static_assert(history::block_size <= telemetry::payload_max, "A block must fit in a telemetry frame");
+//Changes of a field smaller than this are stored as none (the field keeps its last value until it's moved this far),
+//so the noise in a steady room doesn't cost a byte or two every sample. Temperature 1/8 C, then light, loops, frames and faults.
+static constexpr uint8_t deadband[field_amount] = { 2, 2, 16, 2, 1 };
+
+static uint8_t EEMEM history_eeprom[history::blocks][history::block_size];
+
+//The block being filled (it has no samples until the first is added), and where the next sample goes
+static uint8_t block[history::block_size];
+static uint8_t block_used = header_size;
+//The fields of the last sample in it
+static int32_t last[field_amount];
+//The sequence it'll be written with, and the slot of the newest block in EEPROM (blocks if there isn't one)
+static uint16_t sequence = 0;
+static uint8_t newest = history::blocks;
+//The next byte of the block to write to EEPROM (block_size once it's written), and the slot it's going in
+static uint8_t spill_index = history::block_size;
+static uint8_t spill_slot = 0;
+//A sample that didn't fit in the block, added to the next once the block is written
+static int32_t held[field_amount];
+static IC_DS1307::RegData held_time;
+static bool holding = false;
+//The oldest slot when the dump started, and whether a full block was being written to EEPROM then
+static uint8_t dump_oldest = 0;
+static bool dump_spilling = false;
+
+//The totals over the interval so far
+static uint16_t elapsed = 0;
+static uint32_t light_sum = 0;
+static uint32_t loops_sum = 0;
+static uint32_t frames_sum = 0;
+//The faults total at the end of the last interval
+static uint16_t faults_last = 0;
+
+static uint8_t crc(uint8_t const p0[]) {
+	uint8_t result = 0;
+	for (uint8_t i = 0; i < history::block_size - 1; i++) {
+		result = _crc_ibutton_update(result, p0[i]);
+	}
+	return(result);
+}
+
+static bool valid(uint8_t const p0[]) {
+	//Blank EEPROM (0xff) has too many samples
+	return((p0[2] != 0) && (p0[2] <= history::block_size - header_size - 1) && (crc(p0) == p0[history::block_size - 1]));
+}
+
+static uint16_t sequence_of(uint8_t const p0[]) {
+	return(p0[0] | (static_cast<uint16_t>(p0[1]) << 8));
+}
+
+//Writes a value as a varint, and returns the position after it
+static uint8_t *put(uint8_t *p0, uint32_t value) {
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		if (value)
+			byte |= 0x80;
+		*p0 = byte;
+		p0++;
+	} while (value);
+	return(p0);
+}
+
+static void add(int32_t const values[field_amount], IC_DS1307::RegData const &time) {
+	if (block[2] == 0) {
+		uint16_t const minute = (static_cast<uint16_t>(time.hour()) * 60) + (time.minute1 * 10) + time.minute0;
+		block[0] = static_cast<uint8_t>(sequence);
+		block[1] = static_cast<uint8_t>(sequence >> 8);
+		block[3] = (time.date1 * 10) + time.date0;
+		block[4] = static_cast<uint8_t>(minute);
+		block[5] = static_cast<uint8_t>(minute >> 8);
+		for (uint8_t i = header_size; i < history::block_size; i++) {
+			block[i] = 0xff;
+		}
+		block_used = header_size;
+		for (uint8_t i = 0; i < field_amount; i++) {
+			last[i] = 0;
+		}
+	}
+	uint8_t encoded[sample_max];
+	uint8_t *p = encoded + 1;
+	encoded[0] = 0;
+	for (uint8_t i = 0; i < field_amount; i++) {
+		int32_t const change = values[i] - last[i];
+		if ((change < deadband[i]) && (change > -deadband[i]))
+			continue;
+		encoded[0] |= _BV(i);
+		//Zigzag, so small changes either way are small values
+		p = put(p, (change < 0) ? (static_cast<uint32_t>(-(change + 1)) << 1) | 1 : static_cast<uint32_t>(change) << 1);
+	}
+	uint8_t const len = p - encoded;
+	//If it doesn't fit, write the block to EEPROM, and start the next with the sample once that's done
+	if (block_used + len > history::block_size - 1) {
+		block[history::block_size - 1] = crc(block);
+		spill_slot = (newest + 1) % history::blocks;
+		spill_index = 0;
+		for (uint8_t i = 0; i < field_amount; i++) {
+			held[i] = values[i];
+		}
+		held_time = time;
+		holding = true;
+		return;
+	}
+	for (uint8_t i = 0; i < len; i++) {
+		block[block_used + i] = encoded[i];
+	}
+	block_used += len;
+	for (uint8_t i = 0; i < field_amount; i++) {
+		if (encoded[0] & _BV(i))
+			last[i] = values[i];
+	}
+	block[2]++;
+}
+
+//Writes the next byte of the block to EEPROM (which must be ready)
+static void spill() {
+	eeprom_update_byte(&history_eeprom[spill_slot][spill_index], block[spill_index]);
+	spill_index++;
+	if (spill_index < history::block_size)
+		return;
+	newest = spill_slot;
+	sequence++;
+	//Empty, so the sample that didn't fit starts a new block
+	block[2] = 0;
+	if (holding) {
+		holding = false;
+		add(held, held_time);
+	}
+}
+
+void history::init() {
+	//Read every slot once for the newest block
+	newest = blocks;
+	uint16_t newest_sequence = 0;
+	for (uint8_t i = 0; i < blocks; i++) {
+		uint8_t buffer[block_size];
+		eeprom_read_block(buffer, history_eeprom[i], block_size);
+		if (!valid(buffer))
+			continue;
+		//Newer even once the sequence wraps (there are never more than blocks blocks apart)
+		if ((newest != blocks) && (static_cast<int16_t>(sequence_of(buffer) - newest_sequence) <= 0))
+			continue;
+		newest = i;
+		newest_sequence = sequence_of(buffer);
+	}
+	sequence = (newest != blocks) ? newest_sequence + 1 : 0;
+	block[2] = 0;
+	spill_index = block_size;
+	holding = false;
+	elapsed = 0;
+	light_sum = 0;
+	loops_sum = 0;
+	frames_sum = 0;
+	faults_last = 0;
+}
+
+void history::second(Sample const &sample, IC_DS1307::RegData const &time) {
+	light_sum += sample.light;
+	loops_sum += sample.loops;
+	frames_sum += sample.frames;
+	elapsed++;
+	//The last block is written in well under an interval, but if it isn't, the interval runs on until update() finishes it
+	if ((elapsed < interval) || (spill_index < block_size))
+		return;
+	int32_t const values[field_amount] = {
+		sample.temperature,
+		static_cast<int32_t>(light_sum / elapsed),
+		static_cast<int32_t>(loops_sum / elapsed),
+		static_cast<int32_t>(frames_sum / elapsed),
+		static_cast<uint16_t>(sample.faults - faults_last)
+	};
+	faults_last = sample.faults;
+	elapsed = 0;
+	light_sum = 0;
+	loops_sum = 0;
+	frames_sum = 0;
+	add(values, time);
+}
+
+void history::update() {
+	if ((spill_index < block_size) && eeprom_is_ready())
+		spill();
+}
+
+bool history::dump(uint8_t const index) {
+	if (index == 0) {
+		dump_oldest = (newest != blocks) ? (newest + 1) % blocks : 0;
+		//A full block being written to EEPROM (by update(), the dump doesn't wait for it) is sent after the slots
+		dump_spilling = spill_index < block_size;
+	}
+	if (index < blocks) {
+		uint8_t const slot = (dump_oldest + index) % blocks;
+		//The slot a full block is going in isn't read, it's half written
+		if (dump_spilling && (slot == spill_slot))
+			return(true);
+		uint8_t buffer[block_size];
+		eeprom_read_block(buffer, history_eeprom[slot], block_size);
+		//Slots not written yet are skipped
+		if (valid(buffer))
+			telemetry::send(telemetry::Type::history, buffer, block_size);
+		return(true);
+	}
+	if (index == blocks) {
+		if (!dump_spilling)
+			return(true);
+		//The full block, from SRAM if it's still being written, or from its slot if it's done
+		if (spill_index < block_size) {
+			telemetry::send(telemetry::Type::history, block, block_size);
+		}
+		else {
+			uint8_t buffer[block_size];
+			eeprom_read_block(buffer, history_eeprom[spill_slot], block_size);
+			if (valid(buffer))
+				telemetry::send(telemetry::Type::history, buffer, block_size);
+		}
+		return(true);
+	}
+	//Then the block being filled (there isn't one until a full block is written)
+	if ((index > blocks + 1) || (spill_index < block_size) || (block[2] == 0))
+		return(false);
+	block[block_size - 1] = crc(block);
+	telemetry::send(telemetry::Type::history, block, block_size);
+	return(true);
+}
@@ -63,7 +63,7 @@ bool twi::recv_packet(uint8_t buffer[], uint8_t const len, bool const nack) {
 	return(false);
 }
 
-bool twi::send_packet(uint8_t buffer[], uint8_t const len) {
+bool twi::send_packet(uint8_t const buffer[], uint8_t const len) {
 	for (uint8_t i = 0; i < len; i++) {
 		TWDR = buffer[i];														//Load TWDR with byte to transmit
 		TWCR |= _BV(TWINT);														//Clear TWINT flag
@@ -87,6 +87,12 @@ bool IC_DS1307::RegData::operator==(RegData const &p0) {
 		(p0.out == out) && (p0.rs == rs) && (p0.sqwe == sqwe));
 }
 
+uint8_t IC_DS1307::RegData::hour() const {
+	if (!hour_12)
+		return((((ampm_hour1 << 1) | hour1) * 10) + hour0);
+	return((((hour1 * 10) + hour0) % 12) + (ampm_hour1 ? 12 : 0));
+}
+
 uint8_t IC_DS1307::update() {
 	return(get_all());
 }
@@ -135,6 +141,38 @@ uint8_t IC_DS1307::set_all() const {
 	return(0);
 }
 
+uint8_t IC_DS1307::set_control() const {
+	uint8_t const raw_data[1] = { static_cast<uint8_t>((regData.out << 7) | (regData.sqwe << 4) | regData.rs) };
+	return(set_raw_data(0x07, raw_data, 1));
+}
+
+uint8_t IC_DS1307::get_nvram(uint8_t const address, uint8_t data[], uint8_t const len) const {
+	if ((address >= nvram_size) || (len > nvram_size - address))
+		return(8);
+	return(get_raw_data(nvram_address + address, data, len));
+}
+
+uint8_t IC_DS1307::update_nvram(uint8_t const address, uint8_t const data[], uint8_t cache[], uint8_t const len) const {
+	if ((address >= nvram_size) || (len > nvram_size - address))
+		return(8);
+	//Find the changed span
+	uint8_t first = 0;
+	while ((first < len) && (data[first] == cache[first])) {
+		first++;
+	}
+	if (first == len)
+		return(0);
+	uint8_t last = len - 1;
+	while (data[last] == cache[last]) {
+		last--;
+	}
+	uint8_t const result = set_raw_data(nvram_address + address + first, data + first, last - first + 1);
+	if (result)
+		return(result);
+	memcpy(cache + first, data + first, last - first + 1);
+	return(0);
+}
+
 IC_DS1307::IC_DS1307() {
 }
 
@@ -142,7 +180,11 @@ IC_DS1307::IC_DS1307(uint8_t const ntwi_address) : twi_address(ntwi_address) {
 }
 
 uint8_t IC_DS1307::get_raw_data(uint8_t data[]) const {
-	uint8_t read_addr[1] = { 0x00 };
+	return(get_raw_data(0x00, data, 8));
+}
+
+uint8_t IC_DS1307::get_raw_data(uint8_t const address, uint8_t data[], uint8_t const len) const {
+	uint8_t read_addr[1] = { address };
 	if (twi::start()) {
 		//Error
 		return(1);
@@ -163,7 +205,7 @@ uint8_t IC_DS1307::get_raw_data(uint8_t data[]) const {
 		//Error
 		return(5);
 	}
-	if (twi::recv_packet(data, 8)) {
+	if (twi::recv_packet(data, len)) {
 		//Error
 		return(6);
 	}
@@ -175,9 +217,11 @@ uint8_t IC_DS1307::get_raw_data(uint8_t data[]) const {
 }
 
 uint8_t IC_DS1307::set_raw_data(uint8_t data[]) const {
-	uint8_t add_addr_data[9];
-	add_addr_data[0] = 0x00;	//Address to start setting in ds1307
-	memcpy(add_addr_data + 1, data, 8);
+	return(set_raw_data(0x00, data, 8));
+}
+
+uint8_t IC_DS1307::set_raw_data(uint8_t const address, uint8_t const data[], uint8_t const len) const {
+	uint8_t const write_addr[1] = { address };	//Address to start setting in ds1307
 	if (twi::start()) {
 		//Error
 		return(1);
@@ -186,7 +230,7 @@ uint8_t IC_DS1307::set_raw_data(uint8_t data[]) const {
 		//Error
 		return(2);
 	}
-	if (twi::send_packet(add_addr_data, 9)) {
+	if (twi::send_packet(write_addr, 1) || twi::send_packet(data, len)) {
 		//Error
 		return(3);
 	}
@@ -0,0 +1,219 @@
+#include "../include/input.h"
+#include "../include/pins.h"
+#include "../include/timer.h"
+#include "../include/trace.h"
+
+//PCINT groups follow the ports: PCINT1 is PORTC (PCMSK1 bit n is PCn), PCINT2 is PORTD
+static_assert(pins::power::port == Port::d, "The power button must be on PORTD, for PCINT2");
+static_assert((pins::input0::port == Port::c) && (pins::input1::port == Port::c), "The generic inputs must be on PORTC, for PCINT1");
+static_assert(input::debounce_ms > 0, "The debounce has to last at least a tick");
+
+struct State {
+	uint8_t debounce;		//Ticks left before the level is taken (0 if it isn't bouncing)
+	bool pressed;			//The debounced level
+	uint16_t held;			//Ticks it's been pressed for (stops counting at the long press)
+	uint16_t repeat;		//Ticks to the next repeat
+};
+
+//Only touched with interrupts off (or from them)
+static State state[input::button_amount];
+static input::Event queue[input::queue_size];
+static uint8_t queue_head = 0;
+static uint8_t queue_length = 0;
+static uint8_t dropped_amount = 0;
+
+//Returns whether a button is down now (not debounced)
+static bool level(uint8_t const p0) {
+	switch (p0) {
+	case 0:
+		return(!pins::power::is_high());
+	case 1:
+		return(!pins::input0::is_high());
+	default:
+		return(!pins::input1::is_high());
+	}
+}
+
+//Turns a buttons pin change interrupt on or off
+static void watch(uint8_t const p0, bool const on) {
+	switch (p0) {
+	case 0:
+		if (on)
+			PCMSK2 |= pins::power::mask;
+		else
+			PCMSK2 &= ~pins::power::mask;
+		break;
+	case 1:
+		if (on)
+			PCMSK1 |= pins::input0::mask;
+		else
+			PCMSK1 &= ~pins::input0::mask;
+		break;
+	default:
+		if (on)
+			PCMSK1 |= pins::input1::mask;
+		else
+			PCMSK1 &= ~pins::input1::mask;
+		break;
+	}
+}
+
+static void push(input::Kind const kind, uint8_t const button) {
+	if (queue_length == input::queue_size) {
+		if (dropped_amount != 0xff)
+			dropped_amount++;
+		return;
+	}
+	queue[(queue_head + queue_length) % input::queue_size] = { kind, static_cast<input::Button>(button) };
+	queue_length++;
+}
+
+static void tick();
+
+//Starts debouncing a button if it's changed, with its interrupt off until it settles
+static void bounce(uint8_t const p0) {
+	if (state[p0].debounce || (level(p0) == state[p0].pressed))
+		return;
+	watch(p0, false);
+	state[p0].debounce = input::debounce_ms;
+	timer::on_tick(tick);
+}
+
+//Runs every tick while a button is bouncing or held
+static void tick() {
+	bool busy = false;
+	for (uint8_t i = 0; i < input::button_amount; i++) {
+		State &button = state[i];
+		if (button.debounce) {
+			button.debounce--;
+			if (!button.debounce) {
+				bool const now = level(i);
+				if (now != button.pressed) {
+					button.pressed = now;
+					button.held = 0;
+					push(now ? input::Kind::press : input::Kind::release, i);
+				}
+				watch(i, true);
+				//It may have changed again before the interrupt was back on
+				bounce(i);
+			}
+		}
+		if (button.pressed && !button.debounce) {
+			if (button.held < input::long_press_ms) {
+				button.held++;
+				if (button.held == input::long_press_ms) {
+					push(input::Kind::long_press, i);
+					button.repeat = input::repeat_ms;
+				}
+			}
+			else {
+				button.repeat--;
+				if (!button.repeat) {
+					push(input::Kind::repeat, i);
+					button.repeat = input::repeat_ms;
+				}
+			}
+		}
+		if (button.debounce || button.pressed)
+			busy = true;
+	}
+	if (!busy)
+		timer::on_tick(nullptr);
+}
+
+#ifndef __INTELLISENSE__
+ISR(PCINT1_vect) {
+	TRACE_BEGIN(TRACE_PCINT);
+	bounce(1);
+	bounce(2);
+	TRACE_END(TRACE_PCINT);
+}
+
+ISR(PCINT2_vect) {
+	TRACE_BEGIN(TRACE_PCINT);
+	bounce(0);
+	TRACE_END(TRACE_PCINT);
+}
+#endif
+
+void input::init() {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		for (uint8_t i = 0; i < button_amount; i++) {
+			state[i] = { 0, level(i), 0, 0 };
+			watch(i, true);
+		}
+		queue_head = 0;
+		queue_length = 0;
+		dropped_amount = 0;
+		PCIFR = _BV(PCIF1) | _BV(PCIF2);
+		PCICR |= _BV(PCIE1) | _BV(PCIE2);
+		//A button held from the start is timed from now
+		if (state[0].pressed || state[1].pressed || state[2].pressed)
+			timer::on_tick(tick);
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+input::Event input::next() {
+	Event result = { Kind::none, Button::power };
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		if (queue_length) {
+			result = queue[queue_head];
+			queue_head = (queue_head + 1) % queue_size;
+			queue_length--;
+		}
+#ifndef __INTELLISENSE__
+	}
+#endif
+	return(result);
+}
+
+bool input::held(Button const p0) {
+	bool result;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		result = state[static_cast<uint8_t>(p0)].pressed;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	return(result);
+}
+
+void input::flush() {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		queue_length = 0;
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+void input::standby(bool const on) {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		if (on) {
+			PCICR &= ~_BV(PCIE1);
+			queue_length = 0;
+		}
+		else {
+			PCIFR = _BV(PCIF1);
+			PCICR |= _BV(PCIE1);
+			bounce(1);
+			bounce(2);
+		}
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+uint8_t input::dropped() {
+	return(dropped_amount);
+}
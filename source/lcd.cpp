@@ -0,0 +1,151 @@
+#include "../include/lcd.h"
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include "../include/pins.h"
+
+using pins::lcd_data0;
+using pins::lcd_data1;
+using pins::lcd_data2;
+using pins::lcd_data3;
+static constexpr uint8_t data_mask = lcd_data0::mask | lcd_data1::mask | lcd_data2::mask | lcd_data3::mask;
+static_assert((lcd_data1::port == lcd_data0::port) && (lcd_data2::port == lcd_data0::port) && (lcd_data3::port == lcd_data0::port),
+	"The display data pins must share a port, to be written at once");
+
+//Spreads a nibble over the data pins
+static constexpr uint8_t scatter(uint8_t const p0) {
+	return(((p0 & 0x01) ? lcd_data0::mask : 0) | ((p0 & 0x02) ? lcd_data1::mask : 0) |
+		((p0 & 0x04) ? lcd_data2::mask : 0) | ((p0 & 0x08) ? lcd_data3::mask : 0));
+}
+
+//Every nibble already spread over the data pins, so putting one out is a single masked write of PORTB
+static constexpr uint8_t nibble_pins[16] PROGMEM = {
+	scatter(0x0), scatter(0x1), scatter(0x2), scatter(0x3), scatter(0x4), scatter(0x5), scatter(0x6), scatter(0x7),
+	scatter(0x8), scatter(0x9), scatter(0xa), scatter(0xb), scatter(0xc), scatter(0xd), scatter(0xe), scatter(0xf)
+};
+
+//Instructions
+static constexpr uint8_t clear_display = 0x01;
+static constexpr uint8_t entry_mode_increment = 0x06;
+static constexpr uint8_t display_power = 0x08;
+static constexpr uint8_t display_on = 0x04;
+static constexpr uint8_t function_set_4bit_2line = 0x28;
+static constexpr uint8_t set_cgram_address = 0x40;
+static constexpr uint8_t set_ddram_address = 0x80;
+//Where each line starts in DDRAM
+static constexpr uint8_t line_address[display::lines] = { 0x00, 0x40 };
+
+//The glyph each CGRAM slot was loaded with (nullptr if it's unknown)
+static uint8_t const *slot_glyph[lcd::glyph_slots] = {};
+
+//Clocks out a nibble (the HD44780 takes it as E falls)
+static void nibble(uint8_t const p0) {
+	//Nothing writes PORTB from an interrupt (the 1-Wire bus is driven with DDRB), so the read and write can't lose a change
+	lcd_data0::output_register() = (lcd_data0::output_register() & ~data_mask) | pgm_read_byte(&nibble_pins[p0]);
+	pins::lcd_enable::high();
+	//E has to be high for at least 230ns
+	_delay_us(0.25);
+	pins::lcd_enable::low();
+}
+
+static void send(uint8_t const p0, bool const rs) {
+	pins::lcd_rs::set(rs);
+	nibble(p0 >> 4);
+	nibble(p0 & 0x0f);
+	//Most instructions (and writes) take 37us
+	_delay_us(40);
+}
+
+void lcd::init() {
+	//Only ever written to
+	pins::lcd_rs::low();
+	pins::lcd_rw::low();
+	pins::lcd_enable::low();
+	//Wait for the display to power up, then put it in 4 bit mode. It might be in either mode, so 8 bit is set 3 times first.
+	_delay_ms(40);
+	nibble(0x3);
+	_delay_ms(5);
+	nibble(0x3);
+	_delay_us(150);
+	nibble(0x3);
+	_delay_us(150);
+	nibble(0x2);
+	_delay_us(40);
+	command(function_set_4bit_2line);
+	power(true);
+	command(entry_mode_increment);
+	clear();
+	//CGRAM isn't cleared at power up
+	forget_glyphs();
+}
+
+void lcd::command(uint8_t const p0) {
+	send(p0, false);
+}
+
+void lcd::write(uint8_t const p0) {
+	send(p0, true);
+}
+
+void lcd::print(char const *p0) {
+	for (; *p0; p0++) {
+		if (*p0 == '\n')
+			move(1, 0);
+		else
+			write(*p0);
+	}
+}
+
+void lcd::move(uint8_t const line, uint8_t const column) {
+	command(set_ddram_address | (line_address[line] + column));
+}
+
+void lcd::clear() {
+	command(clear_display);
+	_delay_ms(2);
+}
+
+void lcd::power(bool const on) {
+	command(display_power | (on ? display_on : 0));
+}
+
+void lcd::load_glyphs(uint8_t const glyphs[][8], uint8_t const first, uint8_t const amount) {
+	for (uint8_t i = 0; (i < amount) && (first + i < glyph_slots); i++) {
+		uint8_t const slot = first + i;
+		if (slot_glyph[slot] == glyphs[i])
+			continue;
+		command(set_cgram_address | (slot << 3));
+		for (uint8_t row = 0; row < 8; row++) {
+			write(pgm_read_byte(&glyphs[i][row]));
+		}
+		slot_glyph[slot] = glyphs[i];
+	}
+}
+
+void lcd::forget_glyphs() {
+	for (uint8_t i = 0; i < glyph_slots; i++) {
+		slot_glyph[i] = nullptr;
+	}
+}
+
+void lcd::draw(display::Screen const screen, display::Screen shown, display::Part const parts[], uint8_t const amount) {
+	for (uint8_t i = 0; i < amount; i++) {
+		display::Part const &part = parts[i];
+		bool changed = false;
+		for (uint8_t line = 0; line < display::lines; line++) {
+			for (uint8_t column = part.column; column < part.column + part.width; column++) {
+				if (screen[line][column] != shown[line][column])
+					changed = true;
+			}
+		}
+		if (!changed)
+			continue;
+		for (uint8_t line = 0; line < display::lines; line++) {
+			move(line, part.column);
+			for (uint8_t column = part.column; column < part.column + part.width; column++) {
+				write(screen[line][column]);
+				shown[line][column] = screen[line][column];
+			}
+		}
+	}
+}
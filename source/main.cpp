@@ -8,23 +8,83 @@
 #include <stdlib.h>
 //Include C standard header string.h
 #include <string.h>
-//Include tedavr ic_hd44780.h
-#include "../tedavr/include/tedavr/ic_hd44780.h"
-//Inclide tedavr button.h
-#include "../tedavr/include/tedavr/button.h"
 //Include ic_ds1307.h
 #include "../include/ic_ds1307.h"
 //Include timer.h
 #include "../include/timer.h"
 //Include colour.h
 #include "../include/colour.h"
-//Include neopixel light_ws2812.h
-#include "../light_ws2812/light_ws2812_AVR/Light_WS2812/light_ws2812.h"
-
+//Include space.h
+#include "../include/space.h"
+//Include audio.h
+#include "../include/audio.h"
+//Include temperature.h
+#include "../include/temperature.h"
+//Include neopixel ws2812.h
+#include "../include/ws2812.h"
+//Include telemetry.h
+#include "../include/telemetry.h"
+//Include profile.h (the PROFILE_ macros do nothing unless built with PROFILE)
+#include "../include/profile.h"
+//Include trace.h (the TRACE_ macros do nothing unless built with TRACE)
+#include "../include/trace.h"
+//Include display.h
+#include "../include/display.h"
+//Include calibrate.h
+#include "../include/calibrate.h"
+//Include settings.h
+#include "../include/settings.h"
+//Include checkpoint.h
+#include "../include/checkpoint.h"
+//Include history.h
+#include "../include/history.h"
+//Include lcd.h (the display)
+#include "../include/lcd.h"
+//Include pins.h (what each pin is used for)
+#include "../include/pins.h"
+//Include input.h (the buttons)
+#include "../include/input.h"
+
+#ifdef TRACE
+//Used to wake the device from sleep mode (and trace it)
+ISR(INT0_vect) {
+	TRACE_EVENT(TRACE_INT0, 0);
+}
+#else
 //An empty ISR used to wake the device from sleep mode
 EMPTY_INTERRUPT(INT0_vect);
+#endif
+
+//The neopixel effects (see settings.h)
+typedef settings::Effect Effect;
+
+//The lamps vertical axis. The hues are spread along it, so neopixels at the same height share a colour.
+constexpr space::Vector led_axis = { 0, 0, space::unit };
+
+//10mm in lamp space
+constexpr int8_t ten_mm = space::fixed(10);
+
+//How sharply the sweep's plane and the pulse's shell fade away from them (see space::plane() and space::shell())
+constexpr uint8_t sweep_shift = 2;
+constexpr uint8_t pulse_shift = 5;
+//The furthest a neopixel can be from the centre (a corner of lamp space), which the pulse grows out to
+constexpr uint8_t pulse_radius_max = 220;
+
+//Spreads the starting hues of the neopixels up the lamp. Increase similarity for less colour variation through the lamp (1 for identical).
+//phase is how many steps the hues have already taken.
+void spread_hues(uint16_t hue[], uint8_t const similarity, uint16_t const phase) {
+	for (uint8_t i = 0; i < space::led_count; i++) {
+		//Increase each LEDs hue slightly relative to the ones below it (by 360 / similarity degrees every 10mm)
+		int32_t const scaled = static_cast<int32_t>(space::dot(i, led_axis)) * 360;
+		int16_t const divisor = static_cast<int16_t>(similarity) * ten_mm;
+		//Rounded down (towards minus infinity) for the LEDs below the centre too
+		int32_t const offset = (scaled >= 0) ? scaled / divisor : -((divisor - 1 - scaled) / divisor);
+		hue[i] = static_cast<uint16_t>((((phase + offset) % 360) + 360) % 360);
+	}
+}
 
 //This function calculates a bitrate value for the TWI. Don't worry about it.
+//It uses floating point, so only call it where it's worked out at compile time (see the float check in the Makefile).
 constexpr uint8_t calculate_twbr(float const scl_freq, float const prescale = 1, float const cpu_freq = F_CPU) {
 	return(static_cast<uint8_t>((cpu_freq / (2 * scl_freq * prescale)) - (8 / prescale)));
 }
@@ -33,23 +93,27 @@ constexpr uint8_t calculate_twbr(float const scl_freq, float const prescale = 1,
 void sfr_init() {
 	//---Inputs/Output Setup---//
 
+	//Every pin is listed in pins.h, which checks at compile time that these settings match them and that no pin is used twice
 	//Set DDRD (2 = power button)
-	DDRD = 0b11111011;
-	//Set DDRB
-	DDRB = 0b11111111;
-	//Set DDRB(4/5 = TWI lines, 2/3 = generic inputs, 1 = neopixel out, 0 = ADC)
-	DDRC = 0b000010;
+	DDRD = pins::direction_d;
+	//Set DDRB (2 = DS18B20 1-wire bus, left released, 1 = DS1307 square wave, see calibrate.h)
+	DDRB = pins::direction_b;
+	//Set DDRC (4/5 = TWI lines, 2/3 = generic inputs, 1 = neopixel out, 0 = ADC)
+	DDRC = pins::direction_c;
 	//Set PORTD (2 = pullup for power)
-	PORTD = 0b00000100;
-	//Set PORTB
-	PORTB = 0;
+	PORTD = pins::pullup_d;
+	//Set PORTB (1 = pullup for the DS1307 square wave, which is open drain)
+	PORTB = pins::pullup_b;
 	//Set PORTC (2/3 = pullup for generic inputs)
-	PORTC = 0b001100;
+	PORTC = pins::pullup_c;
+	//Set the neopixel data pins to outputs (one per strip, from config.h)
+	ws2812::init();
 
 	//---TWI Interface Setup---//
 
-	//Calculte TWBR (a bitrate for the TWI) for 100kHz
-	TWBR = calculate_twbr(100000);
+	//Calculte TWBR (a bitrate for the TWI) for 100kHz. It's constexpr, so it's worked out when compiling.
+	constexpr uint8_t twbr = calculate_twbr(100000);
+	TWBR = twbr;
 	//Enable the TWI
 	twi::enable();
 
@@ -80,6 +144,16 @@ void sfr_init() {
 	TCCR0B |= _BV(CS00);
 	TCCR0B &= ~(_BV(CS02) | _BV(CS01));
 
+	//---Timer1 Setup---//
+
+	//Normal mode, so it free runs from 0 to 0xffff. Things that need precise timing schedule off it using the compare registers.
+	//(compare A times the 1-Wire bit slots, compare B triggers the audio sampling)
+	TCCR1A = 0;
+	//This gives the timer a clock source, with prescale 1
+	TCCR1B = _BV(CS10);
+	//Count its overflows, making a 32 bit cycle counter (used for profiling)
+	cycles::init();
+
 	//---ADC Setup---//
 
 	//This selects the reference voltage to use. We are using AVCC (basically the source volatage)
@@ -106,141 +180,154 @@ int main() {
 	//Initialise special function registers (calls (goes to) the function just above this one)
 	sfr_init();
 
-	//Create an instance of the button class called 'power'. We will use this as the power button.
-	//When referring to it, we will use 'power' in the code.
-	Button power;
-	//Initialise the power button
-	button_defaultSetup(&power);
-	//Power is located on PORTD2
-	power.data_port_p = &PIND;
-	power.data_shift_portBit = 2;
-	//Call the button update function for power
-	button_update(&power);
-
-	//Create an instance of the C++ class IC_HD44780 (the chip that drives the display).This will allow us to interface with the display.
-	//We call our display 'disp', so when we want it we will use 'disp' in the code.
-	IC_HD44780 disp;
-
-	//These tell disp the pin data direction registers for the respective pins. This is so that when it needs to, the MCU can switch them between inputs and outputs.
-	disp.pin.ddr_data0 = &DDRB;
-	disp.pin.ddr_data1 = &DDRB;
-	disp.pin.ddr_data2 = &DDRB;
-	disp.pin.ddr_data3 = &DDRB;
-	
-	//These tell disp the pin input registers for the respective pins. This is so that the MCU can read from the display data pins.
-	disp.pin.port_in_data0 = &PINB;
-	disp.pin.port_in_data1 = &PINB;
-	disp.pin.port_in_data2 = &PINB;
-	disp.pin.port_in_data3 = &PINB;
-
-	//These tell disp the pin output registers for the respective pins. This is so that the MCU can output to the display pins.
-	disp.pin.port_out_data0 = &PORTB;
-	disp.pin.port_out_data1 = &PORTB;
-	disp.pin.port_out_data2 = &PORTB;
-	disp.pin.port_out_data3 = &PORTB;
-	disp.pin.port_out_rs = &PORTD;
-	disp.pin.port_out_rw = &PORTD;
-	disp.pin.port_out_en = &PORTD;
-	
-	//These tell disp the bits that the pins are located on the respective ports. EG data0 in located on PORTD-0, and since we set it to PORTD above we need to set it to 0 here.
-	disp.pin.shift_data0 = 0;
-	disp.pin.shift_data1 = 3;
-	disp.pin.shift_data2 = 4;
-	disp.pin.shift_data3 = 5;
-	disp.pin.shift_rs = 3;
-	disp.pin.shift_en = 7;
-	disp.pin.shift_rw = 4;
-
-	//Note: 'instr' is short for instruction
-	//The scope resolution operator '::' allows us to access the things 'inside' the name on the left.
-	//EG instr::*whatever* allows us to access the things in instr.
-	//So hd::instr::init_4bit means the display (hd) instruction (instr) to initialise to 4-bit mode (init_4bit)
-	//'using namespace *whatever*' allows us to not type the *whatever*.
-	//G 'using namespace hd;' means that instead of typeing hd::instr::init_4bit, we can just type instr::init_4bit.
-	//We use the display by doing 'disp << *what we want*'
-	using namespace hd;
-
-	//Initalise the display to 4bit mode.
-	//This means that we only need 7 IO pins on out MCU, rather than 11
-	disp << instr::init_4bit;
-
-	//This sets the function of the display
-	disp << instr::function_set;
-	//Set display to 4_bit. These needs to be send twice (already did one)
-	//(note the 'function_set::'. This means we are elaborating on the function_set command);
-	disp << function_set::datalength_4;
-	//We want 5x8 character font (allows for more stuff)
-	disp << function_set::font_5x8;
-	//Our display has two lines.
-	disp << function_set::lines_2;
-
-	//Next we do the display power instruction
-	disp << instr::display_power;
-	//Turn display on
-	disp << display_power::display_on;
-	//Turn off cursor (part of display power instruction)
-	disp << display_power::cursor_off;
-	//Turn off cursor blinking (part of display power instruction)
-	disp << display_power::cursorblink_off;
-
-	//We don't have to do things one after the other. We can chain the instructions and values by just adding a '<<'
-	//This is the instruction to set the entry mode, we want it so that the cursor moves right, and we don't want the display to shift with it.
-	disp << instr::entry_mode_set << entry_mode_set::cursormove_right << entry_mode_set::displayshift_disable;
-
-	//Clear the display
-	disp << instr::clear_display;
+	//Set up the display (see lcd.h). It's 4-bit, so we only need 7 IO pins on our MCU, rather than 11.
+	//This turns the display on (with no cursor) and clears it.
+	lcd::init();
 
-	
 	//Create an instance of a DS1307 real-time-clock (the real-time-clock that we are using)
 	//We call it clock, so from now on we will use 'clock' to refer to it.
 	IC_DS1307 clock;
 	
-	//Create a character array that's 4 characters long.
-	char day_string[4];
 	//Create a character array that's (16*2)+2 characters long.
 	//Each line of the display is 16 characters, and we have 2 lines. The +2 for the newline character '\n' and the terminating character '\0'
-	char time_string[(16 * 2) + 2];
+	char time_string[display::text_size];
 
 	IC_DS1307::RegData regData_old;
 
-	//Increase this for decreased colour variation along the neopixel strip (set to 1 for identical)
-	constexpr float led_similarity = 31;
-	//Create an offset stating the hue difference between each neopixel
-	constexpr float led_offset = 360 / led_similarity;
-	//The amount of neopixels on the strip
-	constexpr uint8_t led_amount = 5;
-	//Create an array of cRGB lights (the neopixels).
+	//What the display shows in big digit mode, so only the digits that change are written (it was just cleared)
+	display::Screen screen_shown;
+	memset(screen_shown, ' ', sizeof(screen_shown));
+
+	//Read the checkpoint kept in the DS1307s battery backed RAM (see checkpoint.h).
+	//If there is one, the hues carry on from where they were and the settings don't need looking for in the EEPROM.
+	checkpoint::State resume = {};
+	bool const resumed = checkpoint::restore(clock, resume);
+	//Load the settings (the effect, speed and so on, see settings.h). They can be changed over the UART, and are kept in EEPROM.
+	settings::init(resumed ? &resume.settings : nullptr);
+	//The similarity the hues were spread with, so they can be spread again if it changes
+	uint8_t led_similarity = settings::get().similarity;
+	//The amount of neopixels on the strip (from the layout in layout.h)
+	constexpr uint8_t led_amount = space::led_count;
+	//The effect to show on the neopixels
+	Effect effect = settings::get().effect;
+	//Whether the time is shown as 24 hour
+	bool hour_24 = settings::get().hour_24;
+	//Whether the time is shown in big digits
+	bool big_digits = settings::get().big_digits;
+	//Create an array of cRGB lights (the neopixels). Each strip follows on from the last.
 	cRGB led[led_amount];
-	//Create an array of floating point values, representing the hue of each neopixel
-	float hue[led_amount];
-	for (uint8_t i = 0; i < led_amount; i++) {
-		//Increase each LEDs hue slightly relative to the next
-		hue[i] = static_cast<size_t>(i * led_offset) % 360;
-	}
-	//Create a brightness float that will be used throughout the program for brightness
-	float brightness = 0;
-	//Create a brightness float that will be used for determining of there was a difference in the brightness
-	float brightness_old = 0;
+	//The amount of neopixels on each strip
+	constexpr uint8_t led_strip_length = led_amount / ws2812::strips;
+	static_assert(led_strip_length * ws2812::strips == led_amount, "Every strip needs the same amount of neopixels");
+	//Create a buffer for the bit planes. This lets every strip be sent at the same time.
+	uint8_t led_plane[ws2812::plane_size(led_strip_length)];
+	//Create an array of hues (in degrees, 0-359), one for each neopixel
+	uint16_t hue[led_amount];
+	//How many steps the hues have taken (0-359), so the checkpoint can put them back
+	uint16_t hue_phase = resume.hue_phase;
+	spread_hues(hue, led_similarity, hue_phase);
+	//Create a brightness (0-255) that will be used throughout the program for brightness
+	uint8_t brightness = 0;
+	//Create a brightness that will be used for determining of there was a difference in the brightness
+	uint8_t brightness_old = 0;
 	
 	//Initialise the timeout timer functions
 	//The 0.001 is the 'interval' parameter, which determines how many seconds it should take for a single 'tick' to elapse in timers.
 	//In this case we set it to 0.001 seconds, or 1ms. Therefore a tick is 1ms.
-	timer::init(0.001);
+	//The timer settings are worked out from it when compiling (it's constexpr), so there's no floating point maths on the lamp.
+	constexpr timer::Tick tick_length = timer::determine_tick(0.001);
+	timer::init(tick_length);
+
+	//Start reading the buttons (the power button, and the generic inputs on PC2 and PC3, see input.h).
+	//They're read by pin change interrupts and debounced by the timer tick, so the main loop only has to take the events.
+	input::init();
 
 	//Create a timeout timer to use for the neopizels colour change speed
 	Timer neopixel_timer;
-	//Set it to timeout in 1 tick, or 1ms.
-	neopixel_timer = 1;
+	//Set it to timeout in the speed setting (1 tick, or 1ms, unless it's been changed)
+	neopixel_timer = settings::get().speed;
 	//Start the timer
 	neopixel_timer.start();
+
+	//Create a timeout timer for saving the checkpoint
+	Timer checkpoint_timer;
+	checkpoint_timer = checkpoint::interval;
+	checkpoint_timer.start();
+
+	//Start reading the temperature sensors (this needs the timers). The first one found is shown on the display.
+	temperature::init();
+
+	//Find where the status history left off in EEPROM (see history.h). Telemetry adds a sample to it every second.
+	history::init();
+	//Start sending the lamps status over the UART (see tools/telemetry.py)
+	telemetry::init();
+
+	//Apply the tick trim stored by the last calibration (see calibrate.h)
+	calibrate::init();
+
+	//The reactive effect needs the audio input sampled
+	if (effect == Effect::reactive)
+		audio::start();
 	
 	//The main program loop
 	while (true) {
-		//---Power button---//
-		//Update the state of the power button
-		button_update(&power);
+		//Count the loop (for the telemetry loop rate)
+		telemetry::loop();
+		//Time the whole loop
+		PROFILE_LAP(loop);
+		TRACE_EVENT(TRACE_LOOP, 0);
+
+		//---Settings---//
+
+		//Write any changed settings to EEPROM (a byte at a time, once they've stopped changing)
+		settings::update();
+		//If the effect has been changed, start or stop sampling the audio input to suit it
+		if (settings::get().effect != effect) {
+			effect = settings::get().effect;
+			if (effect == Effect::reactive)
+				audio::start();
+			else
+				audio::stop();
+		}
+		//If the similarity has been changed, spread the hues again
+		if (settings::get().similarity != led_similarity) {
+			led_similarity = settings::get().similarity;
+			spread_hues(hue, led_similarity, hue_phase);
+		}
+		//If 12/24 hour has been changed, set the years 1s digit to zero, forcing a display update
+		if (settings::get().hour_24 != hour_24) {
+			hour_24 = settings::get().hour_24;
+			regData_old.year1 = 0;
+		}
+		//If big digits have been turned on or off, clear the display and force a display update
+		if (settings::get().big_digits != big_digits) {
+			big_digits = settings::get().big_digits;
+			lcd::clear();
+			memset(screen_shown, ' ', sizeof(screen_shown));
+			regData_old.year1 = 0;
+		}
+
+		//---Checkpoint---//
+
+		//Save the checkpoint every so often (only what has changed since the last save is written)
+		if (checkpoint_timer) {
+			checkpoint::save(clock, { hue_phase, settings::location() });
+			checkpoint_timer.reset();
+			checkpoint_timer = checkpoint::interval;
+			checkpoint_timer.start();
+		}
+
+		//---Buttons---//
+		//Take the next button event. The generic inputs (and long presses and repeats) have nothing to do yet, so only
+		//the power button being let go is acted on.
+		PROFILE_BEGIN(button);
+		input::Event const event = input::next();
+		PROFILE_END(button);
 		//If somebody has pushed and released the power button
-		if (power.flag_state_released) {
+		if ((event.kind == input::Kind::release) && (event.button == input::Button::power)) {
+			//Stop sampling the audio input
+			if (effect == Effect::reactive)
+				audio::stop();
 			//Disable global interrupts
 			cli();
 			//Set display brightness to zero
@@ -253,12 +340,19 @@ int main() {
 				led[i].g = 0;
 				led[i].b = 0;
 			}
-			//Set the neopixels
-			ws2812_setleds(led, led_amount);
+			//Set the neopixels (the planes are built first, so interrupts are only off for the send)
+			ws2812::transpose(led, led_strip_length, led_plane);
+			cli();
+			ws2812::setleds(led, led_strip_length, led_plane);
+			sei();
 			//Turn off the display
-			disp << instr::display_power << display_power::display_off << display_power::cursorblink_off << display_power::cursor_off;
+			lcd::power(false);
+			//Save the checkpoint, so if the power goes while it's asleep the hues carry on from here
+			checkpoint::save(clock, { hue_phase, settings::location() });
 			//Disable the TWI (need to do this for some reason, or it wont work on wake)
 			twi::disable();
+			//Stop the generic inputs waking it (their pin change interrupts would)
+			input::standby(true);
 			//Enable external interrupt 0 (connected to power button, used to wake device from sleep)
 			EIMSK |= _BV(INT0);
 			//Set the sleep mode to power down
@@ -273,21 +367,30 @@ int main() {
 			
 			//Disable global interrupts
 			cli();
-			//Disable sleep mode
-			sleep_disable();
 			//Disable external interrupt 0
 			EIMSK &= ~_BV(INT0);
 			//Enable the TWI
 			twi::enable();
 
-			//Wait for the power button to be released
+			//Wait for the power button to be released, so letting go of it doesn't turn the lamp straight back off.
+			//The button is read by interrupts, so sleep between them (idle, so the timer tick keeps running).
+			set_sleep_mode(SLEEP_MODE_IDLE);
+			//Enable global interrupts
+			sei();
 			while (true) {
-				button_update(&power);
-				if (power.flag_state_released)
+				input::Event const wake_event = input::next();
+				if ((wake_event.kind == input::Kind::release) && (wake_event.button == input::Button::power))
 					break;
+				if (wake_event.kind == input::Kind::none)
+					sleep_cpu();
 			}
+			//Disable sleep mode
+			sleep_disable();
+			//Let the generic inputs back on (and drop the events from waking up)
+			input::standby(false);
+			input::flush();
 			//Tuwn on the display
-			disp << instr::display_power << display_power::display_on << display_power::cursorblink_off << display_power::cursor_off;
+			lcd::power(true);
 
 			//Set the display brightness to the brightness value
 			OCR0A = brightness;
@@ -295,54 +398,101 @@ int main() {
 			OCR0B = brightness;
 			//Set the years 1s digit to zero, forcing a display update
 			regData_old.year1 = 0;
-			//Enable global interrupts
-			sei();
+			//Start sampling the audio input again
+			if (effect == Effect::reactive)
+				audio::start();
 		}
 
 		//---Brightness---//
 		
-		//Start ADC conversion
-		ADCSRA |= _BV(ADSC);
-		//Wait for ADC conversion to finish
-		while (!(ADCSRA & _BV(ADIF)));
-		//Copy the result into brightness (the float we created earlier)
-		brightness = ADCH;
+		PROFILE_BEGIN(light);
+		if (effect == Effect::reactive) {
+			//The ADC is busy sampling the audio input, so use the light level it reads in between
+			brightness = audio::light();
+		}
+		else {
+			//Start ADC conversion
+			ADCSRA |= _BV(ADSC);
+			//Wait for ADC conversion to finish
+			while (!(ADCSRA & _BV(ADIF)));
+			//Copy the result into brightness (the value we created earlier)
+			brightness = ADCH;
+		}
+		//Dim it more in the dark if the brightness curve is set to square
+		if (settings::get().curve == settings::Curve::square)
+			brightness = (static_cast<uint16_t>(brightness) * brightness) / 255;
 		//Set the display brightness
 		OCR0A = brightness;
 		//Set the power button brightness
 		OCR0B = brightness;
-		//Change the brightness from 0-255 to 0-100. (used with the neopixels)
-		brightness = (brightness / 255) * 100;
+		PROFILE_END(light);
 
 		//Store whether the timer has elapsed in a bool.
 		//This is becuase a change during the next segment could desync the neopixels.
 		bool timer_elapsed = neopixel_timer;
-		//If there has been a change in brightness or the timer has elapsed
-		if ((brightness != brightness_old) || timer_elapsed) {
+		//Process the next block of audio (if there is one). This is true if the audio band levels changed.
+		bool bands_updated = (effect == Effect::reactive) && audio::update();
+		//If there has been a change in brightness, the timer has elapsed or the audio has changed
+		if ((brightness != brightness_old) || timer_elapsed || bands_updated) {
+			PROFILE_BEGIN(colour);
+			//Where the sweep's plane and the pulse's shell are, moved on with the hues
+			space::Plane const sweep_plane = { led_axis, space::sweep(hue_phase, 359), sweep_shift };
+			space::Sphere pulse_sphere;
+			if (effect == Effect::pulse)
+				pulse_sphere = space::sphere({ 0, 0, 0 }, space::pulse(hue_phase, 359, pulse_radius_max), pulse_shift);
 			for (uint8_t i = 0; i < led_amount; i++) {
-				//Convert HSV to RGB
-				RGBColor x = hsv2rgb(hue[i], 100, brightness);
+				uint16_t led_hue = hue[i];
+				uint8_t led_value = brightness;
+				if (effect == Effect::reactive) {
+					//Each neopixel follows one of the audio bands. Louder makes it brighter, and shifts its hue.
+					uint8_t band = audio::band(i % audio::band_amount);
+					led_value = (static_cast<uint16_t>(led_value) * band) / 255;
+					led_hue += band / 4;
+					if (led_hue >= 360)
+						led_hue -= 360;
+				}
+				else if (effect == Effect::sweep) {
+					led_value = (static_cast<uint16_t>(led_value) * space::plane(i, sweep_plane)) / 255;
+				}
+				else if (effect == Effect::pulse) {
+					led_value = (static_cast<uint16_t>(led_value) * space::shell(i, pulse_sphere)) / 255;
+				}
+				//Convert HSV to RGB (fully saturated)
+				RGBColor x = hsv2rgb(led_hue, 255, led_value);
 				//Copy over the data
 				led[i].r = x.r;
 				led[i].g = x.g;
 				led[i].b = x.b;
 				//If the timer has elapsed (indicating a need to change the neopixels)
-				if(timer_elapsed)
+				if (timer_elapsed) {
 					//Change the neopixels colour values
 					hue[i]++;
-				hue[i] = static_cast<size_t>(hue[i]) % 360;
+					if (hue[i] == 360)
+						hue[i] = 0;
+				}
 			}
+			PROFILE_END(colour);
+			PROFILE_BEGIN(leds);
+			//Build the bit planes while interrupts are still on, so they're only off for the timed send
+			ws2812::transpose(led, led_strip_length, led_plane);
 			//Disable global interrupts
 			cli();
+			TRACE_BEGIN(TRACE_LEDS);
 			//Set the neopixels
-			ws2812_setleds(led, led_amount);
+			ws2812::setleds(led, led_strip_length, led_plane);
+			TRACE_END(TRACE_LEDS);
 			//Enable global interrupts
 			sei();
+			PROFILE_END(leds);
+			//Count the frame (for the telemetry frame rate)
+			telemetry::frame();
 			if (timer_elapsed) {
+				//Count the step
+				hue_phase = (hue_phase + 1) % 360;
 				//Reset the timer
 				neopixel_timer.reset();
-				//Set the timer to 1ms
-				neopixel_timer = 1;
+				//Set the timer to the speed setting
+				neopixel_timer = settings::get().speed;
 				//Start the timer
 				neopixel_timer.start();
 			}
@@ -350,10 +500,32 @@ int main() {
 		//Copy over the brightness value for next loop comparison
 		brightness_old = brightness;
 
+		//---Temperature---//
+
+		//Start a conversion, or read it once it has had time to finish. This never waits for the sensor.
+		PROFILE_BEGIN(temperature);
+		temperature::update();
+		PROFILE_END(temperature);
+
 		//---Clock---//
 
 		//Update the clock
+		PROFILE_BEGIN(clock);
+		TRACE_BEGIN(TRACE_TWI);
 		clock.get_all();
+		TRACE_END(TRACE_TWI);
+		PROFILE_END(clock);
+
+		//---Telemetry---//
+
+		//Send a status frame if it's time (OCR0A holds the light level)
+		telemetry::update(OCR0A, clock.regData);
+		//Write a full block of the history to EEPROM (a byte at a time)
+		history::update();
+		//Finish a tick calibration, once it has counted long enough (the telemetry 'c' command starts one)
+		calibrate::update();
+
+		//---Clock display---//
 
 		//If the clock has remained the same since the last loop
 		if (clock.regData == regData_old)
@@ -361,40 +533,23 @@ int main() {
 			continue;
 		//If there has been a time difference, copy the new time into the old time
 		regData_old = clock.regData;
-
-		//Determine the day string
-		switch (clock.regData.day) {
-		case(1):
-			strcpy(day_string, "Sun");
-			break;
-		case(2):
-			strcpy(day_string, "Mon");
-			break;
-		case(3):
-			strcpy(day_string, "Tue");
-			break;
-		case(4):
-			strcpy(day_string, "Wed");
-			break;
-		case(5):
-			strcpy(day_string, "Thu");
-			break;
-		case(6):
-			strcpy(day_string, "Fri");
-			break;
-		case(7):
-			strcpy(day_string, "Sat");
-			break;
-		default:
-			break;
+		PROFILE_BEGIN(display);
+
+		if (big_digits) {
+			//Load the glyphs the big digits are built from into the display (this does nothing once they're there)
+			lcd::load_glyphs(display::big_glyphs, 0, display::big_glyph_amount);
+			//Draw the time in big digits, and write only the digits (and seconds) that have changed
+			display::Screen screen;
+			display::format_big(screen, clock.regData, hour_24);
+			lcd::draw(screen, screen_shown, display::big_parts, display::big_part_amount);
+		}
+		else {
+			//Print the time, temperature and date into the 'time_string' character array (see display.h for the layout)
+			display::format(time_string, clock.regData, temperature::valid(), temperature::get(), hour_24);
+			//Display the time string from the start of the display
+			lcd::move(0, 0);
+			lcd::print(time_string);
 		}
-		//Print the time string into the 'time_string' character array (Google printf for details).
-		sprintf(time_string, "%u%u:%u%u:%u%u%s\n%s %u%u/%u%u/20%u%u",
-			clock.regData.hour1, clock.regData.hour0, clock.regData.minute1, clock.regData.minute0,
-			clock.regData.second1, clock.regData.second0, clock.regData.ampm_hour1 ? "PM" : "AM",
-			day_string, clock.regData.date1, clock.regData.date0, clock.regData.month1, clock.regData.month0,
-			clock.regData.year1, clock.regData.year0);
-		//Display the time string (return_home will set the position to the start of the display)
-		disp << instr::return_home << time_string;
+		PROFILE_END(display);
 	}
 }
@@ -0,0 +1,86 @@
+#include "../include/memory.h"
+#include "../include/telemetry.h"
+
+#ifndef HOST
+//Set by the linker and malloc()
+extern "C" {
+	extern uint8_t __data_start;
+	extern uint8_t __data_end;
+	extern uint8_t __bss_start;
+	extern uint8_t __bss_end;
+	extern uint8_t __heap_start;
+	extern char *__brkval;
+}
+#endif
+
+static memory::Usage memory_usage = {};
+
+#ifndef HOST
+//Paints everything above .bss (where the heap and stack will be) before main() runs.
+//It's in .init1, before the stack is set up or r1 is cleared, so it's written without either.
+extern "C" void memory_paint() __attribute__((naked, used, section(".init1")));
+extern "C" void memory_paint() {
+#ifndef __INTELLISENSE__
+	asm volatile(
+		"	ldi r30, lo8(__heap_start)\n"
+		"	ldi r31, hi8(__heap_start)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(%1)\n"
+		"	rjmp 2f\n"
+		"1:	st Z+, r24\n"
+		"2:	cpi r30, lo8(%1)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		"	breq 1b\n"
+		:
+		: "i" (memory::paint), "i" (RAMEND)
+	);
+#endif
+}
+#endif
+
+memory::Usage const &memory::update() {
+#ifdef HOST
+	//There's no SRAM layout to scan on the host, so it's all reported free
+	memory_usage.free_min = RAMEND + 1 - RAMSTART;
+#else
+	uint8_t const *const heap_end = __brkval ? reinterpret_cast<uint8_t const *>(__brkval) : &__heap_start;
+	uint8_t const *const stack = reinterpret_cast<uint8_t const *>(SP);
+	//The deepest the stack has been is just above the last painted byte
+	uint8_t const *p = heap_end;
+	while ((p < stack) && (*p == paint)) {
+		p++;
+	}
+	memory_usage.data = &__data_end - &__data_start;
+	memory_usage.bss = &__bss_end - &__bss_start;
+	memory_usage.heap = heap_end - &__heap_start;
+	memory_usage.stack = RAMEND - SP;
+	memory_usage.stack_max = RAMEND + 1 - static_cast<uint16_t>(reinterpret_cast<uintptr_t>(p));
+	memory_usage.free_min = p - heap_end;
+#endif
+	return(memory_usage);
+}
+
+memory::Usage const &memory::usage() {
+	return(memory_usage);
+}
+
+bool memory::low() {
+	return(memory_usage.free_min < warning);
+}
+
+bool memory::dump(uint8_t const index) {
+	if (index)
+		return(false);
+	uint16_t const values[] = {
+		RAMEND + 1 - RAMSTART, memory_usage.data, memory_usage.bss, memory_usage.heap,
+		memory_usage.stack, memory_usage.stack_max, memory_usage.free_min, warning
+	};
+	uint8_t payload[sizeof(values)];
+	for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		payload[i * 2] = static_cast<uint8_t>(values[i]);
+		payload[(i * 2) + 1] = static_cast<uint8_t>(values[i] >> 8);
+	}
+	telemetry::send(telemetry::Type::memory, payload, sizeof(payload));
+	return(true);
+}
@@ -0,0 +1,243 @@
+#include "../include/onewire.h"
+#include <util/delay.h>
+#include "../include/trace.h"
+#include "../include/pins.h"
+
+typedef pins::onewire bus;
+static_assert(bus::bit == DS18B20_DQ, "The 1-Wire pin must match the DS18B20 librarys");
+
+//Converts microseconds to Timer1 cycles
+static constexpr uint16_t us(uint16_t const p0) {
+	return(static_cast<uint16_t>(F_CPU / 1000000 * p0));
+}
+static_assert(F_CPU / 1000000 * 480 < 0x10000, "A reset must fit in one Timer1 period");
+
+//Slot timings (standard speed)
+static constexpr uint16_t reset_low = us(480);
+static constexpr uint16_t reset_sample = us(70);
+static constexpr uint16_t reset_recovery = us(410);
+static constexpr uint16_t zero_low = us(60);
+static constexpr uint16_t zero_recovery = us(10);
+static constexpr uint16_t one_recovery = us(64);
+static constexpr uint16_t read_recovery = us(55);
+//How late the interrupt can be before the end of a 0 (which becomes a reset after 480us) or the presence check is missed
+static constexpr uint16_t zero_late = us(60);
+static constexpr uint16_t sample_late = us(30);
+
+enum class Kind : uint8_t {
+	reset,
+	write,
+	read
+};
+
+struct Op {
+	Kind kind;
+	uint8_t value;		//The byte to write, or the amount of bytes left to read
+};
+
+//What the next interrupt does
+enum class Phase : uint8_t {
+	slot,				//Start the next slot (or finish)
+	reset_release,
+	reset_sample,
+	zero_release
+};
+
+static Op queue[onewire::queue_size];
+static uint8_t queue_length = 0;
+static uint8_t receive_buffer[onewire::receive_size];
+static uint8_t receive_length = 0;
+static volatile onewire::Status status_value = onewire::Status::idle;
+
+//Only used by the ISR while a transaction is running
+static uint8_t op_index;
+static uint8_t bit_mask;
+static uint8_t byte_value;
+static Phase phase;
+
+static inline void bus_low() {
+	bus::output();
+}
+static inline void bus_release() {
+	bus::input();
+}
+
+//Sets the next interrupt, cycles from now
+static inline void schedule(Phase const next, uint16_t const cycles) {
+	phase = next;
+	OCR1A = TCNT1 + cycles;
+}
+
+//Returns whether this interrupt ran more than limit cycles after it was due
+static inline bool late(uint16_t const limit) {
+	return(static_cast<uint16_t>(TCNT1 - OCR1A) > limit);
+}
+
+static void finish(onewire::Status const p0) {
+	bus_release();
+	TIMSK1 &= ~_BV(OCIE1A);
+	status_value = p0;
+}
+
+//Starts the next slot of the current operation
+static void slot() {
+	if (op_index == queue_length) {
+		finish(onewire::Status::done);
+		return;
+	}
+	Op &op = queue[op_index];
+	switch (op.kind) {
+	case Kind::reset:
+		bus_low();
+		schedule(Phase::reset_release, reset_low);
+		op_index++;
+		break;
+	case Kind::write:
+		if (!bit_mask) {
+			bit_mask = 0x01;
+			byte_value = op.value;
+		}
+		bus_low();
+		if (byte_value & bit_mask) {
+			_delay_us(6);
+			bus_release();
+			schedule(Phase::slot, one_recovery);
+		} else {
+			schedule(Phase::zero_release, zero_low);
+		}
+		bit_mask <<= 1;
+		if (!bit_mask)
+			op_index++;
+		break;
+	case Kind::read:
+		if (!bit_mask) {
+			bit_mask = 0x01;
+			byte_value = 0;
+		}
+		//The sensor holds the bus low for a 0, which must be sampled within 15us of the start of the slot
+		bus_low();
+		_delay_us(1);
+		bus_release();
+		_delay_us(10);
+		if (bus::is_high())
+			byte_value |= bit_mask;
+		bit_mask <<= 1;
+		if (!bit_mask) {
+			if (receive_length < onewire::receive_size) {
+				receive_buffer[receive_length] = byte_value;
+				receive_length++;
+			}
+			op.value--;
+			if (!op.value)
+				op_index++;
+		}
+		schedule(Phase::slot, read_recovery);
+		break;
+	}
+}
+
+#ifndef __INTELLISENSE__
+ISR(TIMER1_COMPA_vect) {
+	TRACE_BEGIN(TRACE_ONEWIRE);
+	switch (phase) {
+	case Phase::slot:
+		slot();
+		break;
+	case Phase::reset_release:
+		//A longer reset does no harm
+		bus_release();
+		schedule(Phase::reset_sample, reset_sample);
+		break;
+	case Phase::reset_sample:
+		if (late(sample_late)) {
+			finish(onewire::Status::late);
+		} else if (bus::is_high()) {
+			finish(onewire::Status::no_presence);
+		} else {
+			schedule(Phase::slot, reset_recovery);
+		}
+		break;
+	case Phase::zero_release:
+		bus_release();
+		if (late(zero_late))
+			finish(onewire::Status::late);
+		else
+			schedule(Phase::slot, zero_recovery);
+		break;
+	}
+	TRACE_END(TRACE_ONEWIRE);
+}
+#endif
+
+void onewire::init() {
+	//The bus is only ever driven low (by making the pin an output), the pull up resistor takes it high
+	bus::low();
+	bus_release();
+	TIMSK1 &= ~_BV(OCIE1A);
+	status_value = Status::idle;
+}
+
+bool onewire::begin() {
+	if (busy())
+		return(false);
+	queue_length = 0;
+	return(true);
+}
+
+void onewire::reset() {
+	if (queue_length < queue_size) {
+		queue[queue_length] = { Kind::reset, 0 };
+		queue_length++;
+	}
+}
+
+void onewire::write(uint8_t const byte) {
+	if (queue_length < queue_size) {
+		queue[queue_length] = { Kind::write, byte };
+		queue_length++;
+	}
+}
+
+void onewire::write(uint8_t const bytes[], uint8_t const len) {
+	for (uint8_t i = 0; i < len; i++) {
+		write(bytes[i]);
+	}
+}
+
+void onewire::read(uint8_t const len) {
+	if ((queue_length < queue_size) && len) {
+		queue[queue_length] = { Kind::read, len };
+		queue_length++;
+	}
+}
+
+void onewire::start() {
+	if (busy())
+		return;
+	op_index = 0;
+	bit_mask = 0;
+	receive_length = 0;
+	status_value = Status::busy;
+	//Run the first slot as soon as possible
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		schedule(Phase::slot, us(2));
+		TIFR1 = _BV(OCF1A);
+		TIMSK1 |= _BV(OCIE1A);
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+onewire::Status onewire::status() {
+	return(status_value);
+}
+
+bool onewire::busy() {
+	return(status_value == Status::busy);
+}
+
+uint8_t const *onewire::received() {
+	return(receive_buffer);
+}
@@ -0,0 +1,92 @@
+#include "../include/profile.h"
+
+#ifdef PROFILE
+
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "../include/telemetry.h"
+
+#define PROFILE_NAME(name) #name,
+static char const names[][profile::name_size] PROGMEM = {
+	PROFILE_STAGES(PROFILE_NAME)
+};
+#undef PROFILE_NAME
+
+static profile::Stats stats[static_cast<uint8_t>(profile::Stage::amount)];
+static uint32_t lap_start[static_cast<uint8_t>(profile::Stage::amount)];
+
+//Returns the histogram bin of a time
+static uint8_t bin(uint32_t time) {
+	uint8_t index = 0;
+	time >>= 8;
+	while (time && (index < profile::bins - 1)) {
+		time >>= 2;
+		index++;
+	}
+	return(index);
+}
+
+void profile::record(Stage const stage, uint32_t const time) {
+	Stats &p0 = stats[static_cast<uint8_t>(stage)];
+	//Halve everything rather than overflow, so the average and histogram follow recent times
+	if ((p0.count == 0xffff) || (p0.sum + time < p0.sum)) {
+		p0.count >>= 1;
+		p0.sum >>= 1;
+		for (uint8_t i = 0; i < bins; i++) {
+			p0.histogram[i] >>= 1;
+		}
+	}
+	if (!p0.count && !p0.max)
+		p0.min = time;
+	p0.count++;
+	p0.sum += time;
+	if (time < p0.min)
+		p0.min = time;
+	if (time > p0.max)
+		p0.max = time;
+	p0.histogram[bin(time)]++;
+}
+
+void profile::lap(Stage const stage) {
+	uint32_t const now = cycles::now();
+	uint32_t &start = lap_start[static_cast<uint8_t>(stage)];
+	if (start)
+		record(stage, now - start);
+	start = now;
+}
+
+void profile::reset() {
+	memset(stats, 0, sizeof(stats));
+	memset(lap_start, 0, sizeof(lap_start));
+}
+
+//Writes a value into a buffer (little endian), and returns the position after it
+static uint8_t *put(uint8_t *p0, uint32_t const value, uint8_t const size) {
+	for (uint8_t i = 0; i < size; i++) {
+		p0[i] = static_cast<uint8_t>(value >> (i * 8));
+	}
+	return(p0 + size);
+}
+
+bool profile::dump(uint8_t const index) {
+	if (index >= static_cast<uint8_t>(Stage::amount))
+		return(false);
+	Stats const &p0 = stats[index];
+	uint8_t payload[1 + 2 + 4 + 4 + 4 + (bins * 2) + name_size];
+	uint8_t *p = payload;
+	p = put(p, index, 1);
+	p = put(p, p0.count, 2);
+	p = put(p, p0.min, 4);
+	p = put(p, p0.max, 4);
+	p = put(p, p0.count ? (p0.sum / p0.count) : 0, 4);
+	for (uint8_t i = 0; i < bins; i++) {
+		p = put(p, p0.histogram[i], 2);
+	}
+	uint8_t const name_len = strlen_P(names[index]);
+	memcpy_P(p, names[index], name_len);
+	p += name_len;
+	telemetry::send(telemetry::Type::profile, payload, p - payload);
+	return(true);
+}
+
+#endif
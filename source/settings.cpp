@@ -0,0 +1,259 @@
+#include "../include/settings.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "../include/timer.h"
+#include "../include/telemetry.h"
+
+//Sequence (2) and length (1)
+static constexpr uint8_t header_size = 3;
+//The bytes the values take (see encode())
+static constexpr uint8_t values_size = 7;
+static_assert(header_size + values_size + 1 <= settings::slot_size, "The values must fit in a slot (see slot_size)");
+
+static uint8_t EEMEM log_eeprom[settings::slots][settings::slot_size];
+
+static settings::Values values;
+//The newest record, and its slot (the first record goes in slot 0)
+static uint16_t sequence = 0;
+static uint8_t slot = settings::slots - 1;
+//Its CRC
+static uint8_t digest = 0;
+//Whether the values have changed since the newest record
+static bool changed = false;
+//The record being written, and the next byte of it to write (slot_size once it's done)
+static uint8_t record[settings::slot_size];
+static uint8_t record_slot = 0;
+static uint8_t record_index = settings::slot_size;
+
+//Counts down write_delay from the last change
+static Timer settle;
+
+static uint8_t crc(uint8_t const p0[]) {
+	uint8_t result = 0;
+	for (uint8_t i = 0; i < settings::slot_size - 1; i++) {
+		result = _crc_ibutton_update(result, p0[i]);
+	}
+	return(result);
+}
+
+//Returns whether a value is in range for its field
+static bool valid(settings::Field const field, uint16_t const value) {
+	switch (field) {
+	case settings::Field::similarity:
+		return((value >= 1) && (value <= 0xff));
+	case settings::Field::speed:
+		return((value >= 1) && (value <= 60000));
+	case settings::Field::effect:
+		return(value <= static_cast<uint8_t>(settings::Effect::pulse));
+	case settings::Field::hour_24:
+	case settings::Field::big_digits:
+		return(value <= 1);
+	case settings::Field::curve:
+		return(value <= static_cast<uint8_t>(settings::Curve::square));
+	default:
+		return(false);
+	}
+}
+
+//Stores a value that's already been checked
+static void store(settings::Field const field, uint16_t const value) {
+	switch (field) {
+	case settings::Field::similarity:
+		values.similarity = static_cast<uint8_t>(value);
+		break;
+	case settings::Field::speed:
+		values.speed = value;
+		break;
+	case settings::Field::effect:
+		values.effect = static_cast<settings::Effect>(value);
+		break;
+	case settings::Field::hour_24:
+		values.hour_24 = value;
+		break;
+	case settings::Field::curve:
+		values.curve = static_cast<settings::Curve>(value);
+		break;
+	case settings::Field::big_digits:
+		values.big_digits = value;
+		break;
+	default:
+		break;
+	}
+}
+
+//Where each field is stored (from the start of the values), and how many bytes it takes
+static uint8_t offset(settings::Field const field) {
+	return((field > settings::Field::speed) ? static_cast<uint8_t>(field) + 1 : static_cast<uint8_t>(field));
+}
+
+static uint8_t width(settings::Field const field) {
+	return((field == settings::Field::speed) ? 2 : 1);
+}
+
+static uint16_t value_of(settings::Field const field) {
+	switch (field) {
+	case settings::Field::similarity:
+		return(values.similarity);
+	case settings::Field::speed:
+		return(values.speed);
+	case settings::Field::effect:
+		return(static_cast<uint8_t>(values.effect));
+	case settings::Field::hour_24:
+		return(values.hour_24 ? 1 : 0);
+	case settings::Field::curve:
+		return(static_cast<uint8_t>(values.curve));
+	case settings::Field::big_digits:
+		return(values.big_digits ? 1 : 0);
+	default:
+		return(0);
+	}
+}
+
+//Writes the values as they're stored (little endian)
+static void encode(uint8_t out[values_size]) {
+	for (uint8_t i = 0; i < static_cast<uint8_t>(settings::Field::amount); i++) {
+		settings::Field const field = static_cast<settings::Field>(i);
+		uint16_t const value = value_of(field);
+		out[offset(field)] = static_cast<uint8_t>(value);
+		if (width(field) == 2)
+			out[offset(field) + 1] = static_cast<uint8_t>(value >> 8);
+	}
+}
+
+//Loads the fields a record has (len bytes of values). Fields that are missing, or out of range, keep their defaults.
+static void decode(uint8_t const in[], uint8_t const len) {
+	values = settings::Values();
+	for (uint8_t i = 0; i < static_cast<uint8_t>(settings::Field::amount); i++) {
+		settings::Field const field = static_cast<settings::Field>(i);
+		if (offset(field) + width(field) > len)
+			break;
+		uint16_t value = in[offset(field)];
+		if (width(field) == 2)
+			value |= static_cast<uint16_t>(in[offset(field) + 1]) << 8;
+		if (valid(field, value))
+			store(field, value);
+	}
+}
+
+//Reads the record in a slot. Returns false if it isn't a valid one.
+static bool read_record(uint8_t const index, uint8_t buffer[]) {
+	eeprom_read_block(buffer, log_eeprom[index], settings::slot_size);
+	//Blank EEPROM (0xff) fails the length check
+	return((buffer[2] <= settings::slot_size - header_size - 1) && (crc(buffer) == buffer[settings::slot_size - 1]));
+}
+
+static uint16_t sequence_of(uint8_t const buffer[]) {
+	return(buffer[0] | (static_cast<uint16_t>(buffer[1]) << 8));
+}
+
+void settings::init(Location const *const hint) {
+	bool found = false;
+	uint8_t newest[slot_size];
+	if (hint && (hint->slot < slots) && read_record(hint->slot, newest) &&
+		(sequence_of(newest) == hint->sequence) && (newest[slot_size - 1] == hint->digest)) {
+		//The hint is out of date if a record was written after it was kept (records only ever go in the next slot)
+		uint8_t next[slot_size];
+		found = !read_record((hint->slot + 1) % slots, next) || (static_cast<int16_t>(sequence_of(next) - hint->sequence) <= 0);
+		if (found)
+			slot = hint->slot;
+	}
+	//Otherwise every slot is read once, so it takes the same time however many records there are
+	if (!found) {
+		for (uint8_t i = 0; i < slots; i++) {
+			uint8_t buffer[slot_size];
+			if (!read_record(i, buffer))
+				continue;
+			//Newer even once the sequence wraps (there are never more than slots records apart)
+			if (found && (static_cast<int16_t>(sequence_of(buffer) - sequence_of(newest)) <= 0))
+				continue;
+			found = true;
+			slot = i;
+			for (uint8_t j = 0; j < slot_size; j++) {
+				newest[j] = buffer[j];
+			}
+		}
+	}
+	if (found) {
+		sequence = sequence_of(newest);
+		digest = newest[slot_size - 1];
+		decode(newest + header_size, newest[2]);
+	}
+	else {
+		values = Values();
+	}
+	changed = false;
+	record_index = slot_size;
+	settle.reset();
+}
+
+void settings::update() {
+	//Write the next byte of a record, once the EEPROM is done with the last one
+	if (record_index < slot_size) {
+		if (!eeprom_is_ready())
+			return;
+		eeprom_update_byte(&log_eeprom[record_slot][record_index], record[record_index]);
+		record_index++;
+		if (record_index == slot_size) {
+			sequence = sequence_of(record);
+			slot = record_slot;
+			digest = record[slot_size - 1];
+		}
+		return;
+	}
+	if (!changed || !settle)
+		return;
+	//Put the next record together, in the slot after the newest
+	uint16_t const next = sequence + 1;
+	record[0] = static_cast<uint8_t>(next);
+	record[1] = static_cast<uint8_t>(next >> 8);
+	record[2] = values_size;
+	for (uint8_t i = header_size; i < slot_size; i++) {
+		record[i] = 0xff;
+	}
+	encode(record + header_size);
+	record[slot_size - 1] = crc(record);
+	record_slot = (slot + 1) % slots;
+	record_index = 0;
+	changed = false;
+	settle.reset();
+}
+
+settings::Values const &settings::get() {
+	return(values);
+}
+
+bool settings::set(Field const field, uint16_t const value) {
+	if (!valid(field, value))
+		return(false);
+	if (value_of(field) == value)
+		return(true);
+	store(field, value);
+	changed = true;
+	//Put the write off until the changes stop
+	settle.reset();
+	settle = write_delay;
+	settle.start();
+	return(true);
+}
+
+settings::Location settings::location() {
+	Location const result = { sequence, slot, digest };
+	return(result);
+}
+
+bool settings::pending() {
+	return(changed || (record_index < slot_size));
+}
+
+bool settings::dump(uint8_t const index) {
+	if (index)
+		return(false);
+	uint8_t payload[4 + values_size];
+	payload[0] = static_cast<uint8_t>(sequence);
+	payload[1] = static_cast<uint8_t>(sequence >> 8);
+	payload[2] = slot;
+	payload[3] = pending() ? 1 : 0;
+	encode(payload + 4);
+	telemetry::send(telemetry::Type::settings, payload, sizeof(payload));
+	return(true);
+}
@@ -0,0 +1,62 @@
+#include "../include/space.h"
+
+#define SPACE_POINT(x, y, z) space::Led(space::fixed(x), space::fixed(y), space::fixed(z)),
+#define SPACE_POLAR(angle, radius, z) space::Led(space::fixed((radius) * space::cos_deg(angle)), space::fixed((radius) * space::sin_deg(angle)), space::fixed(z)),
+
+space::Led const space::table[] PROGMEM = {
+	LAYOUT(SPACE_POINT, SPACE_POLAR)
+};
+
+static_assert(sizeof(space::table) / sizeof(space::table[0]) == space::led_count, "LAYOUT and led_count disagree");
+
+//Clamps a distance term to an intensity (0 = far away, 255 = on the surface)
+static uint8_t intensity(uint32_t const distance) {
+	return((distance > 255) ? 0 : 255 - distance);
+}
+
+space::Vector space::position(uint8_t const led) {
+	Vector result;
+	result.x = pgm_read_byte(&table[led].position.x);
+	result.y = pgm_read_byte(&table[led].position.y);
+	result.z = pgm_read_byte(&table[led].position.z);
+	return(result);
+}
+
+int16_t space::dot(uint8_t const led, Vector const &direction) {
+	Vector const p = position(led);
+	return((static_cast<int16_t>(p.x * direction.x) + (p.y * direction.y) + (p.z * direction.z)) / unit);
+}
+
+uint8_t space::plane(uint8_t const led, Plane const &p0) {
+	int16_t distance = dot(led, p0.normal) - p0.offset;
+	if (distance < 0)
+		distance = -distance;
+	return(intensity(static_cast<uint32_t>(distance) << p0.shift));
+}
+
+space::Sphere space::sphere(Vector const &centre, uint8_t const radius, uint8_t const shift) {
+	Sphere result;
+	result.centre = centre;
+	result.bias = static_cast<int32_t>(centre.x * centre.x) + (centre.y * centre.y) + (centre.z * centre.z) - (static_cast<int32_t>(radius) * radius);
+	result.shift = shift;
+	return(result);
+}
+
+uint8_t space::shell(uint8_t const led, Sphere const &p0) {
+	Vector const p = position(led);
+	//d^2 - r^2 = |p|^2 - 2(p . c) + |c|^2 - r^2
+	int32_t distance = static_cast<int32_t>(pgm_read_word(&table[led].distance2)) -
+		2 * (static_cast<int32_t>(p.x * p0.centre.x) + static_cast<int16_t>(p.y * p0.centre.y) + static_cast<int16_t>(p.z * p0.centre.z)) + p0.bias;
+	if (distance < 0)
+		distance = -distance;
+	return(intensity(static_cast<uint32_t>(distance) >> p0.shift));
+}
+
+int8_t space::sweep(uint16_t const step, uint16_t const last) {
+	//In 32 bits, as step * 2 * unit is past a 16 bit int by step 130
+	return(static_cast<int8_t>(((static_cast<int32_t>(step) * (2 * unit)) / last) - unit));
+}
+
+uint8_t space::pulse(uint16_t const step, uint16_t const last, uint8_t const radius_max) {
+	return(static_cast<uint8_t>((static_cast<uint32_t>(step) * radius_max) / last));
+}
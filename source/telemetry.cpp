@@ -0,0 +1,232 @@
+#include "../include/telemetry.h"
+#include <util/crc16.h>
+#include "../include/timer.h"
+#include "../include/temperature.h"
+#include "../include/audio.h"
+#include "../include/profile.h"
+#include "../include/trace.h"
+#include "../include/memory.h"
+#include "../include/calibrate.h"
+#include "../include/settings.h"
+#include "../include/history.h"
+#include "../include/input.h"
+#include "../avr_lib_ds18b20_02/src/uart/uart.h"
+
+//A frame can grow by 1 byte in COBS (while it's under 254 bytes), plus the 0 that ends it
+static constexpr uint8_t frame_max = 2 + telemetry::payload_max + 2 + 2;
+static_assert(frame_max < 64, "A frame must fit in the UART transmit buffer (UART_TX_BUFFER_SIZE in the Makefile)");
+
+static uint8_t sequence = 0;
+static uint16_t dropped_amount = 0;
+static uint16_t loop_amount = 0;
+static uint16_t frame_amount = 0;
+
+//Counts down to the next status frame
+static Timer send_timer;
+
+//The dump being sent, and the frame it's up to
+static telemetry::Dumper dumper = nullptr;
+static uint8_t dump_index = 0;
+
+//A command that takes arguments, and the arguments received so far
+static uint8_t argument_command = 0;
+static uint8_t argument[3];
+static uint8_t argument_amount = 0;
+//Counts down the time the rest of the arguments have to arrive in
+static Timer argument_timer;
+
+//Writes a value into a buffer (little endian), and returns the position after it
+static uint8_t *put(uint8_t *p0, uint16_t const value) {
+	p0[0] = static_cast<uint8_t>(value);
+	p0[1] = static_cast<uint8_t>(value >> 8);
+	return(p0 + 2);
+}
+static uint8_t *put(uint8_t *p0, uint8_t const value) {
+	p0[0] = value;
+	return(p0 + 1);
+}
+
+void telemetry::init() {
+	uart_init(UART_BAUD_SELECT(baud, F_CPU));
+	send_timer.reset();
+	send_timer = interval;
+	send_timer.start();
+}
+
+void telemetry::loop() {
+	if (loop_amount != 0xffff)
+		loop_amount++;
+}
+
+void telemetry::frame() {
+	if (frame_amount != 0xffff)
+		frame_amount++;
+}
+
+//Handles a single byte command
+static void command(uint8_t const p0) {
+	switch (p0) {
+#ifdef PROFILE
+	case 'p':
+		telemetry::dump(profile::dump);
+		break;
+	case 'P':
+		profile::reset();
+		break;
+#endif
+#ifdef TRACE
+	case 't':
+		telemetry::dump(trace::dump);
+		break;
+	case 'T':
+		trace::clear();
+		break;
+#endif
+	case 'm':
+		memory::update();
+		telemetry::dump(memory::dump);
+		break;
+	case 'c':
+		calibrate::start(false);
+		break;
+	case 'C':
+		calibrate::start(true);
+		break;
+	case 'S':
+		telemetry::dump(settings::dump);
+		break;
+	case 'h':
+		telemetry::dump(history::dump);
+		break;
+	case 's':
+		//Field and value follow
+		argument_command = p0;
+		argument_amount = 0;
+		argument_timer.reset();
+		argument_timer = telemetry::argument_timeout;
+		argument_timer.start();
+		break;
+	default:
+		break;
+	}
+}
+
+void telemetry::update(uint8_t const light, IC_DS1307::RegData const &time) {
+	//The high byte holds UART_NO_DATA (or an error)
+	unsigned int const received = uart_getc();
+	//A command whose arguments stopped coming (eg the end of it was lost) is dropped, so it doesn't swallow the next commands
+	if (argument_command && argument_timer) {
+		argument_command = 0;
+		argument_timer.reset();
+	}
+	if (!(received & 0xff00)) {
+		if (argument_command) {
+			argument[argument_amount] = received;
+			argument_amount++;
+			if (argument_amount == sizeof(argument)) {
+				settings::set(static_cast<settings::Field>(argument[0]), argument[1] | (static_cast<uint16_t>(argument[2]) << 8));
+				telemetry::dump(settings::dump);
+				argument_command = 0;
+				argument_timer.reset();
+			}
+		}
+		else {
+			command(received);
+		}
+	}
+	//Send the next frame of a dump, once there's room for it
+	if (dumper && (uart_txspace() >= frame_max)) {
+		if (dumper(dump_index))
+			dump_index++;
+		else
+			dumper = nullptr;
+	}
+
+	if (!send_timer)
+		return;
+	send_timer.reset();
+	send_timer = interval;
+	send_timer.start();
+
+	temperature::Errors const &errors = temperature::errors();
+	memory::Usage const &memory_usage = memory::update();
+	history::Sample sample;
+	sample.temperature = temperature::valid() ? temperature::get() : static_cast<int16_t>(0x8000);
+	sample.light = light;
+	sample.loops = static_cast<uint16_t>(static_cast<uint32_t>(loop_amount) * 1000 / interval);
+	sample.frames = static_cast<uint16_t>(static_cast<uint32_t>(frame_amount) * 1000 / interval);
+	sample.faults = errors.crc + errors.no_presence + errors.late + errors.failed + audio::overruns() + dropped_amount + input::dropped();
+	history::second(sample, time);
+
+	uint8_t payload[payload_max];
+	uint8_t *p = payload;
+	p = put(p, sample.loops);
+	p = put(p, sample.frames);
+	p = put(p, light);
+	p = put(p, static_cast<uint16_t>(sample.temperature));
+	p = put(p, temperature::sensors());
+	p = put(p, time.hour());
+	p = put(p, static_cast<uint8_t>((time.minute1 * 10) + time.minute0));
+	p = put(p, static_cast<uint8_t>((time.second1 * 10) + time.second0));
+	p = put(p, errors.crc);
+	p = put(p, errors.no_presence);
+	p = put(p, errors.late);
+	p = put(p, errors.failed);
+	p = put(p, audio::overruns());
+	p = put(p, dropped_amount);
+	p = put(p, memory_usage.free_min);
+	p = put(p, static_cast<uint8_t>(memory::low() ? 0x01 : 0x00));
+	p = put(p, input::dropped());
+	send(Type::status, payload, p - payload);
+
+	loop_amount = 0;
+	frame_amount = 0;
+}
+
+bool telemetry::send(Type const type, uint8_t const payload[], uint8_t const len) {
+	if ((len > payload_max) || (uart_txspace() < (len + (frame_max - payload_max)))) {
+		if (dropped_amount != 0xffff)
+			dropped_amount++;
+		return(false);
+	}
+	//Put the whole frame together, so it can be COBS encoded in one go
+	uint8_t raw[2 + payload_max + 2];
+	uint8_t const raw_len = 2 + len + 2;
+	raw[0] = static_cast<uint8_t>(type);
+	raw[1] = sequence;
+	sequence++;
+	uint16_t crc = 0;
+	for (uint8_t i = 0; i < 2 + len; i++) {
+		if (i >= 2)
+			raw[i] = payload[i - 2];
+		crc = _crc_xmodem_update(crc, raw[i]);
+	}
+	put(raw + 2 + len, crc);
+
+	//Each run of non zero bytes is sent after a byte holding its length + 1, which stands in for the 0 after it
+	uint8_t start = 0;
+	while (true) {
+		uint8_t end = start;
+		while ((end < raw_len) && raw[end]) {
+			end++;
+		}
+		uart_putc(end - start + 1);
+		for (uint8_t i = start; i < end; i++) {
+			uart_putc(raw[i]);
+		}
+		if (end == raw_len)
+			break;
+		start = end + 1;
+	}
+	uart_putc(0);
+	return(true);
+}
+
+void telemetry::dump(Dumper const p0) {
+	dumper = p0;
+	dump_index = 0;
+}
+
+uint16_t telemetry::dropped() {
+	return(dropped_amount);
+}
@@ -0,0 +1,271 @@
+#include "../include/temperature.h"
+#include "../include/onewire.h"
+#include <avr/eeprom.h>
+#include <string.h>
+
+enum class State : uint8_t {
+	idle,
+	starting,		//The convert command is being sent
+	converting,
+	reading			//A scratchpad is being read
+};
+
+//The sensors found by the last search
+struct RomCache {
+	uint8_t amount;
+	uint8_t rom[temperature::sensor_max][DS18B20_ROMSIZE];
+};
+
+static RomCache EEMEM rom_cache_eeprom;
+static RomCache rom_cache;
+
+static State state = State::idle;
+//Set when nothing answered a reset, or a sensor kept failing, so the bus is searched before the next conversion.
+//A transaction spoilt by another interrupt running late (see onewire::Status::late) is only tried again,
+//as the search blocks the main loop for several milliseconds.
+static bool rescan_needed = false;
+//Intervals in a row each sensor has failed every retry in, and intervals since the last search
+static uint8_t failed_intervals[temperature::sensor_max];
+static uint16_t since_rescan = 0;
+//The sensors whose last reading succeeded, and the mask being built as they're read (published once they all are)
+static uint8_t reading_valid = 0;
+static uint8_t reading_next = 0;
+static int16_t reading[temperature::sensor_max];
+static uint8_t bits = temperature::resolution;
+//The sensor being read, and how many more times it can be tried
+static uint8_t sensor_index = 0;
+static uint8_t tries_left = 0;
+static temperature::Errors error_count = {};
+
+//Counts down the conversion, then the rest of the interval
+static Timer wait;
+
+//Returns whether the cache holds at least one sensor, and every ROM code is intact
+static bool cache_valid() {
+	if ((rom_cache.amount == 0) || (rom_cache.amount > temperature::sensor_max))
+		return(false);
+	for (uint8_t i = 0; i < rom_cache.amount; i++) {
+		if (ds18b20_crc8(rom_cache.rom[i], DS18B20_ROMSIZE))
+			return(false);
+	}
+	return(true);
+}
+
+//Returns the ROM code to address a sensor with (nullptr skips addressing if there's only one)
+static uint8_t const *address(uint8_t const sensor) {
+	return((rom_cache.amount > 1) ? rom_cache.rom[sensor] : nullptr);
+}
+
+//Queues the selection of a sensor (see ds18b20_select())
+static void select(uint8_t const sensor) {
+	uint8_t const *const rom = address(sensor);
+	if (rom) {
+		onewire::write(DS18B20_CMD_MATCHROM);
+		onewire::write(rom, DS18B20_ROMSIZE);
+	} else {
+		onewire::write(DS18B20_CMD_SKIPROM);
+	}
+}
+
+//Adds to an error count, stopping at its maximum
+static void count(uint16_t &counter) {
+	if (counter != 0xffff)
+		counter++;
+}
+
+//Counts a transaction that didn't finish
+static void count_status(onewire::Status const p0) {
+	if (p0 == onewire::Status::no_presence)
+		count(error_count.no_presence);
+	else if (p0 == onewire::Status::late)
+		count(error_count.late);
+}
+
+//Starts a conversion on every sensor at once, in the background
+static void convert_start() {
+	onewire::begin();
+	onewire::reset();
+	onewire::write(DS18B20_CMD_SKIPROM);
+	onewire::write(DS18B20_CMD_CONVERTTEMP);
+	onewire::start();
+}
+
+//Starts reading the scratchpad of a sensor in the background
+static void read_start(uint8_t const sensor) {
+	onewire::begin();
+	onewire::reset();
+	select(sensor);
+	onewire::write(DS18B20_CMD_RSCRATCHPAD);
+	//The whole scratchpad, so the CRC can be checked
+	onewire::read(DS18B20_SCRATCHPADSIZE);
+	onewire::start();
+}
+
+//Waits out the rest of the interval (at least 1ms, if the conversion took longer)
+static void idle_start() {
+	state = State::idle;
+	wait.reset();
+	wait = (temperature::interval > temperature::conversion_time()) ? temperature::interval - temperature::conversion_time() : 1;
+	wait.start();
+}
+
+void temperature::init() {
+	onewire::init();
+	state = State::idle;
+	reading_valid = 0;
+	since_rescan = 0;
+	memset(failed_intervals, 0, sizeof(failed_intervals));
+	eeprom_read_block(&rom_cache, &rom_cache_eeprom, sizeof(rom_cache));
+	rescan_needed = !cache_valid();
+	//The resolution isn't persisted, so sensors start at whatever their EEPROM holds
+	if (!rescan_needed)
+		set_resolution(resolution);
+	wait.reset();
+	wait = 1;
+	wait.start();
+}
+
+void temperature::rescan() {
+	rom_cache.amount = ds18b20_search(rom_cache.rom, sensor_max);
+	//Only bother writing the EEPROM if something was found
+	if (rom_cache.amount)
+		eeprom_update_block(&rom_cache, &rom_cache_eeprom, sizeof(rom_cache));
+	rescan_needed = false;
+	since_rescan = 0;
+	memset(failed_intervals, 0, sizeof(failed_intervals));
+	//A sensor that was just found (or power cycled) won't have the resolution set yet
+	set_resolution(bits);
+}
+
+bool temperature::set_resolution(uint8_t const p0, bool const persist) {
+	bool success = true;
+	//The blocking functions can't share the bus with a transaction
+	while (onewire::busy());
+	for (uint8_t i = 0; i < rom_cache.amount; i++) {
+		if (ds18b20_setresolution(address(i), p0, persist))
+			success = false;
+	}
+	//A conversion already running finishes at the old resolution, so only shorten the wait from the next one
+	bits = p0;
+	return(success);
+}
+
+uint16_t temperature::conversion_time() {
+	return(ds18b20_conversiontime(bits));
+}
+
+bool temperature::update() {
+	switch (state) {
+	case State::idle:
+		if (!wait)
+			return(false);
+		//The search is done the blocking way, it's rare enough
+		if (since_rescan != 0xffff)
+			since_rescan++;
+		if (rescan_needed || (since_rescan >= rescan_every))
+			rescan();
+		if (!rom_cache.amount) {
+			//No sensor was found, try again next interval
+			reading_valid = 0;
+			rescan_needed = true;
+			idle_start();
+			return(true);
+		}
+		tries_left = retries;
+		convert_start();
+		state = State::starting;
+		return(false);
+	case State::starting:
+		if (onewire::busy())
+			return(false);
+		if (onewire::status() != onewire::Status::done) {
+			count_status(onewire::status());
+			if ((onewire::status() == onewire::Status::late) && tries_left) {
+				tries_left--;
+				convert_start();
+				return(false);
+			}
+			//Try again next interval, searching the bus first if no sensor answered
+			if (onewire::status() == onewire::Status::no_presence)
+				rescan_needed = true;
+			else
+				count(error_count.failed);
+			reading_valid = 0;
+			idle_start();
+			return(true);
+		}
+		state = State::converting;
+		wait.reset();
+		wait = conversion_time();
+		wait.start();
+		return(false);
+	case State::converting:
+		if (!wait)
+			return(false);
+		//The last readings stay valid while these are taken
+		reading_next = 0;
+		sensor_index = 0;
+		tries_left = retries;
+		read_start(sensor_index);
+		state = State::reading;
+		return(false);
+	case State::reading:
+		if (onewire::busy())
+			return(false);
+		//Read each sensor in turn, trying again if the read was spoilt
+		if (onewire::status() != onewire::Status::done) {
+			count_status(onewire::status());
+		} else {
+			//Into a temporary, so a scratchpad that fails the CRC doesn't touch the last reading
+			int16_t value;
+			if (ds18b20_decodetemp(onewire::received(), &value)) {
+				count(error_count.crc);
+			} else {
+				reading[sensor_index] = value;
+				reading_next |= _BV(sensor_index);
+			}
+		}
+		if (!(reading_next & _BV(sensor_index))) {
+			if (tries_left) {
+				tries_left--;
+				read_start(sensor_index);
+				return(false);
+			}
+			count(error_count.failed);
+			//A sensor that's gone (or was replaced) fails every interval while the others still answer
+			if (failed_intervals[sensor_index] != 0xff)
+				failed_intervals[sensor_index]++;
+			if ((onewire::status() == onewire::Status::no_presence) || (failed_intervals[sensor_index] >= rescan_after))
+				rescan_needed = true;
+		}
+		else {
+			failed_intervals[sensor_index] = 0;
+		}
+		sensor_index++;
+		tries_left = retries;
+		if (sensor_index < rom_cache.amount) {
+			read_start(sensor_index);
+			return(false);
+		}
+		reading_valid = reading_next;
+		idle_start();
+		return(true);
+	}
+	return(false);
+}
+
+uint8_t temperature::sensors() {
+	return(rom_cache.amount);
+}
+
+bool temperature::valid(uint8_t const sensor) {
+	return(reading_valid & _BV(sensor));
+}
+
+int16_t temperature::get(uint8_t const sensor) {
+	return(reading[sensor]);
+}
+
+temperature::Errors const &temperature::errors() {
+	return(error_count);
+}
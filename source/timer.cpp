@@ -1,13 +1,28 @@
 #include "../include/timer.h"
+#include "../include/trace.h"
 
 //Probs should declare volatile
 static timer::Runtime runtime;
 
 #ifndef __INTELLISENSE__
 ISR(TIMER2_OVF_vect) {
+	TRACE_BEGIN(TRACE_TIMER2);
 	if (runtime.loop_index == runtime.param.loop) {
 		if (runtime.loop_remainder) {
-			timer::tick();
+			//Drop a tick if the trim has got a whole tick ahead, or add one if it's a whole tick behind
+			runtime.trim_error += runtime.trim;
+			if (runtime.trim_error <= -1000000000) {
+				runtime.trim_error += 1000000000;
+			}
+			else {
+				timer::tick();
+				runtime.count++;
+				if (runtime.trim_error >= 1000000000) {
+					runtime.trim_error -= 1000000000;
+					timer::tick();
+					runtime.count++;
+				}
+			}
 			timer::next_tick();
 		}
 		else {
@@ -18,6 +33,7 @@ ISR(TIMER2_OVF_vect) {
 	else {
 		runtime.loop_index++;
 	}
+	TRACE_END(TRACE_TIMER2);
 }
 #endif
 
@@ -40,11 +56,13 @@ void timer::next_tick() {
 #endif
 }
 
-void timer::init(double const interval) {
+void timer::init(Tick const &p0) {
 #ifndef __INTELLISENSE__
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
 #endif
-		runtime.param = determine_parameters(interval);
+		runtime.param = p0.param;
+		runtime.nominal = p0.nominal;
+		runtime.count = 0;
 		next_tick();
 		TCCR2B &= ~(_BV(CS22) | _BV(CS21) | _BV(CS20));	//Clear prescale bits
 		TCCR2B |= runtime.param.prescale;				//Set prescale
@@ -71,7 +89,7 @@ void timer::remove(Timer const *const ntimer) {
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
 #endif
 		size_t pos = find(ntimer);
-		memcpy(runtime.timer_buf + pos, runtime.timer_buf + pos + 1, runtime.timer_amount - pos - 1);
+		memmove(runtime.timer_buf + pos, runtime.timer_buf + pos + 1, sizeof(Timer *) * (runtime.timer_amount - pos - 1));
 		runtime.timer_amount--;
 		runtime.timer_buf = static_cast<Timer **>(realloc(static_cast<void *>(runtime.timer_buf), sizeof(Timer *) * runtime.timer_amount));
 #ifndef __INTELLISENSE__
@@ -100,11 +118,72 @@ void timer::tick() {
 		for (size_t i = 0; i < runtime.timer_amount; i++) {
 			runtime.timer_buf[i]->decrement();
 		}
+		if (runtime.hook)
+			runtime.hook();
 #ifndef __INTELLISENSE__
 	}
 #endif
 }
 
+uint32_t timer::count() {
+	uint32_t result;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		result = runtime.count;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	return(result);
+}
+
+uint32_t timer::period() {
+	//Timer2s prescales, by its clock select bits
+	static constexpr uint16_t prescales[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+	//A tick is loop + 1 whole overflows then home + 1 counts, or just home + 1 counts if there's no loop (see next_tick())
+	uint32_t counts = static_cast<uint32_t>(runtime.param.home) + 1;
+	if (runtime.param.loop != 0)
+		counts += (static_cast<uint32_t>(runtime.param.loop) + 1) * 256;
+	return(counts * prescales[runtime.param.prescale & 0x07]);
+}
+
+uint32_t timer::nominal() {
+	return(runtime.nominal);
+}
+
+void timer::trim(int32_t const ppb) {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		runtime.trim = (ppb > trim_max) ? trim_max : (ppb < -trim_max) ? -trim_max : ppb;
+		runtime.trim_error = 0;
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+void timer::on_tick(TickHook const p0) {
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		runtime.hook = p0;
+#ifndef __INTELLISENSE__
+	}
+#endif
+}
+
+int32_t timer::trim() {
+	int32_t result;
+#ifndef __INTELLISENSE__
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+#endif
+		result = runtime.trim;
+#ifndef __INTELLISENSE__
+	}
+#endif
+	return(result);
+}
+
 Timer::operator bool() const {
 	return(finished);
 }
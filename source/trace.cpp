@@ -0,0 +1,61 @@
+#include "../include/trace.h"
+
+#ifdef TRACE
+
+#include "../include/telemetry.h"
+
+static_assert((TRACE_SIZE & (TRACE_SIZE - 1)) == 0, "TRACE_SIZE must be a power of 2");
+static_assert(TRACE_SIZE <= 128, "TRACE_SIZE must fit the 8 bit indexes");
+
+trace_record_t trace_buffer[TRACE_SIZE];
+volatile uint8_t trace_head = 0;
+volatile uint8_t trace_count = 0;
+volatile uint8_t trace_enabled = 1;
+
+//Records in each dump frame
+static constexpr uint8_t records_per_frame = (telemetry::payload_max - 2) / sizeof(trace_record_t);
+//The oldest record, and how many there were when the dump started
+static uint8_t dump_start;
+static uint8_t dump_count;
+
+bool trace::dump(uint8_t const index) {
+	if (index == 0) {
+		//Stop recording, so the dump itself isn't traced over the records being sent
+		trace_enabled = 0;
+		dump_count = trace_count;
+		dump_start = (trace_head - dump_count) & (TRACE_SIZE - 1);
+	}
+	uint8_t const first = index * records_per_frame;
+	if (first >= dump_count) {
+		clear();
+		trace_enabled = 1;
+		return(false);
+	}
+	uint8_t amount = dump_count - first;
+	if (amount > records_per_frame)
+		amount = records_per_frame;
+	uint8_t payload[2 + (records_per_frame * sizeof(trace_record_t))];
+	uint8_t *p = payload;
+	*p++ = first;
+	*p++ = dump_count;
+	for (uint8_t i = 0; i < amount; i++) {
+		trace_record_t const &record = trace_buffer[(dump_start + first + i) & (TRACE_SIZE - 1)];
+		*p++ = static_cast<uint8_t>(record.time);
+		*p++ = static_cast<uint8_t>(record.time >> 8);
+		*p++ = record.time_high;
+		*p++ = record.event;
+		*p++ = record.arg;
+	}
+	telemetry::send(telemetry::Type::trace, payload, p - payload);
+	return(true);
+}
+
+void trace::clear() {
+	uint8_t const sreg = SREG;
+	cli();
+	trace_head = 0;
+	trace_count = 0;
+	SREG = sreg;
+}
+
+#endif
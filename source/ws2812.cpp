@@ -0,0 +1,130 @@
+#include "../include/ws2812.h"
+
+typedef pins::neopixels data;
+
+//Bit slot timing (in cycles)
+static constexpr uint8_t cycles(uint16_t const ns) {
+	return(static_cast<uint8_t>(((static_cast<uint32_t>(ns) * (F_CPU / 1000000)) + 999) / 1000));
+}
+static constexpr uint8_t zero_high = cycles(350);	//Length of a 0 pulse
+static constexpr uint8_t one_high = cycles(800);	//Length of a 1 pulse
+static constexpr uint8_t period = cycles(1250);		//Length of a bit slot
+static_assert(zero_high >= 4, "F_CPU is too slow for parallel ws2812 output");
+
+//Padding (nops) between the writes of a bit slot. See the cycle counts in send_planes() and send_bytes().
+static constexpr uint8_t plane_nop1 = zero_high - 4;
+static constexpr uint8_t plane_nop2 = one_high - zero_high - 1;
+static constexpr uint8_t plane_nop3 = (period > (10 + plane_nop1 + plane_nop2)) ? period - (10 + plane_nop1 + plane_nop2) : 0;
+static constexpr uint8_t byte_nop1 = zero_high - 2;
+static constexpr uint8_t byte_nop2 = one_high - zero_high - 2;
+static constexpr uint8_t byte_nop3 = (period > (8 + byte_nop1 + byte_nop2)) ? period - (8 + byte_nop1 + byte_nop2) : 0;
+
+#ifdef HOST
+ws2812::Sink ws2812::sink = nullptr;
+#else
+//Sends one plane byte per bit slot to every strip
+static void send_planes(uint8_t const plane[], uint16_t len) {
+	uint8_t const lo = data::output_register() & ~ws2812::mask;
+	uint8_t const hi = lo | ws2812::mask;
+	uint8_t current;
+	asm volatile(
+		"loop%=:                        \n\t"
+		"	out %[port], %[hi]          \n\t"	//[1] all strips high
+		"	ld %[current], %a[plane]+   \n\t"	//[3]
+		"	or %[current], %[lo]        \n\t"	//[4]
+		"	.rept %[nop1]               \n\t"
+		"	nop                         \n\t"
+		"	.endr                       \n\t"
+		"	out %[port], %[current]     \n\t"	//[5 + nop1] strips sending a 0 go low
+		"	.rept %[nop2]               \n\t"
+		"	nop                         \n\t"
+		"	.endr                       \n\t"
+		"	out %[port], %[lo]          \n\t"	//[6 + nop1 + nop2] strips sending a 1 go low
+		"	sbiw %[len], 1              \n\t"	//[8 + ...]
+		"	.rept %[nop3]               \n\t"
+		"	nop                         \n\t"
+		"	.endr                       \n\t"
+		"	brne loop%=                 \n\t"	//[10 + ...]
+		: [current] "=&r" (current), [plane] "+e" (plane), [len] "+w" (len)
+		: [port] "I" (data::output_io), [hi] "r" (hi), [lo] "r" (lo),
+		  [nop1] "I" (plane_nop1), [nop2] "I" (plane_nop2), [nop3] "I" (plane_nop3)
+	);
+}
+
+//Sends bytes MSB first to a single strip
+static void send_bytes(uint8_t const *data, uint16_t len) {
+	uint8_t const lo = data::output_register() & ~ws2812::mask;
+	uint8_t const hi = lo | ws2812::mask;
+	while (len--) {
+		uint8_t current = *data++;
+		uint8_t bit;
+		asm volatile(
+			"	ldi %[bit], 8               \n\t"
+			"loop%=:                        \n\t"
+			"	out %[port], %[hi]          \n\t"	//[1] high
+			"	.rept %[nop1]               \n\t"
+			"	nop                         \n\t"
+			"	.endr                       \n\t"
+			"	sbrs %[current], 7          \n\t"	//[2 + nop1]
+			"	out %[port], %[lo]          \n\t"	//[3 + nop1] low if sending a 0
+			"	lsl %[current]              \n\t"	//[4 + nop1]
+			"	.rept %[nop2]               \n\t"
+			"	nop                         \n\t"
+			"	.endr                       \n\t"
+			"	out %[port], %[lo]          \n\t"	//[5 + nop1 + nop2] low
+			"	.rept %[nop3]               \n\t"
+			"	nop                         \n\t"
+			"	.endr                       \n\t"
+			"	dec %[bit]                  \n\t"	//[6 + ...]
+			"	brne loop%=                 \n\t"	//[8 + ...]
+			: [bit] "=&d" (bit), [current] "+r" (current)
+			: [port] "I" (data::output_io), [hi] "r" (hi), [lo] "r" (lo),
+			  [nop1] "I" (byte_nop1), [nop2] "I" (byte_nop2), [nop3] "I" (byte_nop3)
+		);
+	}
+}
+#endif
+
+void ws2812::init() {
+	data::direction_register() |= mask;
+	data::output_register() &= ~mask;
+}
+
+void ws2812::transpose(cRGB const led[], uint16_t const len, uint8_t plane[]) {
+	if (strips == 1)
+		return;
+	uint8_t const *const bytes = reinterpret_cast<uint8_t const *>(led);
+	for (uint16_t i = 0; i < len * 3; i++) {
+		//Gather this byte from every strip
+		uint8_t value[strips];
+		for (uint8_t k = 0; k < strips; k++) {
+			value[k] = bytes[(k * len * 3) + i];
+		}
+		//One plane per bit, MSB first
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			uint8_t current = 0;
+			for (uint8_t k = 0; k < strips; k++) {
+				if (value[k] & 0x80)
+					current |= _BV(data::first + k);
+				value[k] <<= 1;
+			}
+			*plane++ = current;
+		}
+	}
+}
+
+void ws2812::setleds(cRGB const led[], uint16_t const len, uint8_t const plane[]) {
+#ifdef HOST
+	//Every strip's neopixels, one strip after the other
+	(void)plane;
+	if (sink)
+		sink(led, len * strips);
+#else
+	if (strips > 1) {
+		send_planes(plane, len * 24);
+	}
+	else {
+		send_bytes(reinterpret_cast<uint8_t const *>(led), len * 3);
+	}
+#endif
+}
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+"""Decodes the lamps telemetry stream (see include/telemetry.h).
+
+Reads a capture file, or a serial port / pty (set to 19200 baud), and prints each
+status frame, writes them as CSV, or plots them. Commands can be sent to a serial port
+first (eg 'p' dumps the profile of a PROFILE build, 'c' checks the tick against the DS1307,
+'h' dumps the status history).
+
+	telemetry.py capture.bin
+	telemetry.py /dev/ttyUSB0 --csv > log.csv
+	telemetry.py /dev/ttyUSB0 --plot
+	telemetry.py /dev/ttyUSB0 --send p
+	telemetry.py /dev/ttyUSB0 --send h
+	telemetry.py /dev/ttyUSB0 --set effect reactive --set hour_24 1
+"""
+
+import argparse
+import os
+import stat
+import struct
+import sys
+
+BAUD = 19200
+
+TYPE_STATUS = 1
+STATUS_FORMAT = "<HHBhBBBBHHHHBHHBB"
+STATUS_FIELDS = (
+	"loops", "fps", "light", "temperature", "sensors", "hour", "minute", "second",
+	"crc_errors", "no_presence", "late", "failed", "overruns", "dropped", "free_min", "warnings",
+	"input_dropped",
+)
+WARNING_MEMORY = 0x01
+
+TYPE_PROFILE = 2
+PROFILE_FORMAT = "<BHIII8H"
+PROFILE_BINS = 8
+F_CPU = 20000000
+
+TYPE_MEMORY = 4
+MEMORY_FORMAT = "<8H"
+MEMORY_FIELDS = ("sram", "data", "bss", "heap", "stack", "stack_max", "free_min", "warning")
+
+TYPE_CALIBRATION = 5
+CALIBRATION_FORMAT = "<BiiiiiiB"
+CALIBRATION_FIELDS = ("seconds", "clock", "tick", "counted", "jitter", "jitter_spread", "trim", "flags")
+TYPE_SETTINGS = 6
+SETTINGS_FORMAT = "<HBBBHBBB"
+SETTINGS_FIELDS = ("sequence", "slot", "pending", "similarity", "speed", "effect", "hour_24", "curve", "big_digits")
+EFFECTS = ("rainbow", "reactive", "sweep", "pulse")
+CURVES = ("linear", "square")
+TYPE_HISTORY = 7
+HISTORY_INTERVAL = 600
+HISTORY_HEADER_FORMAT = "<HBBH"
+HISTORY_FIELDS = ("temperature", "light", "loops", "fps", "faults")
+CALIBRATION_STORED = 0x01
+CALIBRATION_TIMEOUT = 0x02
+
+
+def crc_xmodem(data):
+	crc = 0
+	for byte in data:
+		crc ^= byte << 8
+		for _ in range(8):
+			crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+			crc &= 0xffff
+	return crc
+
+
+def crc8_maxim(data):
+	crc = 0
+	for byte in data:
+		crc ^= byte
+		for _ in range(8):
+			crc = ((crc >> 1) ^ 0x8c) if crc & 0x01 else (crc >> 1)
+	return crc
+
+
+def cobs_decode(data):
+	"""Decodes one COBS frame (without the 0 that ends it). Returns None if it's malformed."""
+	out = bytearray()
+	i = 0
+	while i < len(data):
+		code = data[i]
+		if code == 0 or i + code > len(data) + 1:
+			return None
+		out += data[i + 1:i + code]
+		i += code
+		if code < 0xff and i < len(data):
+			out.append(0)
+	return bytes(out)
+
+
+def frames(stream):
+	"""Yields (type, sequence, payload) for every frame with a good CRC, and None for a bad one."""
+	buffer = bytearray()
+	while True:
+		chunk = stream.read(256)
+		if not chunk:
+			return
+		buffer += chunk
+		while True:
+			end = buffer.find(0)
+			if end < 0:
+				break
+			raw = cobs_decode(bytes(buffer[:end]))
+			del buffer[:end + 1]
+			if raw is None or len(raw) < 4:
+				#Usually the tail of a frame the capture started part way through
+				yield None
+				continue
+			body, crc = raw[:-2], struct.unpack("<H", raw[-2:])[0]
+			if crc_xmodem(body) != crc:
+				yield None
+				continue
+			yield body[0], body[1], body[2:]
+
+
+def decode_status(payload):
+	values = struct.unpack_from(STATUS_FORMAT, payload)
+	status = dict(zip(STATUS_FIELDS, values))
+	if status["temperature"] == -0x8000:
+		status["temperature"] = None
+	else:
+		status["temperature"] /= 16
+	return status
+
+
+def decode_profile(payload):
+	values = struct.unpack_from(PROFILE_FORMAT, payload)
+	size = struct.calcsize(PROFILE_FORMAT)
+	return {
+		"stage": values[0], "count": values[1], "min": values[2], "max": values[3], "average": values[4],
+		"histogram": values[5:5 + PROFILE_BINS], "name": payload[size:].decode("ascii", "replace"),
+	}
+
+
+def format_profile(profile):
+	def us(cycles):
+		return cycles * 1000000 / F_CPU
+	return "%-12s %6u  min %9.1fus  max %9.1fus  avg %9.1fus  |%s|" % (
+		profile["name"], profile["count"], us(profile["min"]), us(profile["max"]), us(profile["average"]),
+		" ".join("%5u" % n for n in profile["histogram"]))
+
+
+def decode_history(payload):
+	"""Returns the sequence, date, minute of the day and samples of a history block (see include/history.h), or None."""
+	if len(payload) < struct.calcsize(HISTORY_HEADER_FORMAT) + 1 or crc8_maxim(payload[:-1]) != payload[-1]:
+		return None
+	sequence, count, date, minute = struct.unpack_from(HISTORY_HEADER_FORMAT, payload)
+	position = struct.calcsize(HISTORY_HEADER_FORMAT)
+	values = [0] * len(HISTORY_FIELDS)
+	samples = []
+	for _ in range(count):
+		bits = payload[position]
+		position += 1
+		for i in range(len(HISTORY_FIELDS)):
+			if not bits & (1 << i):
+				continue
+			value = 0
+			shift = 0
+			while True:
+				byte = payload[position]
+				position += 1
+				value |= (byte & 0x7f) << shift
+				shift += 7
+				if not byte & 0x80:
+					break
+			values[i] += -((value + 1) >> 1) if value & 1 else value >> 1
+		samples.append(dict(zip(HISTORY_FIELDS, values)))
+	return sequence, date, minute, samples
+
+
+def format_history(block):
+	sequence, date, minute, samples = block
+	lines = []
+	for i, sample in enumerate(samples):
+		at = minute + (i * HISTORY_INTERVAL) // 60
+		temperature = "-" if sample["temperature"] == -0x8000 else "%.1fC" % (sample["temperature"] / 16)
+		lines.append("history #%u day %02u %02u:%02u  temperature %s  light %u  loops %u/s  fps %u  faults %u" % (
+			sequence, date + at // 1440, (at // 60) % 24, at % 60, temperature,
+			sample["light"], sample["loops"], sample["fps"], sample["faults"]))
+	return "\n".join(lines)
+
+
+def open_input(path, send=""):
+	"""Opens a capture file, or a serial port / pty set to raw mode at BAUD (writing send to it)."""
+	if path == "-":
+		return sys.stdin.buffer
+	if stat.S_ISCHR(os.stat(path).st_mode):
+		import termios
+		import tty
+		fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+		tty.setraw(fd)
+		attributes = termios.tcgetattr(fd)
+		speed = getattr(termios, "B%d" % BAUD)
+		attributes[4] = attributes[5] = speed
+		termios.tcsetattr(fd, termios.TCSANOW, attributes)
+		if send:
+			os.write(fd, send.encode("latin-1"))
+		return os.fdopen(fd, "rb", buffering=0)
+	return open(path, "rb")
+
+
+def format_status(sequence, status):
+	temperature = "--.-C" if status["temperature"] is None else "%5.1fC" % status["temperature"]
+	return ("#%3u %02u:%02u:%02u  %5u loops/s  %4u fps  light %3u  %s (%u)  "
+		"errors crc %u presence %u late %u failed %u  overruns %u  dropped %u  inputs dropped %u  free %u%s" % (
+		sequence, status["hour"], status["minute"], status["second"], status["loops"], status["fps"],
+		status["light"], temperature, status["sensors"], status["crc_errors"], status["no_presence"],
+		status["late"], status["failed"], status["overruns"], status["dropped"], status["input_dropped"], status["free_min"],
+		" (LOW)" if status["warnings"] & WARNING_MEMORY else ""))
+
+
+def format_memory(memory):
+	return ("sram %(sram)u: data %(data)u  bss %(bss)u  heap %(heap)u  stack %(stack)u (max %(stack_max)u)  "
+		"free min %(free_min)u (warning below %(warning)u)" % memory)
+
+
+def format_calibration(calibration):
+	if calibration["flags"] & CALIBRATION_TIMEOUT and not calibration["seconds"]:
+		return "calibration: no square wave from the DS1307 (trim %+.3fppm)" % (calibration["trim"] / 1000)
+	ppm = dict((k, calibration[k] / 1000) for k in ("clock", "tick", "counted", "jitter", "jitter_spread", "trim"))
+	return ("calibration over %us: clock %+.3fppm  tick %+.3fppm (slow)  counted %+.3fppm  "
+		"jitter %.3fppm (spread %.3fppm)  trim %+.3fppm%s%s" % (
+		calibration["seconds"], ppm["clock"], ppm["tick"], ppm["counted"], ppm["jitter"], ppm["jitter_spread"],
+		ppm["trim"], " (stored)" if calibration["flags"] & CALIBRATION_STORED else "",
+		" (square wave stopped early)" if calibration["flags"] & CALIBRATION_TIMEOUT else ""))
+
+
+def format_settings(settings):
+	return ("settings #%u (slot %u%s): similarity %u  speed %ums  effect %s  %s hour  curve %s" % (
+		settings["sequence"], settings["slot"], ", not written yet" if settings["pending"] else "", settings["similarity"],
+		settings["speed"], EFFECTS[settings["effect"]] if settings["effect"] < len(EFFECTS) else settings["effect"],
+		24 if settings["hour_24"] else 12, CURVES[settings["curve"]] if settings["curve"] < len(CURVES) else settings["curve"]) +
+		("  big digits" if settings.get("big_digits") else ""))
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("input", help="capture file, serial port or pty ('-' for stdin)")
+	output = parser.add_mutually_exclusive_group()
+	output.add_argument("--csv", action="store_true", help="write the status frames as CSV")
+	output.add_argument("--plot", action="store_true", help="plot the status frames (needs matplotlib)")
+	parser.add_argument("--send", default="", help="command bytes to send to a serial port first")
+	parser.add_argument("--set", nargs=2, action="append", default=[], metavar=("FIELD", "VALUE"),
+		help="change a setting (%s) over a serial port first" % ", ".join(SETTINGS_FIELDS[3:]))
+	args = parser.parse_args()
+	for field, value in args.set:
+		if field not in SETTINGS_FIELDS[3:]:
+			parser.error("unknown setting %s" % field)
+		if field == "effect" and value in EFFECTS:
+			value = EFFECTS.index(value)
+		elif field == "curve" and value in CURVES:
+			value = CURVES.index(value)
+		args.send += "s" + struct.pack("<BH", SETTINGS_FIELDS.index(field) - 3, int(value)).decode("latin-1")
+
+	history = []
+	bad = 0
+	last_sequence = None
+	if args.csv:
+		print("sequence," + ",".join(STATUS_FIELDS))
+	try:
+		for frame in frames(open_input(args.input, args.send)):
+			if frame is None:
+				bad += 1
+				continue
+			frame_type, sequence, payload = frame
+			if last_sequence is not None and sequence != (last_sequence + 1) & 0xff:
+				print("(lost %u frames)" % ((sequence - last_sequence - 1) & 0xff), file=sys.stderr)
+			last_sequence = sequence
+			if frame_type == TYPE_PROFILE and len(payload) >= struct.calcsize(PROFILE_FORMAT):
+				print(format_profile(decode_profile(payload)), file=sys.stderr if args.csv else sys.stdout, flush=True)
+				continue
+			if frame_type == TYPE_MEMORY and len(payload) >= struct.calcsize(MEMORY_FORMAT):
+				memory = dict(zip(MEMORY_FIELDS, struct.unpack_from(MEMORY_FORMAT, payload)))
+				print(format_memory(memory), file=sys.stderr if args.csv else sys.stdout, flush=True)
+				continue
+			if frame_type == TYPE_CALIBRATION and len(payload) >= struct.calcsize(CALIBRATION_FORMAT):
+				calibration = dict(zip(CALIBRATION_FIELDS, struct.unpack_from(CALIBRATION_FORMAT, payload)))
+				print(format_calibration(calibration), file=sys.stderr if args.csv else sys.stdout, flush=True)
+				continue
+			if frame_type == TYPE_SETTINGS and len(payload) >= struct.calcsize(SETTINGS_FORMAT):
+				settings = dict(zip(SETTINGS_FIELDS, struct.unpack_from(SETTINGS_FORMAT, payload) + tuple(payload[struct.calcsize(SETTINGS_FORMAT):])))
+				print(format_settings(settings), file=sys.stderr if args.csv else sys.stdout, flush=True)
+				continue
+			if frame_type == TYPE_HISTORY:
+				block = decode_history(payload)
+				if block is None:
+					bad += 1
+				elif block[3]:
+					print(format_history(block), file=sys.stderr if args.csv else sys.stdout, flush=True)
+				continue
+			if frame_type != TYPE_STATUS or len(payload) < struct.calcsize(STATUS_FORMAT):
+				continue
+			status = decode_status(payload)
+			if args.csv:
+				print("%u," % sequence + ",".join("" if status[k] is None else str(status[k]) for k in STATUS_FIELDS))
+			elif args.plot:
+				history.append(status)
+			else:
+				print(format_status(sequence, status), flush=True)
+	except KeyboardInterrupt:
+		pass
+	if bad:
+		print("%u bad frames" % bad, file=sys.stderr)
+
+	if args.plot and history:
+		import matplotlib.pyplot as plt
+		figure, axes = plt.subplots(4, 1, sharex=True)
+		for axis, fields in zip(axes, (("loops",), ("fps",), ("light",), ("temperature",))):
+			for field in fields:
+				axis.plot([s[field] for s in history], label=field)
+			axis.legend(loc="upper right")
+		axes[-1].set_xlabel("frame")
+		plt.show()
+
+
+if __name__ == "__main__":
+	main()
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""Converts a trace dump (see include/trace.h) to Chrome trace JSON, for chrome://tracing or ui.perfetto.dev.
+
+Reads a capture of the telemetry stream (or a serial port / pty, sending 't' to start the dump),
+and writes the JSON to stdout or a file.
+
+	trace2chrome.py capture.bin > trace.json
+	trace2chrome.py /dev/ttyUSB0 --send t -o trace.json
+"""
+
+import argparse
+import json
+import sys
+
+import telemetry
+
+TYPE_TRACE = 3
+RECORD_SIZE = 5
+END_FLAG = 0x80
+
+#Event ids, and the row (thread) each is shown on
+EVENTS = {
+	1: ("loop", "main"),
+	2: ("leds (interrupts off)", "main"),
+	3: ("twi", "main"),
+	4: ("timer2", "interrupts"),
+	5: ("int0", "interrupts"),
+	6: ("uart rx", "interrupts"),
+	7: ("uart tx", "interrupts"),
+	8: ("1-wire", "interrupts"),
+	9: ("pin change", "interrupts"),
+}
+THREADS = {"main": 1, "interrupts": 2}
+
+
+def records(stream):
+	"""Yields (time, event, arg) for every record of the first whole dump, with the 24 bit time unwrapped."""
+	last = None
+	total = 0
+	expected = 0
+	for frame in telemetry.frames(stream):
+		if frame is None:
+			continue
+		frame_type, _, payload = frame
+		if frame_type != TYPE_TRACE:
+			continue
+		first, count = payload[0], payload[1]
+		amount = (len(payload) - 2) // RECORD_SIZE
+		if first != expected:
+			#A frame was lost, so stop at the gap
+			if expected:
+				return
+			#Part way through a dump, wait for the next one to start
+			continue
+		expected = first + amount
+		for i in range(amount):
+			record = payload[2 + i * RECORD_SIZE:2 + (i + 1) * RECORD_SIZE]
+			time = record[0] | (record[1] << 8) | (record[2] << 16)
+			if last is not None:
+				total += (time - last) & 0xffffff
+			last = time
+			yield total, record[3], record[4]
+		if expected >= count:
+			return
+
+
+def convert(stream, f_cpu):
+	events = []
+	for thread, tid in THREADS.items():
+		events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": thread}})
+	for time, event, arg in records(stream):
+		name, thread = EVENTS.get(event & ~END_FLAG, ("event %u" % (event & ~END_FLAG), "main"))
+		entry = {"name": name, "pid": 1, "tid": THREADS[thread], "ts": time * 1000000 / f_cpu}
+		if event & END_FLAG:
+			entry["ph"] = "E"
+		elif (event & ~END_FLAG) in (2, 3, 4, 8):
+			entry["ph"] = "B"
+		else:
+			entry["ph"] = "i"
+			entry["s"] = "t"
+			entry["args"] = {"arg": arg}
+		events.append(entry)
+	return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+	parser.add_argument("input", help="capture file, serial port or pty ('-' for stdin)")
+	parser.add_argument("--send", default="", help="command bytes to send to a serial port first (eg t)")
+	parser.add_argument("-o", "--output", help="output file (default stdout)")
+	parser.add_argument("--f-cpu", type=int, default=telemetry.F_CPU, help="CPU clock (Hz)")
+	args = parser.parse_args()
+
+	trace = convert(telemetry.open_input(args.input, args.send), args.f_cpu)
+	if len(trace["traceEvents"]) == len(THREADS):
+		print("no trace records found", file=sys.stderr)
+		sys.exit(1)
+	with (open(args.output, "w") if args.output else sys.stdout) as output:
+		json.dump(trace, output, indent=1)
+		output.write("\n")
+
+
+if __name__ == "__main__":
+	main()